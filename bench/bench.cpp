@@ -0,0 +1,260 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "compiled_fsm.h"
+#include "fsm.h"
+#include "machine_set.h"
+#include "perf_counters.h"
+#include "sample_machines.h"
+
+namespace {
+    bench::PerfCounters *counters = nullptr;
+
+    // Results are stored here so the measured loops are not optimized away.
+    volatile uint32_t sink;
+
+    /**
+     * Runs **body** **repeats** times under the performance counters and prints the time
+     * and the counts divided by the **units** processed by one run.
+     */
+    template <typename Body>
+    void measure(const char *phase, double units, const char *unit, int repeats, Body body) {
+        counters->start();
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            body();
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        counters->stop();
+        counters->report(phase, ns, units * repeats, unit);
+    }
+
+    /**
+     * Returns **states** rows of **columns** transitions, **target** picks the target of
+     * every transition out of the state it is given.
+     */
+    template <typename Target>
+    std::vector<fsm::SparseRow> random_rows(uint32_t states, uint32_t columns, Target target) {
+        std::vector<uint32_t> cells(columns);
+        std::vector<fsm::SparseRow> rows;
+        rows.reserve(states);
+        for (uint32_t s = 0; s < states; s++) {
+            for (uint32_t &cell : cells) {
+                cell = target(s);
+            }
+            rows.push_back(fsm::make_sparse_row(cells.data(), columns));
+        }
+        return rows;
+    }
+
+    /**
+     * A random machine whose traffic stays in a small set of hot states scattered over
+     * the whole table, the way states of a product or a builder end up in practice.
+     */
+    fsm::CompiledFSM<int> scattered_machine(uint32_t states, uint32_t columns, uint32_t hot, std::mt19937 &random) {
+        std::vector<uint32_t> ids(states);
+        for (uint32_t i = 0; i < states; i++) {
+            ids[i] = i;
+        }
+        std::shuffle(ids.begin(), ids.end(), random);
+
+        // ids[0..hot) are the hot states, almost every transition out of them stays hot
+        // and half of the transitions out of the cold states lead back.
+        std::vector<fsm::SparseRow> ranked = random_rows(states, columns, [&](uint32_t rank) {
+            bool stay = rank < hot ? random() % 256 != 0 : random() % 2 == 0;
+            return ids[stay ? random() % hot : random() % states];
+        });
+        std::vector<fsm::SparseRow> rows(states);
+        std::vector<uint32_t> finals;
+        for (uint32_t rank = 0; rank < states; rank++) {
+            rows[ids[rank]] = std::move(ranked[rank]);
+            if (random() % 2) {
+                finals.push_back(ids[rank]);
+            }
+        }
+
+        std::vector<int> alphabet(columns);
+        for (uint32_t j = 0; j < columns; j++) {
+            alphabet[j] = j;
+        }
+        return fsm::CompiledFSM<int>(alphabet, rows, ids[0], finals, fsm::Layout::Dense);
+    }
+
+    void bench_relayout() {
+        std::printf("relayout: 2M states x 16 symbols (128 MB), 16K hot states\n");
+        std::mt19937 random(42);
+        fsm::CompiledFSM<int> machine = scattered_machine(1u << 21, 16, 1u << 14, random);
+
+        std::vector<int> text(1u << 24), sample(1u << 20);
+        for (int &symbol : text) {
+            symbol = random() % 16;
+        }
+        for (int &symbol : sample) {
+            symbol = random() % 16;
+        }
+
+        std::vector<uint64_t> visits;
+        measure("profile", sample.size(), "symbol", 1, [&]() {
+            machine.profile(sample.data(), sample.size(), visits);
+        });
+        fsm::CompiledFSM<int> bfs, profiled;
+        measure("relayout bfs", machine.get_states_count(), "state", 1, [&]() {
+            bfs = machine.relayout(machine.bfs_order());
+        });
+        measure("relayout profile", machine.get_states_count(), "state", 1, [&]() {
+            profiled = machine.relayout(machine.profile_order(visits));
+        });
+
+        const fsm::CompiledFSM<int> *machines[] = {&machine, &bfs, &profiled};
+        const char *names[] = {"evaluate source", "evaluate bfs", "evaluate profile"};
+        for (int m = 0; m < 3; m++) {
+            const fsm::CompiledFSM<int> &current = *machines[m];
+            measure(names[m], text.size(), "symbol", 3, [&]() {
+                uint32_t state = current.get_initial_state();
+                for (int symbol : text) {
+                    state = current.next(state, symbol);
+                }
+                sink = state;
+            });
+        }
+    }
+
+    /**
+     * Walks random text through a random table of the given size stored with **Id** ids.
+     */
+    template <typename Id>
+    void walk_table(const char *name, uint32_t states, uint32_t columns, const std::vector<uint32_t> &text) {
+        std::mt19937 random(states);
+        fsm::DenseTable<Id> table(random_rows(states, columns, [&](uint32_t) {
+            return random() % states;
+        }), columns);
+
+        std::printf("  %s ids, %zu bytes\n", name, table.memory_usage());
+        measure("walk", text.size(), "symbol", 3, [&]() {
+            uint32_t state = 0;
+            for (uint32_t symbol : text) {
+                state = table.next(state, symbol % columns);
+            }
+            sink = state;
+        });
+    }
+
+    void bench_width() {
+        std::mt19937 random(7);
+        std::vector<uint32_t> text(1u << 24);
+        for (uint32_t &symbol : text) {
+            symbol = random();
+        }
+
+        std::printf("width: 200 states x 256 symbols\n");
+        walk_table<uint8_t>("8 bit", 200, 256, text);
+        walk_table<uint16_t>("16 bit", 200, 256, text);
+        walk_table<uint32_t>("32 bit", 200, 256, text);
+        std::printf("width: 60000 states x 64 symbols\n");
+        walk_table<uint16_t>("16 bit", 60000, 64, text);
+        walk_table<uint32_t>("32 bit", 60000, 64, text);
+    }
+
+    void bench_product() {
+        // The counters are coprime, so the product has 500 * 499 reachable states.
+        std::printf("product: counters of 500 and 499 states\n");
+        fsm::FSM<int> left = fsm::ones_counter("l", 500, 5), right = fsm::ones_counter("r", 499, 7), product;
+        double states = 500.0 * 499;
+        measure("intersection", states, "state", 1, [&]() {
+            product = left.parallel_intersection(right, 1);
+        });
+        fsm::CompiledFSM<int> compiled;
+        measure("compile", states, "state", 1, [&]() {
+            compiled = fsm::CompiledFSM<int>(product);
+        });
+        measure("minimize", states, "state", 1, [&]() {
+            product.minimize();
+        });
+        const char *path = "/tmp/automata_bench.bin";
+        measure("save", states, "state", 3, [&]() {
+            compiled.save(path);
+        });
+        measure("load", states, "state", 3, [&]() {
+            compiled = fsm::CompiledFSM<int>::load(path);
+        });
+        std::remove(path);
+    }
+
+    void bench_machines() {
+        std::printf("machines: 256 random machines of 64 states over 26 symbols, 64 symbol records\n");
+        std::mt19937 random(3);
+        std::vector<char> alphabet;
+        for (char symbol = 'a'; symbol <= 'z'; symbol++) {
+            alphabet.push_back(symbol);
+        }
+        std::vector<uint32_t> finals;
+        for (uint32_t s = 1; s < 64; s += 2) {
+            finals.push_back(s);
+        }
+        std::vector<fsm::CompiledFSM<char>> machines;
+        for (int k = 0; k < 256; k++) {
+            std::vector<fsm::SparseRow> rows = random_rows(64, alphabet.size(), [&](uint32_t) {
+                return random() % 64;
+            });
+            machines.emplace_back(alphabet, rows, 0, finals);
+        }
+        fsm::MachineSet<char> set(machines);
+
+        std::vector<std::vector<char>> records(20000, std::vector<char>(64));
+        for (std::vector<char> &record : records) {
+            for (char &symbol : record) {
+                symbol = 'a' + random() % 26;
+            }
+        }
+
+        double units = 256.0 * 64 * records.size();
+        std::printf("  one pass uses %s\n", set.uses_gather() ? "AVX2 gathers" : "scalar loads");
+        measure("one pass", units, "machine-symbol", 1, [&]() {
+            fsm::Bitmap accepted;
+            for (const std::vector<char> &record : records) {
+                set.evaluate(record.data(), record.size(), accepted);
+                sink = accepted.count();
+            }
+        });
+        measure("one call per machine", units, "machine-symbol", 1, [&]() {
+            uint32_t accepted = 0;
+            for (const std::vector<char> &record : records) {
+                for (const fsm::CompiledFSM<char> &machine : machines) {
+                    accepted += machine.evaluate(record);
+                }
+            }
+            sink = accepted;
+        });
+    }
+}
+
+int main(int argc, char **argv) {
+    struct Benchmark {
+        const char *name;
+        void (*run)();
+    } benchmarks[] = {
+        {"relayout", bench_relayout},
+        {"width", bench_width},
+        {"product", bench_product},
+        {"machines", bench_machines},
+    };
+
+    bench::PerfCounters perf_counters;
+    counters = &perf_counters;
+
+    // Runs every benchmark, or only the ones named on the command line.
+    for (const Benchmark &benchmark : benchmarks) {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc; i++) {
+            selected = selected || std::strcmp(argv[i], benchmark.name) == 0;
+        }
+        if (selected) {
+            benchmark.run();
+        }
+    }
+    return 0;
+}
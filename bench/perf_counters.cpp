@@ -0,0 +1,122 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    struct CounterConfig {
+        const char *name;
+        uint32_t type;
+        uint64_t config;
+    };
+
+#ifdef __linux__
+    constexpr uint64_t cache_miss(uint64_t cache) {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+    const CounterConfig CONFIGS[] = {
+        {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {"instr", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {"L1d-miss", PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D)},
+        {"LLC-miss", PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL)},
+        {"br-miss", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {"dTLB-miss", PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_DTLB)},
+        {"faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    };
+
+    int open_counter(const CounterConfig &config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = config.type;
+        attr.config = config.config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+}
+
+bench::PerfCounters::PerfCounters() : running_(false) {
+    const char *missing = "not supported on this system";
+    bool complete = false;
+#ifdef __linux__
+    complete = true;
+    for (const CounterConfig &config : CONFIGS) {
+        int fd = open_counter(config);
+        if (fd >= 0) {
+            counters_.push_back(Counter{config.name, fd, 0});
+        } else {
+            complete = false;
+            missing = std::strerror(errno);
+        }
+    }
+#endif
+    if (!complete) {
+        std::printf("some performance counters are unavailable (%s), they are left out\n", missing);
+    }
+}
+
+bench::PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (const Counter &counter : counters_) {
+        close(counter.fd);
+    }
+#endif
+}
+
+std::size_t bench::PerfCounters::get_available_count() const {
+    return counters_.size();
+}
+
+void bench::PerfCounters::start() {
+#ifdef __linux__
+    for (const Counter &counter : counters_) {
+        ioctl(counter.fd, PERF_EVENT_IOC_RESET, 0);
+    }
+    for (const Counter &counter : counters_) {
+        ioctl(counter.fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+    running_ = true;
+}
+
+void bench::PerfCounters::stop() {
+    if (!running_) {
+        return;
+    }
+    running_ = false;
+#ifdef __linux__
+    for (const Counter &counter : counters_) {
+        ioctl(counter.fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    // value, time enabled, time running
+    for (Counter &counter : counters_) {
+        uint64_t values[3] = {0, 0, 0};
+        counter.value = 0;
+        if (read(counter.fd, values, sizeof(values)) == sizeof(values) && values[2] != 0) {
+            counter.value = values[2] < values[1] ? (uint64_t)((double)values[0] * values[1] / values[2]) : values[0];
+        }
+    }
+#endif
+}
+
+void bench::PerfCounters::report(const char *phase, double ns, double units, const char *unit) const {
+    std::printf("  %-20s %9.2f ns/%s", phase, ns / units, unit);
+    for (const Counter &counter : counters_) {
+        std::printf("  %s %.3f", counter.name, counter.value / units);
+    }
+    std::printf("\n");
+}
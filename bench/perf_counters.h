@@ -0,0 +1,66 @@
+#ifndef AUTOMATA_PERF_COUNTERS_H
+#define AUTOMATA_PERF_COUNTERS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bench {
+    /**
+     * PerfCounters collects hardware counters of the calling thread with perf_event_open:
+     * cycles, instructions, L1 data and last level cache misses, branch mispredictions,
+     * data TLB misses and page faults. Counters the kernel or the CPU do not provide
+     * (no PMU in a virtual machine, perf_event_paranoid, other systems) are left out of
+     * the report, timing is always available.
+     */
+    class PerfCounters {
+    private:
+        struct Counter {
+            const char *name;
+            int fd;
+            uint64_t value;
+        };
+
+        std::vector<Counter> counters_;
+        bool running_;
+    public:
+        /**
+         * Opens every counter that is available, disabled.
+         */
+        PerfCounters();
+
+        /**
+         * Closes the counters.
+         */
+        ~PerfCounters();
+
+        PerfCounters(const PerfCounters &) = delete;
+        PerfCounters &operator=(const PerfCounters &) = delete;
+
+        /**
+         * Returns the number of counters that could be opened.
+         */
+        std::size_t get_available_count() const;
+
+        /**
+         * Resets and enables the counters.
+         */
+        void start();
+
+        /**
+         * Disables the counters and reads them, scaled up if the kernel had to multiplex them.
+         */
+        void stop();
+
+        /**
+         * Prints one line with the time and the counters read by stop(), divided by **units**.
+         * @param char *phase: The name of the measured phase.
+         * @param double ns: The time the phase took, in nanoseconds.
+         * @param double units: The number of symbols, states, ... processed by the phase.
+         * @param char *unit: The name of one unit.
+         */
+        void report(const char *phase, double ns, double units, const char *unit) const;
+    };
+}
+
+#endif //AUTOMATA_PERF_COUNTERS_H
@@ -0,0 +1,203 @@
+#include <algorithm>
+
+#include "approximate_matcher.h"
+#include "automation_exception.h"
+
+template <typename T>
+std::size_t fsm::ApproximateMatcher<T>::ConfigurationHash::operator()(const std::vector<uint64_t> &configuration) const {
+    uint64_t h = 0x243f6a8885a308d3ull;
+    for (uint64_t item : configuration) {
+        h = (h ^ item) * 0x9e3779b97f4a7c15ull;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+template <typename T>
+fsm::ApproximateMatcher<T>::ApproximateMatcher(const fsm::FSM<T> &machine, unsigned max_distance,
+                                               uint32_t max_configurations)
+    : machine_(machine),
+    max_distance_(max_distance),
+    max_configurations_(std::max<uint32_t>(max_configurations, 3)),
+    columns_(machine_.get_alphabet_count() + 1)
+{
+    if (max_distance > MAX_DISTANCE) {
+        throw AutomationException("The edit distance is too large", __FILE__, __LINE__);
+    }
+
+    // Transitions into dead states can never be part of a match, only the others are followed.
+    edge_offsets_.push_back(0);
+    for (uint32_t s = 0; s < machine_.get_states_count(); s++) {
+        for (uint32_t c = 0; c < columns_ - 1; c++) {
+            if (!machine_.is_dead_state(machine_.next(s, c))) {
+                edge_columns_.push_back(c);
+                edge_targets_.push_back(machine_.next(s, c));
+            }
+        }
+        edge_offsets_.push_back(edge_targets_.size());
+    }
+
+    edits_.assign(machine_.get_states_count(), UNSEEN);
+    buckets_.resize(max_distance + 1);
+    relax(machine_.get_initial_state(), 0);
+    initial_ = settle();
+    intern(anchored_, std::vector<uint64_t>(initial_));
+    intern(unanchored_, std::vector<uint64_t>(initial_));
+}
+
+template <typename T>
+unsigned fsm::ApproximateMatcher<T>::get_max_distance() const {
+    return max_distance_;
+}
+
+template <typename T>
+std::size_t fsm::ApproximateMatcher<T>::get_configurations_count() const {
+    return anchored_.configurations.size() + unanchored_.configurations.size();
+}
+
+template <typename T>
+void fsm::ApproximateMatcher<T>::relax(uint32_t state, unsigned edits) {
+    // States that cannot reach a final state never lead to a match.
+    if (edits > max_distance_ || machine_.is_dead_state(state)) {
+        return;
+    }
+    if (edits_[state] == UNSEEN) {
+        touched_.push_back(state);
+    } else if (edits_[state] <= edits) {
+        return;
+    }
+    edits_[state] = edits;
+    buckets_[edits].push_back(state);
+}
+
+template <typename T>
+std::vector<uint64_t> fsm::ApproximateMatcher<T>::settle() {
+    // Inserting a symbol costs one edit, so the states are settled in order of their edits.
+    for (unsigned edits = 0; edits < max_distance_; edits++) {
+        for (std::size_t i = 0; i < buckets_[edits].size(); i++) {
+            uint32_t state = buckets_[edits][i];
+            if (edits_[state] != edits) {
+                continue;
+            }
+            for (uint32_t e = edge_offsets_[state]; e < edge_offsets_[state + 1]; e++) {
+                relax(edge_targets_[e], edits + 1);
+            }
+        }
+    }
+
+    std::vector<uint64_t> configuration;
+    configuration.reserve(touched_.size());
+    for (uint32_t state : touched_) {
+        configuration.push_back((uint64_t)state << 8 | edits_[state]);
+        edits_[state] = UNSEEN;
+    }
+    touched_.clear();
+    for (std::vector<uint32_t> &bucket : buckets_) {
+        bucket.clear();
+    }
+    std::sort(configuration.begin(), configuration.end());
+    return configuration;
+}
+
+template <typename T>
+uint32_t fsm::ApproximateMatcher<T>::intern(Cache &cache, std::vector<uint64_t> &&configuration) {
+    auto found = cache.ids.find(configuration);
+    if (found != cache.ids.end()) {
+        return found->second;
+    }
+
+    // The initial configuration always keeps id 0.
+    if (cache.configurations.size() >= max_configurations_) {
+        cache.ids.clear();
+        cache.configurations.clear();
+        cache.distances.clear();
+        cache.transitions.clear();
+        cache.drops++;
+        intern(cache, std::vector<uint64_t>(initial_));
+        if (configuration == initial_) {
+            return 0;
+        }
+    }
+
+    unsigned distance = max_distance_ + 1;
+    for (uint64_t item : configuration) {
+        if (machine_.is_final_state(item >> 8)) {
+            distance = std::min<unsigned>(distance, item & 0xff);
+        }
+    }
+    uint32_t id = cache.configurations.size();
+    cache.ids.emplace(configuration, id);
+    cache.configurations.push_back(std::move(configuration));
+    cache.distances.push_back(distance);
+    cache.transitions.resize(cache.transitions.size() + columns_, UNKNOWN);
+    return id;
+}
+
+template <typename T>
+uint32_t fsm::ApproximateMatcher<T>::transition(Cache &cache, uint32_t id, uint32_t column, bool unanchored) {
+    uint32_t cached = cache.transitions[(std::size_t)id * columns_ + column];
+    if (cached != UNKNOWN) {
+        return cached;
+    }
+
+    for (uint64_t item : cache.configurations[id]) {
+        uint32_t state = item >> 8;
+        unsigned edits = item & 0xff;
+        // Deleting the symbol read, or reading any symbol of the alphabet at the cost of a substitution if it differs.
+        relax(state, edits + 1);
+        for (uint32_t e = edge_offsets_[state]; e < edge_offsets_[state + 1]; e++) {
+            relax(edge_targets_[e], edits + (edge_columns_[e] != column));
+        }
+    }
+    if (unanchored) {
+        relax(machine_.get_initial_state(), 0);
+    }
+
+    std::size_t drops = cache.drops;
+    uint32_t next = intern(cache, settle());
+    // A dropped cache renumbers the configurations, so the transition is only kept if it did not happen.
+    if (cache.drops == drops) {
+        cache.transitions[(std::size_t)id * columns_ + column] = next;
+    }
+    return next;
+}
+
+template <typename T>
+unsigned fsm::ApproximateMatcher<T>::distance(const T *word, std::size_t length) {
+    uint32_t id = 0;
+    for (std::size_t i = 0; i < length; i++) {
+        if (anchored_.configurations[id].empty()) {
+            break;
+        }
+        uint32_t column = machine_.column_of(word[i]);
+        id = transition(anchored_, id, column == fsm::SymbolMap<T>::npos ? columns_ - 1 : column, false);
+    }
+    return anchored_.distances[id];
+}
+
+template <typename T>
+bool fsm::ApproximateMatcher<T>::evaluate(const T *word, std::size_t length) {
+    return distance(word, length) <= max_distance_;
+}
+
+template <typename T>
+bool fsm::ApproximateMatcher<T>::evaluate(const std::vector<T> &word) {
+    return evaluate(word.data(), word.size());
+}
+
+template <typename T>
+bool fsm::ApproximateMatcher<T>::search(const T *text, std::size_t length, std::size_t &end, unsigned &distance) {
+    uint32_t id = 0;
+    for (end = 0; unanchored_.distances[id] > max_distance_; end++) {
+        if (end == length || unanchored_.configurations[id].empty()) {
+            return false;
+        }
+        uint32_t column = machine_.column_of(text[end]);
+        id = transition(unanchored_, id, column == fsm::SymbolMap<T>::npos ? columns_ - 1 : column, true);
+    }
+    distance = unanchored_.distances[id];
+    return true;
+}
+
+template class fsm::ApproximateMatcher<int>;
+template class fsm::ApproximateMatcher<char>;
@@ -0,0 +1,142 @@
+#ifndef AUTOMATA_APPROXIMATE_MATCHER_H
+#define AUTOMATA_APPROXIMATE_MATCHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "compiled_fsm.h"
+#include "fsm.h"
+
+namespace fsm {
+    /**
+     * ApproximateMatcher decides whether a word is within edit distance k of the language of
+     * a machine, counting insertions, deletions and substitutions of single symbols.
+     * It runs the product of the machine with a Levenshtein automaton: a configuration is
+     * the set of machine states reachable with at most k edits, each with its smallest
+     * number of edits. Configurations are built lazily, once per configuration and symbol,
+     * and cached, so after a warm up every symbol costs one table lookup like a compiled
+     * machine, without ever enumerating the edited words.
+     * The cache is dropped when it grows past a limit, which bounds the memory for any input.
+     * Matching updates the cache, so a matcher must not be used by several threads at once.
+     */
+    template <typename T>
+    class ApproximateMatcher {
+    private:
+        /**
+         * Hashes a configuration stored as (state << 8 | edits) items.
+         */
+        struct ConfigurationHash {
+            std::size_t operator()(const std::vector<uint64_t> &configuration) const;
+        };
+
+        /**
+         * The configurations met so far for one mode, anchored or search.
+         */
+        struct Cache {
+            std::unordered_map<std::vector<uint64_t>, uint32_t, ConfigurationHash> ids;
+            std::vector<std::vector<uint64_t>> configurations;
+            std::vector<uint8_t> distances;
+            std::vector<uint32_t> transitions;
+            std::size_t drops = 0;
+        };
+
+        fsm::CompiledFSM<T> machine_;
+        unsigned max_distance_;
+        uint32_t max_configurations_;
+        uint32_t columns_;
+        std::vector<uint64_t> initial_;
+        std::vector<uint32_t> edge_offsets_;
+        std::vector<uint32_t> edge_columns_;
+        std::vector<uint32_t> edge_targets_;
+        Cache anchored_;
+        Cache unanchored_;
+        std::vector<uint8_t> edits_;
+        std::vector<uint32_t> touched_;
+        std::vector<std::vector<uint32_t>> buckets_;
+
+        static constexpr uint32_t UNKNOWN = UINT32_MAX;
+        static constexpr uint8_t UNSEEN = UINT8_MAX;
+    public:
+        /**
+         * The largest supported edit distance.
+         */
+        static constexpr unsigned MAX_DISTANCE = 254;
+
+        /**
+         * Creates a matcher for the words within **max_distance** edits of the machine's language.
+         * Throws AutomationException if max_distance is larger than MAX_DISTANCE.
+         * @param FSM<T> &machine: The machine, it is compiled and not referenced afterwards.
+         * @param unsigned max_distance: The largest number of edits.
+         * @param uint32_t max_configurations: The number of cached configurations per mode before the cache is dropped, at least 3.
+         */
+        ApproximateMatcher(const fsm::FSM<T> &machine, unsigned max_distance, uint32_t max_configurations = 65536);
+
+        /**
+         * Returns the largest number of edits.
+         */
+        unsigned get_max_distance() const;
+
+        /**
+         * Returns the number of configurations in the caches.
+         */
+        std::size_t get_configurations_count() const;
+
+        /**
+         * Returns the smallest number of edits that turn the word into an accepted one,
+         * or get_max_distance() + 1 if more edits are needed.
+         * @param T *word: The symbols of the word.
+         * @param size_t length: Number of symbols in the word.
+         */
+        unsigned distance(const T *word, std::size_t length);
+
+        /**
+         * Returns true if the word is within get_max_distance() edits of an accepted word.
+         * @param T *word: The symbols of the word.
+         * @param size_t length: Number of symbols in the word.
+         */
+        bool evaluate(const T *word, std::size_t length);
+
+        /**
+         * Returns true if the word is within get_max_distance() edits of an accepted word.
+         * @param vector<T> &word: The symbols of the word.
+         */
+        bool evaluate(const std::vector<T> &word);
+
+        /**
+         * Looks for the first place in the text where a part of it within get_max_distance()
+         * edits of an accepted word ends. Returns false if there is none.
+         * @param T *text: The symbols to search.
+         * @param size_t length: Number of symbols in the text.
+         * @param size_t &end: Set to the number of symbols read up to the end of the first match.
+         * @param unsigned &distance: Set to the smallest number of edits of a match ending there.
+         */
+        bool search(const T *text, std::size_t length, std::size_t &end, unsigned &distance);
+    private:
+
+        /**
+         * Returns the id of a configuration, adding it to the cache if it is new.
+         * Drops the cache first if it is full, which renumbers the configurations and counts in drops.
+         */
+        uint32_t intern(Cache &cache, std::vector<uint64_t> &&configuration);
+
+        /**
+         * Returns the configuration reached from configuration **id** with the symbol at **column**,
+         * the extra last column stands for symbols outside the alphabet.
+         */
+        uint32_t transition(Cache &cache, uint32_t id, uint32_t column, bool unanchored);
+
+        /**
+         * Records that **state** is reachable with **edits** edits, if that is fewer than known.
+         */
+        void relax(uint32_t state, unsigned edits);
+
+        /**
+         * Adds the states reachable by inserting symbols and returns the sorted configuration.
+         */
+        std::vector<uint64_t> settle();
+    };
+}
+
+#endif //AUTOMATA_APPROXIMATE_MATCHER_H
@@ -13,6 +13,7 @@ namespace fsm {
         fsm::String msg_;
         fsm::String file_;
         int line_;
+        fsm::String what_;
 
     public:
         /**
@@ -21,7 +22,7 @@ namespace fsm {
          * @param char *file: Name of the source file where the exception occured.
          * @param int line: Line in the source file where the exception occured.
          */
-        AutomationException(char *msg, char *file, int line);
+        AutomationException(const char *msg, const char *file, int line);
 
         /**
          * Returns the message associated with the exception.
@@ -40,6 +41,7 @@ namespace fsm {
 
         /**
          * Returns a string representation of the exception (including file, line and error message).
+         * It is formatted once by the constructor and owned by the exception.
          */
         const char* what() const noexcept override;
     };
@@ -0,0 +1,106 @@
+#include <algorithm>
+
+#include "big_uint.h"
+
+fsm::BigUint::BigUint(uint64_t value) {
+    while (value != 0) {
+        limbs_.push_back((uint32_t)value);
+        value >>= 32;
+    }
+}
+
+void fsm::BigUint::normalize() {
+    while (!limbs_.empty() && limbs_.back() == 0) {
+        limbs_.pop_back();
+    }
+}
+
+bool fsm::BigUint::is_zero() const {
+    return limbs_.empty();
+}
+
+std::size_t fsm::BigUint::get_bits_count() const {
+    if (limbs_.empty()) {
+        return 0;
+    }
+    return limbs_.size() * 32 - __builtin_clz(limbs_.back());
+}
+
+fsm::BigUint &fsm::BigUint::operator+=(const fsm::BigUint &rhs) {
+    add_product(rhs, 1);
+    return *this;
+}
+
+void fsm::BigUint::add_product(const fsm::BigUint &rhs, uint32_t factor) {
+    if (factor == 0 || rhs.limbs_.empty()) {
+        return;
+    }
+    if (limbs_.size() < rhs.limbs_.size() + 1) {
+        limbs_.resize(rhs.limbs_.size() + 1, 0);
+    }
+
+    uint64_t carry = 0;
+    std::size_t i = 0;
+    for (; i < rhs.limbs_.size(); i++) {
+        carry += (uint64_t)rhs.limbs_[i] * factor + limbs_[i];
+        limbs_[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    for (; carry != 0; i++) {
+        if (i == limbs_.size()) {
+            limbs_.push_back(0);
+        }
+        carry += limbs_[i];
+        limbs_[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    normalize();
+}
+
+uint64_t fsm::BigUint::modulo(uint64_t modulus) const {
+    unsigned __int128 remainder = 0;
+    for (std::size_t i = limbs_.size(); i-- > 0;) {
+        remainder = ((remainder << 32) | limbs_[i]) % modulus;
+    }
+    return (uint64_t)remainder;
+}
+
+fsm::String fsm::BigUint::to_string() const {
+    if (limbs_.empty()) {
+        return fsm::String("0");
+    }
+
+    // Divides by 10^9 repeatedly, every remainder gives nine digits.
+    std::vector<uint32_t> quotient(limbs_);
+    std::vector<char> digits;
+    while (!quotient.empty()) {
+        uint64_t remainder = 0;
+        for (std::size_t i = quotient.size(); i-- > 0;) {
+            uint64_t current = (remainder << 32) | quotient[i];
+            quotient[i] = (uint32_t)(current / 1000000000u);
+            remainder = current % 1000000000u;
+        }
+        while (!quotient.empty() && quotient.back() == 0) {
+            quotient.pop_back();
+        }
+        for (int d = 0; d < 9 && (remainder != 0 || !quotient.empty()); d++) {
+            digits.push_back('0' + remainder % 10);
+            remainder /= 10;
+        }
+    }
+    std::reverse(digits.begin(), digits.end());
+    digits.push_back('\0');
+    return fsm::String(digits.data());
+}
+
+bool fsm::BigUint::operator==(const fsm::BigUint &rhs) const {
+    return limbs_ == rhs.limbs_;
+}
+
+bool fsm::BigUint::operator!=(const fsm::BigUint &rhs) const {
+    return limbs_ != rhs.limbs_;
+}
+
+std::ostream &fsm::operator<<(std::ostream &os, const fsm::BigUint &number) {
+    return os << number.to_string();
+}
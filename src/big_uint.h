@@ -0,0 +1,74 @@
+#ifndef AUTOMATA_BIG_UINT_H
+#define AUTOMATA_BIG_UINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "custom_string.h"
+
+namespace fsm {
+    /**
+     * An arbitrary precision unsigned integer with the operations word counting needs.
+     * It is stored as little endian 32-bit limbs without leading zero limbs.
+     */
+    class BigUint {
+    private:
+        std::vector<uint32_t> limbs_;
+
+        /**
+         * Drops the leading zero limbs.
+         */
+        void normalize();
+    public:
+        /**
+         * Creates the number **value**.
+         */
+        BigUint(uint64_t value = 0);
+
+        /**
+         * Returns true if the number is 0.
+         */
+        bool is_zero() const;
+
+        /**
+         * Returns the number of significant bits, 0 for 0.
+         */
+        std::size_t get_bits_count() const;
+
+        /**
+         * Adds **rhs** to the number.
+         */
+        fsm::BigUint &operator+=(const fsm::BigUint &rhs);
+
+        /**
+         * Adds **rhs** * **factor** to the number in one pass.
+         */
+        void add_product(const fsm::BigUint &rhs, uint32_t factor);
+
+        /**
+         * Returns the remainder of the division by **modulus**.
+         * @param uint64_t modulus: A positive number.
+         */
+        uint64_t modulo(uint64_t modulus) const;
+
+        /**
+         * Returns the decimal representation of the number.
+         */
+        fsm::String to_string() const;
+
+        bool operator==(const fsm::BigUint &rhs) const;
+
+        bool operator!=(const fsm::BigUint &rhs) const;
+
+        /**
+         * Writes the decimal representation of the number.
+         */
+        friend std::ostream &operator<<(std::ostream &os, const fsm::BigUint &number);
+    };
+
+    std::ostream &operator<<(std::ostream &os, const fsm::BigUint &number);
+}
+
+#endif //AUTOMATA_BIG_UINT_H
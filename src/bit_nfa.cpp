@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <unordered_map>
+
+#include "bit_nfa.h"
+#include "automation_exception.h"
+
+namespace {
+    /**
+     * Hashes a set of positions stored as words.
+     */
+    struct SetHash {
+        std::size_t operator()(const std::vector<uint64_t> &set) const {
+            uint64_t h = 0x243f6a8885a308d3ull;
+            for (uint64_t word : set) {
+                h = (h ^ word) * 0x9e3779b97f4a7c15ull;
+                h ^= h >> 32;
+            }
+            return h;
+        }
+    };
+}
+
+template <typename T>
+fsm::BitNFA<T>::BitNFA(const fsm::Pattern<T> &pattern) {
+    if (pattern.get_positions_count() > MAX_POSITIONS) {
+        throw AutomationException("The pattern has too many positions for a BitNFA", __FILE__, __LINE__);
+    }
+
+    fsm::PositionAutomaton<T> automaton = pattern.positions();
+    positions_ = automaton.symbols.size() - 1;
+    words_ = positions_ < 64 ? 1 : 4;
+
+    for (uint32_t p = 1; p <= positions_; p++) {
+        if (std::find(alphabet_.begin(), alphabet_.end(), automaton.symbols[p]) == alphabet_.end()) {
+            alphabet_.push_back(automaton.symbols[p]);
+        }
+    }
+    symbols_ = fsm::SymbolMap<T>(alphabet_);
+
+    // One mask per symbol with the positions it enters, the extra last mask is empty
+    // and is used for symbols that do not occur in the pattern.
+    masks_.assign((alphabet_.size() + 1) * words_, 0);
+    last_.assign(words_, 0);
+    std::vector<uint64_t> follow((positions_ + 1) * words_, 0);
+    for (uint32_t p = 0; p <= positions_; p++) {
+        if (p > 0) {
+            masks_[symbols_.column(automaton.symbols[p]) * words_ + p / 64] |= 1ull << (p % 64);
+        }
+        if (automaton.last[p]) {
+            last_[p / 64] |= 1ull << (p % 64);
+        }
+        for (uint32_t q : automaton.follow[p]) {
+            follow[p * words_ + q / 64] |= 1ull << (q % 64);
+        }
+    }
+
+    // follow_[chunk][byte] is the union of the follow sets of the positions of the byte.
+    unsigned chunks = 8 * words_;
+    follow_.assign((std::size_t)chunks * 256 * words_, 0);
+    for (unsigned c = 0; c < chunks; c++) {
+        uint64_t *table = &follow_[(std::size_t)c * 256 * words_];
+        for (unsigned byte = 1; byte < 256; byte++) {
+            unsigned bit = __builtin_ctz(byte), p = c * 8 + bit;
+            for (unsigned w = 0; w < words_; w++) {
+                table[byte * words_ + w] = table[(byte & (byte - 1)) * words_ + w]
+                    | (p <= positions_ ? follow[p * words_ + w] : 0);
+            }
+        }
+    }
+}
+
+template <typename T>
+uint32_t fsm::BitNFA<T>::get_positions_count() const {
+    return positions_;
+}
+
+template <typename T>
+const std::vector<T> &fsm::BitNFA<T>::get_alphabet() const {
+    return alphabet_;
+}
+
+template <typename T>
+bool fsm::BitNFA<T>::evaluate(const T *word, std::size_t length) const {
+    uint64_t state[4] = {1, 0, 0, 0};
+    if (words_ == 1) {
+        run<1>(word, length, state, false, false);
+    } else {
+        run<4>(word, length, state, false, false);
+    }
+    return is_accepting(state);
+}
+
+template <typename T>
+bool fsm::BitNFA<T>::evaluate(const std::vector<T> &word) const {
+    return evaluate(word.data(), word.size());
+}
+
+template <typename T>
+bool fsm::BitNFA<T>::search(const T *text, std::size_t length, std::size_t &end) const {
+    uint64_t state[4] = {1, 0, 0, 0};
+    end = 0;
+    if (is_accepting(state)) {
+        return true;
+    }
+    end = words_ == 1 ? run<1>(text, length, state, true, true) : run<4>(text, length, state, true, true);
+    return is_accepting(state);
+}
+
+template <typename T>
+fsm::CompiledFSM<T> fsm::BitNFA<T>::determinize(bool unanchored, uint32_t max_states) const {
+    uint32_t columns = alphabet_.size();
+    std::vector<std::vector<uint64_t>> sets{std::vector<uint64_t>(words_, 0)};
+    sets[0][0] = 1;
+    std::unordered_map<std::vector<uint64_t>, uint32_t, SetHash> ids{{sets[0], 0}};
+    std::vector<fsm::SparseRow> rows;
+    std::vector<uint32_t> final_states, cells(columns);
+    std::vector<uint64_t> next(words_);
+
+    for (uint32_t id = 0; id < sets.size(); id++) {
+        for (uint32_t j = 0; j < columns; j++) {
+            if (words_ == 1) {
+                step<1>(sets[id].data(), j, next.data());
+            } else {
+                step<4>(sets[id].data(), j, next.data());
+            }
+            if (unanchored) {
+                next[0] |= 1;
+            }
+            auto found = ids.emplace(next, sets.size());
+            if (found.second) {
+                if (sets.size() == max_states) {
+                    throw AutomationException("The deterministic machine has too many states", __FILE__, __LINE__);
+                }
+                sets.push_back(next);
+            }
+            cells[j] = found.first->second;
+        }
+        rows.push_back(fsm::make_sparse_row(cells.data(), columns));
+        if (is_accepting(sets[id].data())) {
+            final_states.push_back(id);
+        }
+    }
+    return fsm::CompiledFSM<T>(alphabet_, rows, 0, final_states);
+}
+
+template <typename T>
+template <unsigned W>
+std::size_t fsm::BitNFA<T>::run(const T *symbols, std::size_t length, uint64_t *state, bool unanchored, bool stop) const {
+    uint64_t next[W];
+    std::size_t i = 0;
+    while (i < length) {
+        uint32_t column = symbols_.column(symbols[i++]);
+        step<W>(state, column == fsm::SymbolMap<T>::npos ? alphabet_.size() : column, next);
+
+        // In a search every position can start a match, so the start stays active.
+        uint64_t any = 0;
+        for (unsigned w = 0; w < W; w++) {
+            state[w] = next[w];
+            any |= next[w];
+        }
+        if (unanchored) {
+            state[0] |= 1;
+        } else if (any == 0) {
+            break;
+        }
+        if (stop && is_accepting(state)) {
+            break;
+        }
+    }
+    return i;
+}
+
+template <typename T>
+template <unsigned W>
+void fsm::BitNFA<T>::step(const uint64_t *state, uint32_t column, uint64_t *next) const {
+    uint64_t reached[W] = {};
+    for (unsigned c = 0; c < 8 * W; c++) {
+        unsigned byte = (state[c / 8] >> (c % 8 * 8)) & 0xff;
+        if (byte != 0) {
+            const uint64_t *row = &follow_[((std::size_t)c * 256 + byte) * W];
+            for (unsigned w = 0; w < W; w++) {
+                reached[w] |= row[w];
+            }
+        }
+    }
+    const uint64_t *mask = &masks_[(std::size_t)column * W];
+    for (unsigned w = 0; w < W; w++) {
+        next[w] = reached[w] & mask[w];
+    }
+}
+
+template <typename T>
+bool fsm::BitNFA<T>::is_accepting(const uint64_t *state) const {
+    uint64_t any = 0;
+    for (unsigned w = 0; w < words_; w++) {
+        any |= state[w] & last_[w];
+    }
+    return any != 0;
+}
+
+template class fsm::BitNFA<int>;
+template class fsm::BitNFA<char>;
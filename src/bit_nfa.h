@@ -0,0 +1,107 @@
+#ifndef AUTOMATA_BIT_NFA_H
+#define AUTOMATA_BIT_NFA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "compiled_fsm.h"
+#include "pattern.h"
+#include "symbol_map.h"
+
+namespace fsm {
+    /**
+     * BitNFA simulates the position automaton of a pattern with bit-parallel operations.
+     * The set of active positions is a bitmask of one machine word for up to 63 positions
+     * and of four words (one SIMD register wide) for up to 255. A step ORs the follow
+     * sets of the active positions, read from tables indexed by each byte of the mask,
+     * and keeps the positions entered by the symbol read with its precomputed mask.
+     * Symbols that do not occur in the pattern end every match.
+     */
+    template <typename T>
+    class BitNFA {
+    private:
+        std::vector<T> alphabet_;
+        fsm::SymbolMap<T> symbols_;
+        uint32_t positions_;
+        unsigned words_;
+        std::vector<uint64_t> masks_;
+        std::vector<uint64_t> follow_;
+        std::vector<uint64_t> last_;
+    public:
+        /**
+         * The largest number of positions supported.
+         */
+        static constexpr uint32_t MAX_POSITIONS = 255;
+
+        /**
+         * Builds the engine for a pattern.
+         * Throws AutomationException if the pattern has more than MAX_POSITIONS positions.
+         * @param Pattern<T> &pattern: The pattern to simulate.
+         */
+        BitNFA(const fsm::Pattern<T> &pattern);
+
+        /**
+         * Returns the number of positions of the pattern.
+         */
+        uint32_t get_positions_count() const;
+
+        /**
+         * Returns the symbols that occur in the pattern.
+         */
+        const std::vector<T> &get_alphabet() const;
+
+        /**
+         * Returns true if the whole word matches the pattern.
+         * @param T *word: The symbols of the word.
+         * @param size_t length: Number of symbols in the word.
+         */
+        bool evaluate(const T *word, std::size_t length) const;
+
+        /**
+         * Returns true if the whole word matches the pattern.
+         * @param vector<T> &word: The symbols of the word.
+         */
+        bool evaluate(const std::vector<T> &word) const;
+
+        /**
+         * Looks for the first place in the text where a match of the pattern ends.
+         * Returns false if there is none.
+         * @param T *text: The symbols to search.
+         * @param size_t length: Number of symbols in the text.
+         * @param size_t &end: Set to the number of symbols read up to the end of the first match.
+         */
+        bool search(const T *text, std::size_t length, std::size_t &end) const;
+
+        /**
+         * Builds the equivalent deterministic machine with the subset construction, the empty
+         * set becomes a dead state if it is reachable. The machine for search() accepts
+         * the words with a suffix matching the pattern.
+         * Throws AutomationException if more than **max_states** states are needed.
+         * @param bool unanchored: Whether to build the machine for search() instead of evaluate().
+         * @param uint32_t max_states: The largest acceptable number of states.
+         */
+        fsm::CompiledFSM<T> determinize(bool unanchored = false, uint32_t max_states = 0xffffffffu) const;
+    private:
+
+        /**
+         * Runs the symbols from **state**, stopping at the first accepting set when **stop** is set.
+         * Returns the number of symbols read and leaves the final set in **state**.
+         */
+        template <unsigned W>
+        std::size_t run(const T *symbols, std::size_t length, uint64_t *state, bool unanchored, bool stop) const;
+
+        /**
+         * Computes the positions reached from **state** with the symbol at **column**.
+         */
+        template <unsigned W>
+        void step(const uint64_t *state, uint32_t column, uint64_t *next) const;
+
+        /**
+         * Returns true if the set contains a last position.
+         */
+        bool is_accepting(const uint64_t *state) const;
+    };
+}
+
+#endif //AUTOMATA_BIT_NFA_H
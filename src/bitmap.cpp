@@ -0,0 +1,41 @@
+#include <algorithm>
+
+#include "bitmap.h"
+
+fsm::Bitmap::Bitmap() : size_(0) {}
+
+fsm::Bitmap::Bitmap(std::size_t size) : words_((size + 63) / 64, 0), size_(size) {}
+
+std::size_t fsm::Bitmap::size() const {
+    return size_;
+}
+
+void fsm::Bitmap::resize(std::size_t size) {
+    // Clear the tail of the last word so shrinking and growing again leaves the new bits cleared.
+    if (size < size_ && size % 64 != 0) {
+        words_[size / 64] &= (uint64_t(1) << (size % 64)) - 1;
+    }
+    words_.resize((size + 63) / 64, 0);
+    size_ = size;
+}
+
+void fsm::Bitmap::clear() {
+    std::fill(words_.begin(), words_.end(), 0);
+}
+
+void fsm::Bitmap::flip() {
+    for (uint64_t &word : words_) {
+        word = ~word;
+    }
+    if (size_ % 64 != 0) {
+        words_.back() &= (uint64_t(1) << (size_ % 64)) - 1;
+    }
+}
+
+std::size_t fsm::Bitmap::count() const {
+    std::size_t total = 0;
+    for (uint64_t word : words_) {
+        total += __builtin_popcountll(word);
+    }
+    return total;
+}
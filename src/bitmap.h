@@ -0,0 +1,83 @@
+#ifndef AUTOMATA_BITMAP_H
+#define AUTOMATA_BITMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fsm {
+    /**
+     * A fixed size set of bits indexed by state id.
+     */
+    class Bitmap {
+    private:
+        std::vector<uint64_t> words_;
+        std::size_t size_;
+    public:
+        /**
+         * Creates an empty Bitmap.
+         */
+        Bitmap();
+
+        /**
+         * Creates a Bitmap with the given number of cleared bits.
+         * @param size_t size: Number of bits.
+         */
+        Bitmap(std::size_t size);
+
+        /**
+         * Returns the number of bits.
+         */
+        std::size_t size() const;
+
+        /**
+         * Changes the number of bits, new bits are cleared.
+         * @param size_t size: The new number of bits.
+         */
+        void resize(std::size_t size);
+
+        /**
+         * Returns true if the bit at **i** is set.
+         */
+        bool test(std::size_t i) const;
+
+        /**
+         * Sets the bit at **i**.
+         */
+        void set(std::size_t i);
+
+        /**
+         * Clears the bit at **i**.
+         */
+        void reset(std::size_t i);
+
+        /**
+         * Clears all bits.
+         */
+        void clear();
+
+        /**
+         * Inverts all bits in O(n/64).
+         */
+        void flip();
+
+        /**
+         * Returns the number of set bits.
+         */
+        std::size_t count() const;
+    };
+
+    inline bool Bitmap::test(std::size_t i) const {
+        return (words_[i / 64] >> (i % 64) & 1) != 0;
+    }
+
+    inline void Bitmap::set(std::size_t i) {
+        words_[i / 64] |= uint64_t(1) << (i % 64);
+    }
+
+    inline void Bitmap::reset(std::size_t i) {
+        words_[i / 64] &= ~(uint64_t(1) << (i % 64));
+    }
+}
+
+#endif //AUTOMATA_BITMAP_H
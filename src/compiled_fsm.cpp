@@ -0,0 +1,581 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+#include "compiled_fsm.h"
+#include "automation_exception.h"
+#include "custom_string.h"
+
+template <typename T>
+fsm::CompiledFSM<T>::CompiledFSM()
+    : CompiledFSM(std::vector<T>(), std::vector<fsm::SparseRow>{fsm::SparseRow{0, {}}}, 0, std::vector<uint32_t>())
+{}
+
+template <typename T>
+fsm::CompiledFSM<T>::CompiledFSM(const fsm::FSM<T> &machine, fsm::Layout layout)
+    : alphabet_(machine.get_alphabet()),
+    symbols_(machine.get_alphabet()),
+    states_(machine.get_states()),
+    initial_state_(0),
+    flags_(machine.get_states_count(), 0),
+    labels_(machine.get_states_count(), fsm::Label{0, 0}),
+    layout_(fsm::Layout::Dense),
+    id_size_(sizeof(uint32_t))
+{
+    std::map<fsm::String, uint32_t> ids;
+    for (uint32_t i = 0; i < states_.size(); i++) {
+        ids.emplace(states_[i].get_name(), i);
+    }
+
+    auto id_of = [&ids](const fsm::State &state) {
+        auto it = ids.find(state.get_name());
+        if (it == ids.end()) {
+            throw AutomationException("Unknown state in machine", __FILE__, __LINE__);
+        }
+        return it->second;
+    };
+
+    initial_state_ = id_of(machine.get_initial_state());
+    for (const fsm::State &state : machine.get_final_states()) {
+        uint32_t id = id_of(state);
+        flags_[id] = FINAL;
+        if (const fsm::Label *label = machine.get_final_label(state)) {
+            labels_[id] = *label;
+        }
+    }
+
+    const auto &table = machine.get_transition_table();
+    uint32_t columns = alphabet_.size();
+    std::vector<uint32_t> cells(columns);
+    std::vector<fsm::SparseRow> rows;
+    rows.reserve(states_.size());
+
+    for (uint32_t i = 0; i < states_.size(); i++) {
+        if (i >= table.size() || table[i].size() < columns) {
+            throw AutomationException("Transition table is incomplete", __FILE__, __LINE__);
+        }
+        for (uint32_t j = 0; j < columns; j++) {
+            cells[j] = id_of(table[i][j]);
+        }
+        rows.push_back(fsm::make_sparse_row(cells.data(), columns));
+    }
+
+    build_table(rows, layout);
+}
+
+template <typename T>
+fsm::CompiledFSM<T>::CompiledFSM(const std::vector<T> &alphabet, const std::vector<fsm::SparseRow> &rows,
+    uint32_t initial_state, const std::vector<uint32_t> &final_states, fsm::Layout layout)
+    : alphabet_(alphabet),
+    symbols_(alphabet),
+    initial_state_(initial_state),
+    flags_(rows.size(), 0),
+    labels_(rows.size(), fsm::Label{0, 0}),
+    layout_(fsm::Layout::Dense),
+    id_size_(sizeof(uint32_t))
+{
+    if (initial_state_ >= rows.size()) {
+        throw AutomationException("Initial state is not a valid state", __FILE__, __LINE__);
+    }
+    for (uint32_t id : final_states) {
+        if (id >= rows.size()) {
+            throw AutomationException("At least one final state is not a valid state", __FILE__, __LINE__);
+        }
+        flags_[id] = FINAL;
+    }
+    for (const fsm::SparseRow &row : rows) {
+        if (row.default_target >= rows.size()) {
+            throw AutomationException("Transition to an unknown state", __FILE__, __LINE__);
+        }
+        for (const auto &exception : row.exceptions) {
+            if (exception.first >= alphabet_.size() || exception.second >= rows.size()) {
+                throw AutomationException("Transition to an unknown state", __FILE__, __LINE__);
+            }
+        }
+    }
+
+    states_.reserve(rows.size());
+    for (uint32_t i = 0; i < rows.size(); i++) {
+        states_.emplace_back(fsm::String((int)i));
+    }
+
+    build_table(rows, layout);
+}
+
+template <typename T>
+void fsm::CompiledFSM<T>::build_table(const std::vector<fsm::SparseRow> &rows, fsm::Layout layout) {
+    layout_ = fsm::choose_layout(rows, alphabet_.size(), layout);
+    id_size_ = sizeof(uint32_t);
+    if (layout_ == fsm::Layout::Comb) {
+        comb_ = fsm::CombTable(rows, alphabet_.size());
+    } else {
+        id_size_ = fsm::state_id_size(rows.size());
+        if (id_size_ == sizeof(uint8_t)) {
+            dense8_ = fsm::DenseTable<uint8_t>(rows, alphabet_.size());
+        } else if (id_size_ == sizeof(uint16_t)) {
+            dense16_ = fsm::DenseTable<uint16_t>(rows, alphabet_.size());
+        } else {
+            dense32_ = fsm::DenseTable<uint32_t>(rows, alphabet_.size());
+        }
+    }
+    mark_deciding_states(rows);
+}
+
+template <typename T>
+void fsm::CompiledFSM<T>::mark_deciding_states(const std::vector<fsm::SparseRow> &rows) {
+    uint32_t n = rows.size(), columns = alphabet_.size();
+
+    // Reverse adjacency in CSR form, one edge per distinct (source, target) pair.
+    std::vector<uint32_t> offsets(n + 1, 0), sources;
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    for (uint32_t s = 0; s < n; s++) {
+        const fsm::SparseRow &row = rows[s];
+        if (row.exceptions.size() < columns) {
+            edges.emplace_back(row.default_target, s);
+        }
+        for (const auto &exception : row.exceptions) {
+            edges.emplace_back(exception.second, s);
+        }
+    }
+    for (const auto &edge : edges) {
+        offsets[edge.first + 1]++;
+    }
+    for (uint32_t s = 0; s < n; s++) {
+        offsets[s + 1] += offsets[s];
+    }
+    sources.resize(edges.size());
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (const auto &edge : edges) {
+        sources[cursor[edge.first]++] = edge.second;
+    }
+
+    // Every state that reaches a state matching **seed** backwards is marked **reached**.
+    auto propagate = [&](bool seed_final, std::vector<uint8_t> &reached) {
+        std::vector<uint32_t> stack;
+        for (uint32_t s = 0; s < n; s++) {
+            if (((flags_[s] & FINAL) != 0) == seed_final) {
+                reached[s] = 1;
+                stack.push_back(s);
+            }
+        }
+        while (!stack.empty()) {
+            uint32_t s = stack.back();
+            stack.pop_back();
+            for (uint32_t i = offsets[s]; i < offsets[s + 1]; i++) {
+                if (!reached[sources[i]]) {
+                    reached[sources[i]] = 1;
+                    stack.push_back(sources[i]);
+                }
+            }
+        }
+    };
+
+    std::vector<uint8_t> reaches_final(n, 0), reaches_rejecting(n, 0);
+    propagate(true, reaches_final);
+    propagate(false, reaches_rejecting);
+
+    for (uint32_t s = 0; s < n; s++) {
+        if (!reaches_final[s]) {
+            flags_[s] |= DEAD;
+        }
+        if (!reaches_rejecting[s]) {
+            flags_[s] |= ALWAYS_ACCEPTING;
+        }
+    }
+}
+
+template <typename T>
+uint32_t fsm::CompiledFSM<T>::get_states_count() const {
+    return states_.size();
+}
+
+template <typename T>
+const fsm::State &fsm::CompiledFSM<T>::get_state(uint32_t id) const {
+    return states_[id];
+}
+
+template <typename T>
+uint32_t fsm::CompiledFSM<T>::get_alphabet_count() const {
+    return alphabet_.size();
+}
+
+template <typename T>
+const std::vector<T> &fsm::CompiledFSM<T>::get_alphabet() const {
+    return alphabet_;
+}
+
+template <typename T>
+uint32_t fsm::CompiledFSM<T>::get_initial_state() const {
+    return initial_state_;
+}
+
+template <typename T>
+bool fsm::CompiledFSM<T>::is_final_state(uint32_t id) const {
+    return (flags_[id] & FINAL) != 0;
+}
+
+template <typename T>
+const fsm::Label &fsm::CompiledFSM<T>::get_label(uint32_t id) const {
+    return labels_[id];
+}
+
+template <typename T>
+bool fsm::CompiledFSM<T>::is_dead_state(uint32_t id) const {
+    return (flags_[id] & DEAD) != 0;
+}
+
+template <typename T>
+bool fsm::CompiledFSM<T>::is_always_accepting(uint32_t id) const {
+    return (flags_[id] & ALWAYS_ACCEPTING) != 0;
+}
+
+template <typename T>
+bool fsm::CompiledFSM<T>::is_decided(uint32_t id) const {
+    return (flags_[id] & DECIDED) != 0;
+}
+
+template <typename T>
+fsm::Layout fsm::CompiledFSM<T>::get_layout() const {
+    return layout_;
+}
+
+template <typename T>
+unsigned fsm::CompiledFSM<T>::get_state_id_size() const {
+    return id_size_;
+}
+
+template <typename T>
+uint32_t fsm::CompiledFSM<T>::column_of(T symbol) const {
+    return symbols_.column(symbol);
+}
+
+template <typename T>
+template <typename Policy, typename Table>
+uint32_t fsm::CompiledFSM<T>::walk(const Table &table, uint32_t state, const T *word, std::size_t length,
+    std::size_t &consumed, Policy &policy) const {
+    std::size_t i = 0;
+    if ((flags_[state] & DECIDED) == 0) {
+        for (; i < length; i++) {
+            uint32_t column;
+            if constexpr (Policy::checked) {
+                column = symbols_.column(word[i]);
+                if (column == fsm::SymbolMap<T>::npos) {
+                    policy.fail(fsm::Error::NotInAlphabet, i);
+                    break;
+                }
+            } else {
+                column = symbols_.column_unchecked(word[i]);
+            }
+            state = table.next(state, column);
+            if ((flags_[state] & DECIDED) != 0) {
+                i++;
+                break;
+            }
+        }
+    }
+    consumed = i;
+    return state;
+}
+
+template <typename T>
+uint32_t fsm::CompiledFSM<T>::feed(uint32_t state, const T *symbols, std::size_t length, std::size_t &consumed) const {
+    // Dispatch on the table once per call so the inner loop is specialised.
+    return with_table([&](const auto &table) {
+        fsm::Throwing policy;
+        return walk(table, state, symbols, length, consumed, policy);
+    });
+}
+
+template <typename T>
+uint32_t fsm::CompiledFSM<T>::feed(uint32_t state, const T *symbols, std::size_t length, std::size_t &consumed,
+    fsm::ErrorCode &error) const {
+    error = fsm::ErrorCode();
+    return with_table([&](const auto &table) {
+        return walk(table, state, symbols, length, consumed, error);
+    });
+}
+
+template <typename T>
+uint32_t fsm::CompiledFSM<T>::feed(uint32_t state, const T *symbols, std::size_t length, std::size_t &consumed,
+    fsm::Unchecked policy) const {
+    return with_table([&](const auto &table) {
+        return walk(table, state, symbols, length, consumed, policy);
+    });
+}
+
+template <typename T>
+bool fsm::CompiledFSM<T>::evaluate(const T *word, std::size_t length, std::size_t &consumed) const {
+    return (flags_[feed(initial_state_, word, length, consumed)] & FINAL) != 0;
+}
+
+template <typename T>
+bool fsm::CompiledFSM<T>::evaluate(const T *word, std::size_t length) const {
+    std::size_t consumed;
+    return evaluate(word, length, consumed);
+}
+
+template <typename T>
+bool fsm::CompiledFSM<T>::evaluate(const std::vector<T> &word) const {
+    return evaluate(word.data(), word.size());
+}
+
+template <typename T>
+bool fsm::CompiledFSM<T>::evaluate(const T *word, std::size_t length, fsm::ErrorCode &error) const {
+    // feed() clears the error first, so a reused ErrorCode only reports this word.
+    std::size_t consumed;
+    uint32_t state = feed(initial_state_, word, length, consumed, error);
+    return !error.failed() && (flags_[state] & FINAL) != 0;
+}
+
+template <typename T>
+bool fsm::CompiledFSM<T>::evaluate(const T *word, std::size_t length, fsm::Unchecked policy) const {
+    std::size_t consumed;
+    return (flags_[feed(initial_state_, word, length, consumed, policy)] & FINAL) != 0;
+}
+
+template <typename T>
+std::size_t fsm::CompiledFSM<T>::validate(const T *symbols, std::size_t length) const {
+    return symbols_.validate(symbols, length);
+}
+
+template <typename T>
+std::size_t fsm::CompiledFSM<T>::evaluate_batch(const T *const *words, const std::size_t *lengths, std::size_t count,
+    bool *results, std::size_t *consumed) const {
+    return with_table([&](const auto &table) {
+        std::size_t accepted = 0, read;
+        fsm::Throwing policy;
+        for (std::size_t i = 0; i < count; i++) {
+            uint32_t state = walk(table, initial_state_, words[i], lengths[i], read, policy);
+            results[i] = (flags_[state] & FINAL) != 0;
+            accepted += results[i];
+            if (consumed != nullptr) {
+                consumed[i] = read;
+            }
+        }
+        return accepted;
+    });
+}
+
+template <typename T>
+std::size_t fsm::CompiledFSM<T>::memory_usage() const {
+    std::size_t table = with_table([](const auto &table) {
+        return table.memory_usage();
+    });
+    return table + symbols_.memory_usage() + alphabet_.capacity() * sizeof(T) + flags_.capacity()
+        + labels_.capacity() * sizeof(fsm::Label);
+}
+
+template <typename T>
+void fsm::CompiledFSM<T>::profile(const T *word, std::size_t length, std::vector<uint64_t> &visits) const {
+    visits.resize(states_.size(), 0);
+    uint32_t state = initial_state_;
+    visits[state]++;
+    for (std::size_t i = 0; i < length && (flags_[state] & DECIDED) == 0; i++) {
+        uint32_t column = symbols_.column(word[i]);
+        if (column == fsm::SymbolMap<T>::npos) {
+            throw AutomationException("Input is not in alphabet", __FILE__, __LINE__);
+        }
+        state = next(state, column);
+        visits[state]++;
+    }
+}
+
+template <typename T>
+std::vector<uint32_t> fsm::CompiledFSM<T>::bfs_order() const {
+    uint32_t n = states_.size(), columns = alphabet_.size();
+    std::vector<uint32_t> order;
+    std::vector<uint8_t> seen(n, 0);
+    order.reserve(n);
+    if (n == 0) {
+        return order;
+    }
+
+    // The queue is the order itself, unreachable states are appended after it drains.
+    order.push_back(initial_state_);
+    seen[initial_state_] = 1;
+    for (uint32_t head = 0, unreached = 0; order.size() < n; head++) {
+        if (head == order.size()) {
+            while (seen[unreached]) {
+                unreached++;
+            }
+            order.push_back(unreached);
+            seen[unreached] = 1;
+        }
+        for (uint32_t j = 0; j < columns; j++) {
+            uint32_t target = next(order[head], j);
+            if (!seen[target]) {
+                seen[target] = 1;
+                order.push_back(target);
+            }
+        }
+    }
+    return order;
+}
+
+template <typename T>
+std::vector<uint32_t> fsm::CompiledFSM<T>::profile_order(const std::vector<uint64_t> &visits) const {
+    std::vector<uint32_t> order = bfs_order();
+    auto visits_of = [&visits](uint32_t id) {
+        return id < visits.size() ? visits[id] : 0;
+    };
+    std::stable_sort(order.begin(), order.end(), [&visits_of](uint32_t a, uint32_t b) {
+        return visits_of(a) > visits_of(b);
+    });
+    return order;
+}
+
+template <typename T>
+fsm::CompiledFSM<T> fsm::CompiledFSM<T>::relayout(const std::vector<uint32_t> &order) const {
+    uint32_t n = states_.size(), columns = alphabet_.size();
+    std::vector<uint32_t> ids(n, n);
+    if (order.size() != n) {
+        throw AutomationException("The order is not a permutation of the states", __FILE__, __LINE__);
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        if (order[i] >= n || ids[order[i]] != n) {
+            throw AutomationException("The order is not a permutation of the states", __FILE__, __LINE__);
+        }
+        ids[order[i]] = i;
+    }
+
+    fsm::CompiledFSM<T> machine;
+    machine.alphabet_ = alphabet_;
+    machine.symbols_ = symbols_;
+    machine.initial_state_ = ids[initial_state_];
+    machine.states_.clear();
+    machine.states_.reserve(n);
+    machine.flags_.assign(n, 0);
+    machine.labels_.assign(n, fsm::Label{0, 0});
+
+    std::vector<uint32_t> cells(columns);
+    std::vector<fsm::SparseRow> rows;
+    rows.reserve(n);
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t old = order[i];
+        machine.states_.push_back(states_[old]);
+        machine.flags_[i] = flags_[old] & FINAL;
+        machine.labels_[i] = labels_[old];
+        for (uint32_t j = 0; j < columns; j++) {
+            cells[j] = ids[next(old, j)];
+        }
+        rows.push_back(fsm::make_sparse_row(cells.data(), columns));
+    }
+    machine.build_table(rows, layout_);
+    return machine;
+}
+
+template <typename T>
+void fsm::CompiledFSM<T>::relayout_file(const char *source, const char *target, const std::vector<uint64_t> &visits) {
+    fsm::CompiledFSM<T> machine = load(source);
+    std::vector<uint32_t> order = visits.empty() ? machine.bfs_order() : machine.profile_order(visits);
+    // The target can be the source, so it is only replaced once the new file is complete.
+    fsm::String temporary = fsm::String(target) + ".tmp";
+    try {
+        machine.relayout(order).save(temporary.c_str());
+    } catch (...) {
+        std::remove(temporary.c_str());
+        throw;
+    }
+    if (std::rename(temporary.c_str(), target) != 0) {
+        std::remove(temporary.c_str());
+        throw AutomationException("Cannot write the machine file", __FILE__, __LINE__);
+    }
+}
+
+template <typename T>
+void fsm::CompiledFSM<T>::save(const char *path) const {
+    std::ofstream out(path, std::ios::binary);
+    uint32_t n = states_.size(), columns = alphabet_.size();
+    fsm::MachineFileHeader header = fsm::MachineFileHeader::make(sizeof(T), columns, n, initial_state_);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(alphabet_.data()), columns * sizeof(T));
+
+    std::vector<uint32_t> row(columns);
+    for (uint32_t s = 0; s < n; s++) {
+        for (uint32_t j = 0; j < columns; j++) {
+            row[j] = next(s, j);
+        }
+        out.write(reinterpret_cast<const char*>(row.data()), columns * sizeof(uint32_t));
+    }
+
+    std::vector<uint8_t> finals(n);
+    std::vector<uint32_t> labels;
+    for (uint32_t s = 0; s < n; s++) {
+        finals[s] = flags_[s] & FINAL;
+        if (finals[s] && (labels_[s].token != 0 || labels_[s].priority != 0)) {
+            labels.insert(labels.end(), {s, labels_[s].token, (uint32_t)labels_[s].priority});
+        }
+    }
+    uint32_t labels_count = labels.size() / 3;
+    out.write(reinterpret_cast<const char*>(finals.data()), n);
+    out.write(reinterpret_cast<const char*>(&labels_count), sizeof(labels_count));
+    out.write(reinterpret_cast<const char*>(labels.data()), labels.size() * sizeof(uint32_t));
+    out.flush();
+    if (!out) {
+        throw AutomationException("Cannot write the machine file", __FILE__, __LINE__);
+    }
+}
+
+template <typename T>
+fsm::CompiledFSM<T> fsm::CompiledFSM<T>::load(const char *path, fsm::Layout layout) {
+    std::ifstream in(path, std::ios::binary);
+    fsm::MachineFileHeader header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || !header.is_valid()) {
+        throw AutomationException("Not a machine file", __FILE__, __LINE__);
+    }
+    if (header.symbol_size != sizeof(T)) {
+        throw AutomationException("The machine file has another symbol type", __FILE__, __LINE__);
+    }
+
+    uint32_t n = header.states_count, columns = header.alphabet_count;
+    std::vector<T> alphabet(columns);
+    in.read(reinterpret_cast<char*>(alphabet.data()), columns * sizeof(T));
+
+    std::vector<uint32_t> cells(columns);
+    std::vector<fsm::SparseRow> rows;
+    rows.reserve(n);
+    for (uint32_t s = 0; s < n && in; s++) {
+        in.read(reinterpret_cast<char*>(cells.data()), columns * sizeof(uint32_t));
+        rows.push_back(fsm::make_sparse_row(cells.data(), columns));
+    }
+
+    std::vector<uint8_t> finals(n);
+    std::vector<uint32_t> final_ids;
+    uint32_t labels_count = 0;
+    in.read(reinterpret_cast<char*>(finals.data()), n);
+    in.read(reinterpret_cast<char*>(&labels_count), sizeof(labels_count));
+    std::vector<uint32_t> labels((std::size_t)labels_count * 3);
+    in.read(reinterpret_cast<char*>(labels.data()), labels.size() * sizeof(uint32_t));
+    if (!in) {
+        throw AutomationException("The machine file is truncated", __FILE__, __LINE__);
+    }
+    for (uint32_t s = 0; s < n; s++) {
+        if (finals[s]) {
+            final_ids.push_back(s);
+        }
+    }
+
+    fsm::CompiledFSM<T> machine(alphabet, rows, header.initial_state, final_ids, layout);
+    for (std::size_t i = 0; i < labels.size(); i += 3) {
+        if (labels[i] >= n) {
+            throw AutomationException("At least one final state is not a valid state", __FILE__, __LINE__);
+        }
+        machine.labels_[labels[i]] = fsm::Label{labels[i + 1], (int)labels[i + 2]};
+    }
+    return machine;
+}
+
+fsm::MachineFileHeader fsm::MachineFileHeader::make(uint32_t symbol_size, uint32_t alphabet_count,
+    uint32_t states_count, uint32_t initial_state) {
+    return fsm::MachineFileHeader{{'F', 'S', 'M', 'C'}, VERSION, symbol_size, alphabet_count, states_count, initial_state};
+}
+
+bool fsm::MachineFileHeader::is_valid() const {
+    return std::memcmp(magic, "FSMC", sizeof(magic)) == 0 && version == VERSION;
+}
+
+template class fsm::CompiledFSM<int>;
+template class fsm::CompiledFSM<char>;
@@ -0,0 +1,382 @@
+#ifndef AUTOMATA_COMPILED_FSM_H
+#define AUTOMATA_COMPILED_FSM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "error_policy.h"
+#include "fsm.h"
+#include "state.h"
+#include "symbol_map.h"
+#include "transition_table.h"
+
+namespace fsm {
+    template <typename T>
+    class FSMBuilder;
+
+    /**
+     * The header of a compiled machine file. It is followed by the alphabet, the transition
+     * table row by row as uint32 ids, one final flag byte per state, the number of labels and
+     * the labels of the labelled final states as (id, token, priority).
+     */
+    struct MachineFileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t symbol_size;
+        uint32_t alphabet_count;
+        uint32_t states_count;
+        uint32_t initial_state;
+
+        static constexpr uint32_t VERSION = 1;
+
+        /**
+         * Returns a header with the magic and version filled in.
+         */
+        static MachineFileHeader make(uint32_t symbol_size, uint32_t alphabet_count, uint32_t states_count, uint32_t initial_state);
+
+        /**
+         * Returns true if the magic and version match.
+         */
+        bool is_valid() const;
+    };
+
+    /**
+     * CompiledFSM is an immutable, id based form of an FSM meant for evaluation.
+     * States are numbered 0..n-1 in the order of the source machine, symbols are
+     * mapped to table columns in O(1) and the transition table is stored either
+     * densely or, for large and sparse alphabets, with comb-vector packing.
+     * Dense tables store each id in 1, 2 or 4 bytes, the least the states count allows.
+     * States that decide the outcome of a word (dead states that can never reach
+     * a final state and states from which every reachable state is final) are
+     * detected when compiling, so evaluation can stop as soon as one is entered.
+     */
+    template <typename T>
+    class CompiledFSM {
+    private:
+        std::vector<T> alphabet_;
+        fsm::SymbolMap<T> symbols_;
+        std::vector<fsm::State> states_;
+        uint32_t initial_state_;
+        std::vector<uint8_t> flags_;
+        std::vector<fsm::Label> labels_;
+        fsm::Layout layout_;
+        unsigned id_size_;
+        fsm::DenseTable<uint8_t> dense8_;
+        fsm::DenseTable<uint16_t> dense16_;
+        fsm::DenseTable<uint32_t> dense32_;
+        fsm::CombTable comb_;
+
+        static constexpr uint8_t FINAL = 1;
+        static constexpr uint8_t DEAD = 2;
+        static constexpr uint8_t ALWAYS_ACCEPTING = 4;
+        static constexpr uint8_t DECIDED = DEAD | ALWAYS_ACCEPTING;
+
+        friend class fsm::FSMBuilder<T>;
+    public:
+        /**
+         * Creates a machine with an empty alphabet and a single non-final state, which
+         * accepts nothing. The state is dead, so every evaluation returns false at once.
+         */
+        CompiledFSM();
+
+        /**
+         * Compiles an FSM.
+         * @param FSM<T> &machine: The machine to compile. Every cell of its transition table must name one of its states.
+         * @param Layout layout: The table layout, Layout::Auto picks one based on density.
+         */
+        CompiledFSM(const fsm::FSM<T> &machine, fsm::Layout layout = fsm::Layout::Auto);
+
+        /**
+         * Builds a machine directly from sparse rows, without going through a dense FSM.
+         * States are named by their id.
+         * @param vector<T> &alphabet: The alphabet, column i of every row belongs to alphabet[i].
+         * @param vector<SparseRow> &rows: One row per state.
+         * @param uint32_t initial_state: Id of the initial state.
+         * @param vector<uint32_t> &final_states: Ids of the final states.
+         * @param Layout layout: The table layout, Layout::Auto picks one based on density.
+         */
+        CompiledFSM(const std::vector<T> &alphabet, const std::vector<fsm::SparseRow> &rows,
+            uint32_t initial_state, const std::vector<uint32_t> &final_states,
+            fsm::Layout layout = fsm::Layout::Auto);
+
+        /**
+         * Returns the number of states.
+         */
+        uint32_t get_states_count() const;
+
+        /**
+         * Returns the State with the given id.
+         */
+        const fsm::State &get_state(uint32_t id) const;
+
+        /**
+         * Returns the number of symbols in the alphabet.
+         */
+        uint32_t get_alphabet_count() const;
+
+        /**
+         * Returns the alphabet, indexed by column.
+         */
+        const std::vector<T> &get_alphabet() const;
+
+        /**
+         * Returns the id of the initial state.
+         */
+        uint32_t get_initial_state() const;
+
+        /**
+         * Returns true if the state with the given id is a final state.
+         */
+        bool is_final_state(uint32_t id) const;
+
+        /**
+         * Returns the label of the state with the given id, meaningful for final states only.
+         * Final states without a label carry token 0 with priority 0.
+         */
+        const fsm::Label &get_label(uint32_t id) const;
+
+        /**
+         * Returns true if no final state can be reached from the state with the given id.
+         */
+        bool is_dead_state(uint32_t id) const;
+
+        /**
+         * Returns true if every state reachable from the state with the given id is final.
+         */
+        bool is_always_accepting(uint32_t id) const;
+
+        /**
+         * Returns true if the outcome of any word is already known once the state is entered.
+         */
+        bool is_decided(uint32_t id) const;
+
+        /**
+         * Returns the layout chosen for the transition table.
+         */
+        fsm::Layout get_layout() const;
+
+        /**
+         * Returns the number of bytes per state id in the transition table, 1, 2 or 4.
+         */
+        unsigned get_state_id_size() const;
+
+        /**
+         * Returns the column of a symbol or SymbolMap<T>::npos if it is not in the alphabet.
+         */
+        uint32_t column_of(T symbol) const;
+
+        /**
+         * Returns the state reached from **state** with the symbol at **column**.
+         */
+        uint32_t next(uint32_t state, uint32_t column) const;
+
+        /**
+         * Returns true if the word is recognised by the machine.
+         * Throws AutomationException if a symbol is not in the alphabet.
+         * @param T *word: The symbols of the word.
+         * @param size_t length: Number of symbols in the word.
+         */
+        bool evaluate(const T *word, std::size_t length) const;
+
+        /**
+         * Returns true if the word is recognised by the machine.
+         * @param vector<T> &word: The symbols of the word.
+         */
+        bool evaluate(const std::vector<T> &word) const;
+
+        /**
+         * Returns true if the word is recognised by the machine.
+         * Stops reading as soon as the machine enters a dead or always accepting state,
+         * the symbols after that point are not checked against the alphabet.
+         * @param T *word: The symbols of the word.
+         * @param size_t length: Number of symbols in the word.
+         * @param size_t &consumed: Set to the number of symbols read.
+         */
+        bool evaluate(const T *word, std::size_t length, std::size_t &consumed) const;
+
+        /**
+         * Feeds a chunk of a stream to the machine and returns the state it ends in.
+         * Feeding stops early when a deciding state is entered, see is_decided.
+         * @param uint32_t state: The state the stream is in, get_initial_state() for a new stream.
+         * @param T *symbols: The symbols of the chunk.
+         * @param size_t length: Number of symbols in the chunk.
+         * @param size_t &consumed: Set to the number of symbols read.
+         */
+        uint32_t feed(uint32_t state, const T *symbols, std::size_t length, std::size_t &consumed) const;
+
+        /**
+         * Returns true if the word is recognised by the machine, false if it is not or if a symbol
+         * is not in the alphabet, which is recorded in **error** instead of thrown.
+         * @param T *word: The symbols of the word.
+         * @param size_t length: Number of symbols in the word.
+         * @param ErrorCode &error: Receives the error and the position of the offending symbol, it is cleared on every call.
+         */
+        bool evaluate(const T *word, std::size_t length, fsm::ErrorCode &error) const;
+
+        /**
+         * Returns true if the word is recognised by the machine, without checking the symbols.
+         * The word must have passed validate(), the inner loop then has no error branch.
+         * @param T *word: The symbols of the word.
+         * @param size_t length: Number of symbols in the word.
+         * @param Unchecked policy: Selects the unchecked loop.
+         */
+        bool evaluate(const T *word, std::size_t length, fsm::Unchecked policy) const;
+
+        /**
+         * feed() that stops at a symbol outside the alphabet and records it in **error**.
+         * **consumed** is then the position of that symbol.
+         * @param uint32_t state: The state the stream is in, get_initial_state() for a new stream.
+         * @param T *symbols: The symbols of the chunk.
+         * @param size_t length: Number of symbols in the chunk.
+         * @param size_t &consumed: Set to the number of symbols read.
+         * @param ErrorCode &error: Receives the error and the position of the offending symbol, it is cleared on every call.
+         */
+        uint32_t feed(uint32_t state, const T *symbols, std::size_t length, std::size_t &consumed,
+            fsm::ErrorCode &error) const;
+
+        /**
+         * feed() without checking the symbols, which must have passed validate().
+         * @param uint32_t state: The state the stream is in, get_initial_state() for a new stream.
+         * @param T *symbols: The symbols of the chunk.
+         * @param size_t length: Number of symbols in the chunk.
+         * @param size_t &consumed: Set to the number of symbols read.
+         * @param Unchecked policy: Selects the unchecked loop.
+         */
+        uint32_t feed(uint32_t state, const T *symbols, std::size_t length, std::size_t &consumed,
+            fsm::Unchecked policy) const;
+
+        /**
+         * Checks a whole buffer against the alphabet at once, with SIMD lookups where the CPU
+         * and the alphabet allow it. Returns the position of the first symbol outside the
+         * alphabet, or **length** if there is none.
+         * @param T *symbols: The symbols to check.
+         * @param size_t length: Number of symbols.
+         */
+        std::size_t validate(const T *symbols, std::size_t length) const;
+
+        /**
+         * Evaluates a batch of words, stopping each one as soon as its outcome is decided.
+         * Returns the number of accepted words.
+         * @param T **words: The words to evaluate.
+         * @param size_t *lengths: The number of symbols in each word.
+         * @param size_t count: Number of words.
+         * @param bool *results: Receives the verdict for each word.
+         * @param size_t *consumed: Receives the number of symbols read from each word, can be nullptr.
+         */
+        std::size_t evaluate_batch(const T *const *words, const std::size_t *lengths, std::size_t count,
+            bool *results, std::size_t *consumed = nullptr) const;
+
+        /**
+         * Adds one visit to every state entered while reading the word, the initial state included.
+         * Reading stops where evaluate() would stop. **visits** is resized to the number of states.
+         * Throws AutomationException if a symbol is not in the alphabet.
+         * @param T *word: The symbols of the word.
+         * @param size_t length: Number of symbols in the word.
+         * @param vector<uint64_t> &visits: The visit counts, indexed by state id.
+         */
+        void profile(const T *word, std::size_t length, std::vector<uint64_t> &visits) const;
+
+        /**
+         * Returns the states in breadth-first order from the initial state, followed by the
+         * unreachable ones. States read one after the other end up in neighbouring rows.
+         */
+        std::vector<uint32_t> bfs_order() const;
+
+        /**
+         * Returns the states by decreasing visit count, so the hottest rows share the first
+         * cache lines and pages of the table. Ties keep their breadth-first order.
+         * @param vector<uint64_t> &visits: The visit counts from profile(), missing entries count as 0.
+         */
+        std::vector<uint32_t> profile_order(const std::vector<uint64_t> &visits) const;
+
+        /**
+         * Returns a copy of the machine with the states renumbered, state i of the copy is state
+         * order[i] of this machine. Names, labels and the layout are kept.
+         * Throws AutomationException if **order** is not a permutation of the state ids.
+         * @param vector<uint32_t> &order: The old id of every new id.
+         */
+        fsm::CompiledFSM<T> relayout(const std::vector<uint32_t> &order) const;
+
+        /**
+         * Renumbers the states of a machine file, see relayout(). Without visit counts the
+         * breadth-first order is used, otherwise the profile order.
+         * Throws AutomationException if a file cannot be read or written.
+         * @param char *source: The machine file to read.
+         * @param char *target: The file to write, it can be the same as **source**. The new machine is
+         * written next to it and renamed over it, so a failed write leaves the old file intact.
+         * @param vector<uint64_t> &visits: The visit counts from profile(), indexed by the ids of **source**.
+         */
+        static void relayout_file(const char *source, const char *target, const std::vector<uint64_t> &visits = {});
+
+        /**
+         * Returns the number of bytes used by the compiled machine, excluding state names.
+         */
+        std::size_t memory_usage() const;
+
+        /**
+         * Writes the machine to a binary file, see MachineFileHeader. State names are not saved.
+         * Throws AutomationException if the file cannot be written.
+         * @param char *path: The path to the file.
+         */
+        void save(const char *path) const;
+
+        /**
+         * Reads a machine written by save() or ExternalProduct, its states are named by their id.
+         * Throws AutomationException if the file is not a machine of this symbol type or is truncated.
+         * @param char *path: The path to the file.
+         * @param Layout layout: The table layout, Layout::Auto picks one based on density.
+         */
+        static fsm::CompiledFSM<T> load(const char *path, fsm::Layout layout = fsm::Layout::Auto);
+    private:
+
+        /**
+         * Picks the layout and builds the transition table from sparse rows.
+         */
+        void build_table(const std::vector<fsm::SparseRow> &rows, fsm::Layout layout);
+
+        /**
+         * Marks dead and always accepting states by walking the reversed transitions.
+         */
+        void mark_deciding_states(const std::vector<fsm::SparseRow> &rows);
+
+        /**
+         * Walks the symbols through the given table until they run out or a deciding state is entered.
+         * **policy** handles symbols outside the alphabet, see error_policy.h.
+         */
+        template <typename Policy, typename Table>
+        uint32_t walk(const Table &table, uint32_t state, const T *word, std::size_t length, std::size_t &consumed,
+            Policy &policy) const;
+
+        /**
+         * Calls **body** with the transition table in use, so loops over it are specialised for its type.
+         */
+        template <typename Body>
+        auto with_table(Body body) const -> decltype(body(comb_));
+    };
+
+    template <typename T>
+    inline uint32_t CompiledFSM<T>::next(uint32_t state, uint32_t column) const {
+        return with_table([state, column](const auto &table) {
+            return table.next(state, column);
+        });
+    }
+
+    template <typename T>
+    template <typename Body>
+    inline auto CompiledFSM<T>::with_table(Body body) const -> decltype(body(comb_)) {
+        if (layout_ == fsm::Layout::Comb) {
+            return body(comb_);
+        }
+        switch (id_size_) {
+            case sizeof(uint8_t):
+                return body(dense8_);
+            case sizeof(uint16_t):
+                return body(dense16_);
+            default:
+                return body(dense32_);
+        }
+    }
+}
+
+#endif //AUTOMATA_COMPILED_FSM_H
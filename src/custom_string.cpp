@@ -1,9 +1,10 @@
 #include <cstring>
+#include <utility>
 
 #include "custom_string.h"
 
-fsm::String::String() : str_(new char[2]) {
-    strcpy(str_, "");
+fsm::String::String() : str_(new char[1]) {
+    str_[0] = '\0';
 }
 
 fsm::String::String(const char *str) : str_(new char[strlen(str)+1]) {
@@ -11,7 +12,7 @@ fsm::String::String(const char *str) : str_(new char[strlen(str)+1]) {
 }
 
 fsm::String::String(int n) {
-    int length = snprintf(nullptr, 0,"%d",42);
+    int length = snprintf(nullptr, 0, "%d", n);
     str_ = new char[length + 1];
     sprintf(str_, "%d", n);
 }
@@ -20,16 +21,41 @@ fsm::String::String(const fsm::String &other) : str_(new char[strlen(other.str_)
     std::strcpy(str_, other.str_);
 }
 
+fsm::String::String(fsm::String &&other) noexcept : str_(other.str_) {
+    other.str_ = nullptr;
+}
+
 fsm::String::~String() {
-    //delete str_; // str_ needs to be deleted, but if done so, shit hits the fan.
+    delete[] str_;
+}
+
+fsm::String& fsm::String::operator=(const fsm::String &rhs) {
+    if (this != &rhs) {
+        char *copy = new char[strlen(rhs.str_) + 1];
+        std::strcpy(copy, rhs.str_);
+        delete[] str_;
+        str_ = copy;
+    }
+
+    return *this;
+}
+
+fsm::String& fsm::String::operator=(fsm::String &&rhs) noexcept {
+    std::swap(str_, rhs.str_);
+
+    return *this;
 }
 
 const char* fsm::String::to_char_array() const {
-    char* str_cpy = new char[strlen(str_)];
+    char* str_cpy = new char[strlen(str_) + 1];
     std::strcpy(str_cpy, str_);
     return str_cpy;
 }
 
+const char* fsm::String::c_str() const {
+    return str_;
+}
+
 int fsm::String::size() const {
     return std::strlen(str_);
 }
@@ -54,7 +80,7 @@ std::istream& fsm::String::ext(std::istream& in)
 
     in >> newStr;
 
-    delete str_;
+    delete[] str_;
 
     str_ = new char[strlen(newStr) + 1];
     strcpy(str_, newStr);
@@ -75,6 +101,7 @@ fsm::String fsm::String::operator+(const fsm::String &rhs) const {
     strcat(concatenation, rhs.str_);
 
     fsm::String res(concatenation);
+    delete[] concatenation;
 
     return res;
 }
@@ -96,6 +123,15 @@ bool fsm::String::operator<(const fsm::String &rhs) const {
     return true;
 }
 
+std::size_t fsm::String::hash() const {
+    // FNV-1a
+    std::size_t h = 14695981039346656037ull;
+    for (const char *c = str_; *c != '\0'; c++) {
+        h = (h ^ (unsigned char)*c) * 1099511628211ull;
+    }
+    return h;
+}
+
 char fsm::String::operator[](unsigned i) const {
     return str_[i];
 }
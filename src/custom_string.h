@@ -1,6 +1,8 @@
 #ifndef AUTOMATA_CUSTOM_STRING_H
 #define AUTOMATA_CUSTOM_STRING_H
 
+#include <cstddef>
+#include <functional>
 #include <iostream>
 
 namespace fsm {
@@ -33,16 +35,39 @@ namespace fsm {
          */
         String(const fsm::String& other);
 
+        /**
+         * A move constructor. **other** can only be assigned to or destroyed afterwards.
+         * @param String&& other: A string whose content will be taken over.
+         */
+        String(fsm::String&& other) noexcept;
+
         /**
          * A destructor for the String class.
          */
         ~String();
 
         /**
-         * Returns a char array with the content of the String.
+         * An assignment operator.
+         * @param String& rhs: A string that will be copied to **this**.
+         */
+        fsm::String& operator=(const fsm::String& rhs);
+
+        /**
+         * A move assignment operator. Swaps the contents of **this** and **rhs**.
+         * @param String&& rhs: A string whose content will be taken over.
+         */
+        fsm::String& operator=(fsm::String&& rhs) noexcept;
+
+        /**
+         * Returns a copy of the content of the String. The caller owns the array and has to delete[] it.
          */
         const char* to_char_array() const;
 
+        /**
+         * Returns the content of the String, valid until the String is changed or destroyed.
+         */
+        const char* c_str() const;
+
         /**
          * Returns the size of the String. That is, the number of characters in it.
          */
@@ -88,6 +113,11 @@ namespace fsm {
          */
         char operator[](unsigned i) const;
 
+        /**
+         * Returns a hash of the content of the String.
+         */
+        std::size_t hash() const;
+
         /**
          * Sets the value of the String to the content of the
          * provided input stream.
@@ -106,4 +136,16 @@ namespace fsm {
 
 }
 
+namespace std {
+    /**
+     * Hash support so Strings can be used as keys of unordered containers.
+     */
+    template <>
+    struct hash<fsm::String> {
+        std::size_t operator()(const fsm::String &s) const noexcept {
+            return s.hash();
+        }
+    };
+}
+
 #endif //AUTOMATA_CUSTOM_STRING_H
@@ -0,0 +1,770 @@
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "state.h"
+#include "fsm.h"
+#include "compiled_fsm.h"
+#include "range_fsm.h"
+#include "tokenizer.h"
+#include "fsm_builder.h"
+#include "dictionary_builder.h"
+#include "registry.h"
+#include "session_table.h"
+#include "op_cache.h"
+#include "external_product.h"
+#include "pattern.h"
+#include "matcher.h"
+#include "machine_set.h"
+#include "word_counter.h"
+#include "word_enumerator.h"
+#include "word_sampler.h"
+#include "approximate_matcher.h"
+#include "sample_machines.h"
+#include "automation_exception.h"
+#include "demo.h"
+
+void t1(){
+    fsm::State s1("s1"), s2("s2");
+    std::vector<fsm::State> states = {s1, s2};
+    std::vector<int> alphabet = {0, 1};
+    fsm::State &final_state = s2;
+    std::vector<fsm::State> final_states = {final_state};
+    fsm::State &initial_state = s1;
+    std::vector<std::vector<fsm::State>> transition_table = {
+            {states[0], states[1]},
+            {states[1], states[1]},
+    };
+    fsm::FSM<int> machine(states, alphabet, initial_state, final_states, transition_table);
+    std::cout << "is in final state: " << machine.is_in_final_state() << std::endl;
+    machine.transition(0);
+    std::cout << "is in final state: " << machine.is_in_final_state() << std::endl;
+    machine.transition(1);
+    std::cout << "is in final state: " << machine.is_in_final_state() << std::endl;
+    std::cout << "Current state: " << machine.get_current_state() << std::endl;
+    std::cout << "Restarting" << std::endl;
+    machine.restart();
+    std::cout << "Current state: " << machine.get_current_state() << std::endl;
+
+    fsm::State s3("s3");
+    machine.add_state(s3);
+    machine.add_transition_rule(s3, alphabet[0], s1);
+    machine.add_transition_rule(s3, alphabet[1], s2);
+
+    machine.set_initial_state(s3);
+    machine.transition(1);
+    std::cout << "Current state: " << machine.get_current_state() << std::endl;
+    std::cout << "is in final state: " << machine.is_in_final_state() << std::endl;
+}
+
+void t2(){
+    fsm::State s1("s1"), s2("s2"), s3("s3"), s4("s4"), s5("s5");
+    std::vector<fsm::State> states1 = {s1, s2, s3};
+    std::vector<fsm::State> states2 = {s4, s5};
+
+    std::vector<int> alphabet = {0, 1};
+
+    fsm::State &initial_state1 = s1, &initial_state2 = s4;
+    fsm::State &final_state1 = s3, &final_state2 = s5;
+
+    std::vector<fsm::State> final_states1 = {final_state1};
+    std::vector<fsm::State> final_states2 = {final_state2};
+
+    std::vector<std::vector<fsm::State>> transition_table1 = {
+            {states1[2], states1[1]},
+            {states1[2], states1[0]},
+            {states1[1], states1[2]},
+    };
+    std::vector<std::vector<fsm::State>> transition_table2 = {
+            {states2[0], states2[1]},
+            {states2[1], states2[0]}
+    };
+
+    fsm::FSM<int> machine1(states1, alphabet, initial_state1, final_states1, transition_table1);
+    fsm::FSM<int> machine2(states2, alphabet, initial_state2, final_states2, transition_table2);
+
+    std::cout << (machine1 & machine2) << std::endl;
+}
+
+void t3() {
+    fsm::State s1("s1"), s2("s2"), s3("s3"), s4("s4");
+    std::vector<fsm::State> states1 = {s1, s2};
+    std::vector<fsm::State> states2 = {s3, s4};
+
+    std::vector<int> alphabet = {0, 1, 2};
+
+    fsm::State &initial_state1 = s1, &initial_state2 = s3;
+    fsm::State &final_state1 = s2, &final_state2 = s4;
+
+    std::vector<fsm::State> final_states1 = {final_state1};
+    std::vector<fsm::State> final_states2 = {final_state2};
+
+    std::vector<std::vector<fsm::State>> transition_table1 = {
+            {states1[0], states1[1], states1[1]},
+            {states1[0], states1[0], states1[1]}
+    };
+    std::vector<std::vector<fsm::State>> transition_table2 = {
+            {states2[0], states2[0], states2[1]},
+            {states2[0], states2[1], states2[0]}
+    };
+
+    fsm::FSM<int> machine1(states1, alphabet, initial_state1, final_states1, transition_table1);
+    fsm::FSM<int> machine2(states2, alphabet, initial_state2, final_states2, transition_table2);
+
+    std::cout << (machine1 & machine2) << std::endl;
+}
+
+void t4(){
+    fsm::State s1("s1"), s2("s2"), s3("s3"), s4("s4"), s5("s5"), s6("s6");
+    std::vector<fsm::State> states1 = {s1, s2, s3};
+    std::vector<fsm::State> states2 = {s4, s5, s6};
+
+    std::vector<int> alphabet = {0, 7};
+
+    fsm::State &initial_state1 = s1, &initial_state2 = s4;
+    fsm::State &final_state1 = s3, &final_state2 = s6;
+
+    std::vector<fsm::State> final_states1 = {final_state1};
+    std::vector<fsm::State> final_states2 = {final_state2};
+
+    std::vector<std::vector<fsm::State>> transition_table1 = {
+            {states1[1], states1[0]},
+            {states1[2], states1[0]},
+            {states1[2], states1[2]}
+    };
+    std::vector<std::vector<fsm::State>> transition_table2 = {
+            {states2[0], states2[1]},
+            {states2[0], states2[2]},
+            {states2[2], states2[2]}
+    };
+
+    fsm::FSM<int> machine1(states1, alphabet, initial_state1, final_states1, transition_table1);
+    fsm::FSM<int> machine2(states2, alphabet, initial_state2, final_states2, transition_table2);
+
+    std::cout << machine1.evaluate("07007") << std::endl;  // Recognises words containing "00".
+    std::cout << machine2.evaluate("07707") << std::endl;  // Recognises words containing "77".
+    std::cout << !machine2.evaluate("77007") << std::endl;  // Recognises words NOT containing "77".
+
+    // Recognises words containing "00" OR "77".
+    std::cout << (machine1 | machine2).evaluate("07070") << std::endl;
+    std::cout << (machine1 | machine2).evaluate("77070") << std::endl;
+
+    // Recognises words containing "00" AND NOT "77".
+    std::cout << (machine1 & !machine2).evaluate("700770") << std::endl;
+    std::cout << (machine1 & !machine2).evaluate("070070") << std::endl;
+}
+
+void t5() {
+
+    fsm::FSM<int> m1, m2;
+
+    std::cin >> m1 >> m2;
+
+    std::cout << m1 << std::endl;
+    std::cout << m2 << std::endl;
+
+    std::cout << (m1 | m2);
+}
+
+void t6() {
+    fsm::FSM<int> m1, m2;
+
+    std::ifstream f1("m1.txt");
+    std::ifstream f2("m2.txt");
+
+    f1 >> m1;
+    f2 >> m2;
+
+    std::cout << m1 << std::endl;
+    std::cout << m2 << std::endl;
+
+    std::cout << (m1 | m2);
+}
+
+void t7() {
+    fsm::FSM<int> m1("m1.txt"), m2;
+
+    m1.toTXT("m1Test.txt");
+    m2.fromTXT("m1Test.txt");
+
+    //these should be the same.
+    std::cout << m1 << std::endl;
+    std::cout << m2 << std::endl;
+}
+
+void t8() {
+    // Token ids 0..49999, accepts words containing the tokens 1000, 1001, ..., 1098 in a row.
+    std::vector<int> alphabet;
+    for (int i = 0; i < 50000; i++) {
+        alphabet.push_back(i);
+    }
+
+    std::vector<fsm::SparseRow> rows;
+    for (uint32_t i = 0; i < 99; i++) {
+        rows.push_back({0, {{1000, 1}, {1000 + i, i + 1}}});
+    }
+    rows[0].exceptions.pop_back();
+    rows.push_back({99, {}});
+
+    fsm::CompiledFSM<int> dense(alphabet, rows, 0, {99}, fsm::Layout::Dense);
+    fsm::CompiledFSM<int> sparse(alphabet, rows, 0, {99});
+
+    std::vector<int> word = {7, 1000};
+    for (int i = 1001; i < 1099; i++) {
+        word.push_back(i);
+    }
+
+    std::cout << "dense bytes: " << dense.memory_usage() << std::endl;
+    std::cout << "comb bytes: " << sparse.memory_usage() << std::endl;
+    std::cout << sparse.evaluate(word) << std::endl;
+    word[50] = 4242;
+    std::cout << sparse.evaluate(word) << std::endl;
+}
+
+void t9() {
+    fsm::State q0("q0"), q1("q1"), q2("q2"), q3("q3");
+
+    // Accepts a single id in [1000, 50000).
+    fsm::RangeFSM<int> machine1;
+    machine1.add_state(q0);
+    machine1.add_state(q1);
+    machine1.add_transition_rule(q0, 1000, 49999, q1);
+    machine1.add_final_state(q1);
+
+    // Accepts a single id that is not in [40000, 60000].
+    fsm::RangeFSM<int> machine2;
+    machine2.add_state(q2);
+    machine2.add_state(q3);
+    machine2.add_transition_rule(q2, INT32_MIN, INT32_MAX, q3);
+    machine2.add_transition_rule(q2, 40000, 60000, q2);
+    machine2.add_final_state(q3);
+
+    fsm::RangeFSM<int> both = machine1 & machine2;
+    std::cout << both;
+    std::cout << both.evaluate(std::vector<int>{39999}) << std::endl;
+    std::cout << both.evaluate(std::vector<int>{45000}) << std::endl;
+    std::cout << (!both).evaluate(std::vector<int>{45000}) << std::endl;
+}
+
+void t10() {
+    fsm::State s1("s1"), s2("s2"), s3("s3"), s4("s4");
+    std::vector<fsm::State> states = {s1, s2, s3, s4};
+    std::vector<int> alphabet = {0, 1};
+
+    // Accepts words starting with "01", s4 is a trap and s3 always accepts.
+    std::vector<std::vector<fsm::State>> transition_table = {
+            {s2, s4},
+            {s4, s3},
+            {s3, s3},
+            {s4, s4}
+    };
+
+    fsm::FSM<int> machine(states, alphabet, s1, {s3}, transition_table);
+    fsm::CompiledFSM<int> compiled(machine);
+
+    std::vector<int> word1 = {1, 0, 1, 1, 0, 1}, word2 = {0, 1, 1, 1, 0, 1};
+    std::size_t consumed;
+
+    std::cout << compiled.evaluate(word1.data(), word1.size(), consumed);
+    std::cout << " after " << consumed << " symbols" << std::endl;
+    std::cout << compiled.evaluate(word2.data(), word2.size(), consumed);
+    std::cout << " after " << consumed << " symbols" << std::endl;
+}
+
+void t11() {
+    fsm::State s1("s1"), s2("s2"), s3("s3"), s4("s4");
+    std::vector<int> alphabet = {0, 1};
+
+    // Accepts words starting with 0, s3 can never be reached and s4 is a trap.
+    std::vector<std::vector<fsm::State>> transition_table = {
+            {s2, s4},
+            {s2, s2},
+            {s1, s2},
+            {s4, s4}
+    };
+
+    fsm::FSM<int> machine({s1, s2, s3, s4}, alphabet, s1, {s2}, transition_table);
+    std::cout << (machine & !machine).get_states_count() << std::endl;
+
+    std::cout << (machine & !machine).trimmed().get_states_count() << std::endl;
+
+    machine.trim();
+    std::cout << machine << std::endl;
+}
+
+void t12() {
+    std::vector<char> alphabet = {'i', 'f', 'x', ' '};
+    fsm::State k0("k0"), k1("k1"), k2("k2"), kd("kd");
+    fsm::State i0("i0"), i1("i1"), id("id");
+    fsm::State w0("w0"), w1("w1"), wd("wd");
+
+    // The keyword "if".
+    fsm::FSM<char> keyword({k0, k1, k2, kd}, alphabet, k0, {}, {
+            {k1, kd, kd, kd},
+            {kd, k2, kd, kd},
+            {kd, kd, kd, kd},
+            {kd, kd, kd, kd}
+    });
+    keyword.add_final_state(k2, 1, 2);
+
+    // Identifiers, lower priority than keywords.
+    fsm::FSM<char> identifier({i0, i1, id}, alphabet, i0, {}, {
+            {i1, i1, i1, id},
+            {i1, i1, i1, id},
+            {id, id, id, id}
+    });
+    identifier.add_final_state(i1, 2, 1);
+
+    // Whitespace.
+    fsm::FSM<char> whitespace({w0, w1, wd}, alphabet, w0, {}, {
+            {wd, wd, wd, w1},
+            {wd, wd, wd, w1},
+            {wd, wd, wd, wd}
+    });
+    whitespace.add_final_state(w1, 3);
+
+    fsm::CompiledFSM<char> lexer(keyword | identifier | whitespace);
+    fsm::Tokenizer<char> tokenizer(lexer);
+
+    const char input[] = "if iff  x";
+    fsm::Token tokens[16];
+    std::size_t consumed;
+    std::size_t count = tokenizer.tokenize(input, sizeof(input) - 1, tokens, 16, consumed);
+
+    for (std::size_t i = 0; i < count; i++) {
+        std::cout << tokens[i].token << " " << tokens[i].offset << " " << tokens[i].length << std::endl;
+    }
+}
+
+void build_ones_counter(fsm::FSMBuilder<int> &builder, int n) {
+    // Counts the ones modulo **n** in states c0 to c(n - 1), accepting in c0.
+    builder.reserve(n, 2);
+
+    for (int i = 0; i < n; i++) {
+        builder.add_state(fsm::State(fsm::String("c") + fsm::String(i)));
+    }
+    uint32_t zero = builder.add_symbol(0), one = builder.add_symbol(1);
+    for (int i = 0; i < n; i++) {
+        builder.add_transition_rule(i, zero, i);
+        builder.add_transition_rule(i, one, (i + 1) % n);
+    }
+    builder.add_final_state(fsm::State("c0"));
+}
+
+void t13() {
+    // A counter modulo 100000: accepts words whose number of 1s is divisible by 100000.
+    const int n = 100000;
+    fsm::FSMBuilder<int> builder;
+    build_ones_counter(builder, n);
+
+    fsm::CompiledFSM<int> machine = builder.build();
+    std::vector<int> word(n, 1);
+    std::cout << machine.get_states_count() << " states" << std::endl;
+    std::cout << machine.evaluate(word) << std::endl;
+    word.push_back(1);
+    std::cout << machine.evaluate(word) << std::endl;
+}
+
+void t14() {
+    // Complementing a 100000-state machine only flips how its final states bitmap is read.
+    fsm::FSMBuilder<int> builder;
+    build_ones_counter(builder, 100000);
+
+    fsm::FSM<int> machine = builder.build_fsm();
+    fsm::FSM<int> complement = !machine;
+    std::cout << machine.get_final_states_count() << " " << complement.get_final_states_count() << std::endl;
+    std::cout << machine.evaluate("0") << complement.evaluate("0") << std::endl;
+    std::cout << machine.evaluate("1") << complement.evaluate("1") << std::endl;
+}
+
+void t15() {
+    // tap, taps, top and tops share both their prefixes and their suffixes.
+    fsm::DictionaryBuilder<char> builder;
+    const char *words[] = {"tap", "taps", "top", "tops"};
+    for (const char *word : words) {
+        builder.add_word(word, std::strlen(word));
+    }
+
+    fsm::FSM<char> dictionary = builder.build_fsm();
+    std::cout << builder.get_words_count() << " words, " << builder.get_states_count() << " states" << std::endl;
+    std::cout << dictionary.evaluate("tops") << dictionary.evaluate("tap") << dictionary.evaluate("ta") << std::endl;
+
+    fsm::DictionaryBuilder<char> other;
+    other.add_words({{'t', 'i', 'p'}, {'t', 'a', 'p'}});
+    fsm::CompiledFSM<char> compiled = other.build();
+    std::cout << compiled.evaluate("tip", 3) << compiled.evaluate("pat", 3) << std::endl;
+}
+
+fsm::CompiledFSM<int> single_word_machine(int symbol) {
+    // Accepts exactly the word made of the one symbol, so readers can check the version they see.
+    fsm::FSMBuilder<int> builder;
+    fsm::State start("start"), accept("accept"), trap("trap");
+    builder.add_state(start);
+    builder.add_state(accept);
+    builder.add_state(trap);
+    builder.add_transition_rule(start, symbol, accept);
+    builder.add_transition_rule(accept, symbol, trap);
+    builder.add_transition_rule(trap, symbol, trap);
+    builder.add_final_state(accept);
+    return builder.build();
+}
+
+void t16() {
+    // Readers evaluate while two reloaders keep replacing the machine.
+    fsm::Registry<int> registry;
+    registry.load("m1", "m1.txt");
+    registry.publish("rules", single_word_machine(0));
+    std::cout << registry.read().find("m1")->get_states_count() << std::endl;
+
+    std::atomic<bool> done(false);
+    std::atomic<long> failures(0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; i++) {
+        readers.emplace_back([&registry, &done, &failures]() {
+            uint64_t last_version = 0;
+            while (!done.load()) {
+                fsm::Registry<int>::Reader reader = registry.read();
+                const fsm::CompiledFSM<int> *machine = reader.find("rules");
+                int word[2] = {machine->get_alphabet()[0], machine->get_alphabet()[0]};
+                if (!machine->evaluate(word, 1) || machine->evaluate(word, 2) || reader.get_version() < last_version) {
+                    failures++;
+                }
+                last_version = reader.get_version();
+            }
+        });
+    }
+
+    std::vector<std::thread> reloaders;
+    for (int i = 0; i < 2; i++) {
+        reloaders.emplace_back([&registry, i]() {
+            for (int version = 1; version <= 2000; version++) {
+                registry.publish("rules", single_word_machine(i * 1000000 + version));
+            }
+        });
+    }
+    for (std::thread &reloader : reloaders) {
+        reloader.join();
+    }
+    done = true;
+    for (std::thread &reader : readers) {
+        reader.join();
+    }
+
+    std::cout << failures.load() << " failures, " << registry.reclaim() << " snapshots pending" << std::endl;
+}
+
+void t17() {
+    // A million connections of a handshake protocol: 0 = syn, 1 = ack, 2 = data, accepted after syn ack.
+    fsm::FSMBuilder<int> builder;
+    fsm::State idle("idle"), syn("syn"), open("open");
+    builder.add_state(idle);
+    builder.add_state(syn);
+    builder.add_state(open);
+    builder.add_transition_rule(idle, 0, syn);
+    builder.add_transition_rule(syn, 1, open);
+    builder.add_transition_rule(open, 2, open);
+    builder.add_final_state(open);
+    fsm::CompiledFSM<int> protocol = builder.build();
+
+    const std::size_t connections = 1000000;
+    fsm::SessionTable<int> sessions(protocol, connections);
+    std::cout << sessions.get_width() << " byte per session, " << sessions.memory_usage() << " bytes" << std::endl;
+
+    // Every third connection completes the handshake, split over two batches.
+    const int syn_symbol[] = {0}, ack_symbol[] = {1};
+    std::vector<fsm::SessionChunk<int>> batch;
+    for (std::size_t i = 0; i < connections; i += 3) {
+        batch.push_back(fsm::SessionChunk<int>{i, syn_symbol, 1});
+    }
+    sessions.feed_batch(batch.data(), batch.size());
+    for (fsm::SessionChunk<int> &chunk : batch) {
+        chunk.symbols = ack_symbol;
+    }
+    sessions.feed_batch(batch.data(), batch.size());
+
+    sessions.snapshot("sessions.bin");
+    fsm::SessionTable<int> restored(protocol);
+    restored.restore("sessions.bin");
+    std::remove("sessions.bin");
+    std::size_t open_count = 0;
+    for (std::size_t i = 0; i < restored.get_sessions_count(); i++) {
+        open_count += restored.is_accepting(i);
+    }
+    std::cout << open_count << " open connections" << std::endl;
+}
+
+fsm::FSM<int> ends_with_one_machine() {
+    // Accepts the words over {0, 1} that end with a 1.
+    fsm::State s1("s1"), s2("s2");
+    return fsm::FSM<int>({s1, s2}, {0, 1}, s1, {s2}, {{s1, s2}, {s1, s2}});
+}
+
+fsm::FSM<int> even_ones_machine() {
+    // Accepts the words over {0, 1} with an even number of ones.
+    fsm::State r1("r1"), r2("r2");
+    return fsm::FSM<int>({r1, r2}, {0, 1}, r1, {r1}, {{r1, r2}, {r2, r1}});
+}
+
+void t18() {
+    // The same three rules are combined over and over, renamed copies included.
+    fsm::FSM<int> ends_with_one = ends_with_one_machine(), even_ones = even_ones_machine();
+    fsm::State r1("r1"), r2("r2");
+    fsm::FSM<int> renamed({r1, r2}, {0, 1}, r1, {r2}, {{r1, r2}, {r1, r2}});
+
+    fsm::OpCache<int> cache(16);
+    for (int i = 0; i < 10; i++) {
+        cache.union_of(ends_with_one, even_ones);
+        cache.intersection_of(renamed, even_ones);
+        cache.complement_of(i % 2 == 0 ? ends_with_one : renamed);
+    }
+
+    const fsm::CacheStats &stats = cache.get_stats();
+    std::cout << stats.hits << " hits, " << stats.misses << " misses, " << stats.evictions << " evictions" << std::endl;
+}
+
+void t19() {
+    // The products of the same machines in both orders have different state names but one canonical form.
+    fsm::FSM<int> ends_with_one = ends_with_one_machine(), even_ones = even_ones_machine();
+
+    fsm::FSM<int> left = ends_with_one | even_ones, right = even_ones | ends_with_one;
+    std::cout << left.get_initial_state() << " " << right.get_initial_state() << std::endl;
+    std::cout << (left.canonical_hash() == right.canonical_hash()) << left.equivalent(right) << std::endl;
+    std::cout << left.canonical() << std::endl;
+}
+
+void t20() {
+    // An even count of ones is also accepted by the second counter, so the 600 product states minimize to 2.
+    fsm::FSM<int> even = fsm::ones_counter("e", 300, 2), hundreds = fsm::ones_counter("h", 200, 200);
+    fsm::FSM<int> single = even.parallel_union(hundreds, 1), both = even.parallel_union(hundreds, 4);
+
+    std::ostringstream first, second;
+    first << single;
+    second << both;
+    both.parallel_minimize(4);
+    std::cout << single.get_states_count() << " " << both.get_states_count() << " " << (first.str() == second.str()) << std::endl;
+}
+
+void t21() {
+    // Counts divisible by both 300 and 200 are accepted, the product is written to disk and loaded back.
+    fsm::CompiledFSM<int> even(fsm::ones_counter("e", 300, 2)), hundreds(fsm::ones_counter("h", 200, 200));
+    fsm::ExternalProduct<int> product(1 << 20);
+    product.add_machine(even);
+    product.add_machine(hundreds);
+    fsm::ProductStats stats = product.write_intersection("product.bin");
+
+    fsm::CompiledFSM<int> loaded = fsm::CompiledFSM<int>::load("product.bin");
+    std::vector<int> ones(200, 1);
+    std::cout << stats.states << " states, " << stats.transitions << " transitions, " << stats.levels << " levels" << std::endl;
+    std::cout << loaded.evaluate(ones) << loaded.evaluate(ones.data(), 100) << std::endl;
+    std::remove("product.bin");
+}
+
+void t22() {
+    // (a|b)*a(a|b)^n needs 2^(n+1) deterministic states, so only the short one is determinized.
+    fsm::Pattern<char> ab = fsm::Pattern<char>::any_of({'a', 'b'});
+    fsm::Pattern<char> short_tail = ab.star() + fsm::Pattern<char>::symbol('a') + ab + ab;
+    fsm::Pattern<char> long_tail = short_tail;
+    for (int i = 0; i < 20; i++) {
+        long_tail = long_tail + ab;
+    }
+
+    fsm::Matcher<char> small(short_tail), large(long_tail);
+    const char *text = "bbbbabbbbbbbbbbbbbbbbbbbbbbbb";
+    std::size_t end;
+    std::cout << small.is_deterministic() << large.is_deterministic() << " ";
+    std::cout << small.evaluate(text, 7) << large.evaluate(text, 7) << " ";
+    std::cout << large.evaluate(text, std::strlen(text)) << large.search(text, std::strlen(text), end) << " " << end << std::endl;
+}
+
+void t23() {
+    // A one moves the state three steps ahead, so the breadth-first order is every third state.
+    std::vector<fsm::State> states;
+    std::vector<std::vector<fsm::State>> table;
+    for (int i = 0; i < 10; i++) {
+        states.push_back(fsm::State(fsm::String("e") + fsm::String(i)));
+    }
+    for (int i = 0; i < 10; i++) {
+        table.push_back({states[i], states[(i + 3) % 10]});
+    }
+    fsm::CompiledFSM<int> machine(fsm::FSM<int>(states, {0, 1}, states[0], {states[9]}, table));
+
+    fsm::CompiledFSM<int> bfs = machine.relayout(machine.bfs_order());
+    for (uint32_t i = 0; i < bfs.get_states_count(); i++) {
+        std::cout << bfs.get_state(i).get_name() << " ";
+    }
+
+    // The word waits in e9, which becomes the first row.
+    std::vector<int> word = {1, 1, 1, 0, 0, 0};
+    std::vector<uint64_t> visits;
+    machine.profile(word.data(), word.size(), visits);
+    fsm::CompiledFSM<int> hot = machine.relayout(machine.profile_order(visits));
+    std::cout << hot.get_state(0).get_name() << " " << hot.evaluate(word) << bfs.evaluate(word) << std::endl;
+}
+
+void t24() {
+    // Ids take one byte up to 256 states, two up to 65536 and four above that.
+    std::vector<int> bytes(256);
+    for (int i = 0; i < 256; i++) {
+        bytes[i] = i;
+    }
+    std::vector<uint32_t> counts = {200, 300, 70000};
+    for (uint32_t count : counts) {
+        std::vector<fsm::SparseRow> rows;
+        for (uint32_t i = 0; i < count; i++) {
+            rows.push_back({(i + 1) % count, {}});
+        }
+        fsm::CompiledFSM<int> machine(count == 200 ? bytes : std::vector<int>{0}, rows, 0, {count - 1}, fsm::Layout::Dense);
+        std::cout << machine.get_state_id_size() << " byte ids ";
+        if (count == 200) {
+            std::cout << "(" << machine.memory_usage() << " bytes) ";
+        }
+    }
+    std::cout << std::endl;
+}
+
+void t25() {
+    // Each counter accepts the multiples of its modulus, read in one pass over the word.
+    std::vector<fsm::FSM<int>> counters = {fsm::ones_counter("a", 2, 2), fsm::ones_counter("b", 3, 3), fsm::ones_counter("c", 5, 5)};
+    fsm::MachineSet<int> set(counters);
+    std::vector<int> six(6, 1), ten(10, 1);
+    fsm::Bitmap first = set.evaluate(six), second = set.evaluate(ten);
+    for (uint32_t k = 0; k < set.get_machines_count(); k++) {
+        std::cout << first.test(k);
+    }
+    std::cout << " ";
+    for (uint32_t k = 0; k < set.get_machines_count(); k++) {
+        std::cout << second.test(k);
+    }
+    std::cout << std::endl;
+}
+
+void t26() {
+    // Words over {0, 1} whose number of ones is a multiple of both 2 and 3.
+    fsm::CompiledFSM<int> sixes(fsm::ones_counter("a", 2, 2) & fsm::ones_counter("b", 3, 3));
+    fsm::WordCounter<int> words(sixes);
+    for (const fsm::BigUint &count : words.count_up_to(7)) {
+        std::cout << count << " ";
+    }
+    std::cout << words.count(100) << " " << words.count_modulo(1000000000000000000ull, 1000000007) << std::endl;
+}
+
+void t27() {
+    // The shortest words with a multiple of three ones, then two random words of length 8.
+    fsm::CompiledFSM<int> threes(fsm::ones_counter("a", 3, 3));
+    fsm::WordEnumerator<int> words(threes, 8);
+    int word[8];
+    std::size_t length;
+    for (int i = 0; i < 6 && words.next(word, length); i++) {
+        std::cout << "'";
+        for (std::size_t j = 0; j < length; j++) {
+            std::cout << word[j];
+        }
+        std::cout << "' ";
+    }
+
+    fsm::WordSampler<int> sampler(threes, 8);
+    std::mt19937_64 random(42);
+    for (int i = 0; i < 2; i++) {
+        sampler.sample(word, random);
+        for (int symbol : word) {
+            std::cout << symbol;
+        }
+        std::cout << " ";
+    }
+    std::cout << std::endl;
+}
+
+void t28() {
+    // Distances to a small dictionary, then the first typo of one of its words in a sentence.
+    fsm::DictionaryBuilder<char> builder;
+    const char *words[] = {"cat", "dog", "horse"};
+    for (const char *word : words) {
+        builder.add_word(word, std::strlen(word));
+    }
+    fsm::FSM<char> dictionary = builder.build_fsm();
+    fsm::ApproximateMatcher<char> matcher(dictionary, 2), close(dictionary, 1);
+    const char *queries[] = {"dog", "hrse", "cart", "mouse", "zebra"};
+    for (const char *query : queries) {
+        std::cout << matcher.distance(query, std::strlen(query)) << " ";
+    }
+
+    const char *text = "my hoarse voice";
+    std::size_t end;
+    unsigned distance;
+    if (close.search(text, std::strlen(text), end, distance)) {
+        std::cout << end << " " << distance;
+    }
+    std::cout << std::endl;
+
+    // With room for only three configurations the cache is dropped all the time, the distances stay the same.
+    fsm::ApproximateMatcher<char> tiny(dictionary, 2, 3);
+    for (const char *query : queries) {
+        std::cout << tiny.distance(query, std::strlen(query)) << " ";
+    }
+    std::cout << tiny.get_configurations_count() << std::endl;
+}
+
+void t29() {
+    // The same bad word under each error policy, then the alphabet check of the plain machine.
+    fsm::DictionaryBuilder<char> builder;
+    builder.add_word("ab", 2);
+    builder.add_word("abab", 4);
+    fsm::FSM<char> machine = builder.build_fsm();
+    fsm::CompiledFSM<char> compiled(machine);
+    const char *word = "ababxab";
+    std::size_t length = std::strlen(word);
+
+    fsm::ErrorCode error;
+    std::cout << compiled.evaluate(word, length, error) << " " << error.failed() << " " << error.position << " ";
+    std::size_t valid = compiled.validate(word, length);
+    std::cout << valid << " " << compiled.evaluate(word, valid, fsm::Unchecked()) << " ";
+    try {
+        compiled.evaluate(word, length);
+    } catch (const fsm::AutomationException &e) {
+        std::cout << e.get_msg() << " ";
+    }
+    try {
+        machine.evaluate(word);
+    } catch (const fsm::AutomationException &e) {
+        std::cout << e.get_msg();
+    }
+    std::cout << std::endl;
+}
+
+void run_demos() {
+    t1();
+    t2();
+    t3();
+    t4();
+    //t5();
+    t6();
+    t7();
+    t8();
+    t9();
+    t10();
+    t11();
+    t12();
+    t13();
+    t14();
+    t15();
+    t16();
+    t17();
+    t18();
+    t19();
+    t20();
+    t21();
+    t22();
+    t23();
+    t24();
+    t25();
+    t26();
+    t27();
+    t28();
+    t29();
+}
@@ -0,0 +1,10 @@
+#ifndef AUTOMATA_DEMO_H
+#define AUTOMATA_DEMO_H
+
+/**
+ * Runs the examples of the library, printing their results to the standard output.
+ * Some of them read m1.txt and m2.txt from the working directory.
+ */
+void run_demos();
+
+#endif //AUTOMATA_DEMO_H
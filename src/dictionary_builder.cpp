@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <functional>
+
+#include "dictionary_builder.h"
+#include "fsm_builder.h"
+#include "automation_exception.h"
+
+template <typename T>
+std::size_t fsm::DictionaryBuilder<T>::NodeHash::operator()(uint32_t id) const {
+    const Node &node = builder->nodes_[id];
+    std::size_t h = node.final ? 1 : 0;
+    for (const auto &edge : node.edges) {
+        h = (h * 1099511628211ull) ^ std::hash<T>()(edge.first);
+        h = (h * 1099511628211ull) ^ edge.second;
+    }
+    return h;
+}
+
+template <typename T>
+bool fsm::DictionaryBuilder<T>::NodeEqual::operator()(uint32_t lhs, uint32_t rhs) const {
+    const Node &a = builder->nodes_[lhs], &b = builder->nodes_[rhs];
+    return a.final == b.final && a.edges == b.edges;
+}
+
+template <typename T>
+fsm::DictionaryBuilder<T>::DictionaryBuilder()
+    : register_(0, NodeHash{this}, NodeEqual{this}),
+    words_(0),
+    finished_(false)
+{
+    path_.push_back(new_node());
+}
+
+template <typename T>
+void fsm::DictionaryBuilder<T>::add_word(const T *word, std::size_t length) {
+    if (finished_) {
+        throw AutomationException("Words cannot be added after build", __FILE__, __LINE__);
+    }
+    if (words_ > 0) {
+        if (std::lexicographical_compare(word, word + length, last_word_.begin(), last_word_.end())) {
+            throw AutomationException("Words must be added in sorted order", __FILE__, __LINE__);
+        }
+        if (std::equal(word, word + length, last_word_.begin(), last_word_.end())) {
+            return;
+        }
+    }
+
+    std::size_t prefix = 0;
+    while (prefix < length && prefix < last_word_.size() && word[prefix] == last_word_[prefix]) {
+        prefix++;
+    }
+
+    // Everything below the common prefix is final now, the new suffix hangs off the prefix.
+    minimize(prefix);
+    for (std::size_t i = prefix; i < length; i++) {
+        uint32_t id = new_node();
+        nodes_[path_.back()].edges.emplace_back(word[i], id);
+        path_.push_back(id);
+    }
+    nodes_[path_.back()].final = true;
+
+    last_word_.assign(word, word + length);
+    words_++;
+}
+
+template <typename T>
+void fsm::DictionaryBuilder<T>::add_word(const std::vector<T> &word) {
+    add_word(word.data(), word.size());
+}
+
+template <typename T>
+void fsm::DictionaryBuilder<T>::add_words(std::vector<std::vector<T>> words) {
+    std::sort(words.begin(), words.end());
+    for (const std::vector<T> &word : words) {
+        add_word(word);
+    }
+}
+
+template <typename T>
+std::size_t fsm::DictionaryBuilder<T>::get_words_count() const {
+    return words_;
+}
+
+template <typename T>
+uint32_t fsm::DictionaryBuilder<T>::get_states_count() const {
+    return nodes_.size() - free_.size();
+}
+
+template <typename T>
+fsm::CompiledFSM<T> fsm::DictionaryBuilder<T>::build(fsm::Layout layout) {
+    finish();
+
+    std::vector<uint32_t> states = order();
+    std::vector<T> alphabet = symbols();
+    std::vector<uint32_t> renumber(nodes_.size(), 0);
+    for (uint32_t i = 0; i < states.size(); i++) {
+        renumber[states[i]] = i;
+    }
+
+    uint32_t sink = states.size();
+    std::vector<fsm::SparseRow> rows(states.size() + 1);
+    std::vector<uint32_t> final_states;
+    for (uint32_t i = 0; i < states.size(); i++) {
+        const Node &node = nodes_[states[i]];
+        rows[i].default_target = sink;
+        rows[i].exceptions.reserve(node.edges.size());
+        for (const auto &edge : node.edges) {
+            uint32_t column = std::lower_bound(alphabet.begin(), alphabet.end(), edge.first) - alphabet.begin();
+            rows[i].exceptions.emplace_back(column, renumber[edge.second]);
+        }
+        if (node.final) {
+            final_states.push_back(i);
+        }
+    }
+    rows[sink].default_target = sink;
+
+    return fsm::CompiledFSM<T>(alphabet, rows, 0, final_states, layout);
+}
+
+template <typename T>
+fsm::FSM<T> fsm::DictionaryBuilder<T>::build_fsm() {
+    finish();
+
+    std::vector<uint32_t> states = order();
+    std::vector<T> alphabet = symbols();
+    std::vector<uint32_t> renumber(nodes_.size(), 0);
+
+    fsm::FSMBuilder<T> builder;
+    builder.reserve(states.size() + 1, alphabet.size());
+    for (uint32_t i = 0; i < states.size(); i++) {
+        renumber[states[i]] = builder.add_state(fsm::State(fsm::String("q") + fsm::String((int)i)));
+    }
+    for (const T &symbol : alphabet) {
+        builder.add_symbol(symbol);
+    }
+    for (uint32_t id : states) {
+        const Node &node = nodes_[id];
+        for (const auto &edge : node.edges) {
+            builder.add_transition_rule(renumber[id], builder.get_column(edge.first), renumber[edge.second]);
+        }
+        if (node.final) {
+            builder.add_final_state(fsm::State(fsm::String("q") + fsm::String((int)renumber[id])));
+        }
+    }
+
+    return builder.build_fsm();
+}
+
+template <typename T>
+uint32_t fsm::DictionaryBuilder<T>::new_node() {
+    if (!free_.empty()) {
+        uint32_t id = free_.back();
+        free_.pop_back();
+        return id;
+    }
+    nodes_.push_back(Node{false, {}});
+    return nodes_.size() - 1;
+}
+
+template <typename T>
+void fsm::DictionaryBuilder<T>::minimize(std::size_t depth) {
+    while (path_.size() > depth + 1) {
+        uint32_t child = path_.back();
+        path_.pop_back();
+
+        auto it = register_.find(child);
+        if (it == register_.end()) {
+            register_.insert(child);
+            continue;
+        }
+
+        // The parent's last edge is the one to the child, the words come in order.
+        nodes_[path_.back()].edges.back().second = *it;
+        Node &node = nodes_[child];
+        node.final = false;
+        std::vector<std::pair<T, uint32_t>>().swap(node.edges);
+        free_.push_back(child);
+    }
+}
+
+template <typename T>
+void fsm::DictionaryBuilder<T>::finish() {
+    if (finished_) {
+        return;
+    }
+    minimize(0);
+    finished_ = true;
+
+    // The register is only needed while words are added.
+    std::unordered_set<uint32_t, NodeHash, NodeEqual>(0, NodeHash{this}, NodeEqual{this}).swap(register_);
+    std::vector<T>().swap(last_word_);
+}
+
+template <typename T>
+std::vector<uint32_t> fsm::DictionaryBuilder<T>::order() const {
+    std::vector<uint32_t> states;
+    std::vector<char> seen(nodes_.size(), 0);
+    states.reserve(get_states_count());
+    states.push_back(path_[0]);
+    seen[path_[0]] = 1;
+    for (std::size_t i = 0; i < states.size(); i++) {
+        for (const auto &edge : nodes_[states[i]].edges) {
+            if (!seen[edge.second]) {
+                seen[edge.second] = 1;
+                states.push_back(edge.second);
+            }
+        }
+    }
+    return states;
+}
+
+template <typename T>
+std::vector<T> fsm::DictionaryBuilder<T>::symbols() const {
+    std::vector<T> alphabet;
+    for (std::size_t i = 0; i < nodes_.size(); i++) {
+        for (const auto &edge : nodes_[i].edges) {
+            alphabet.push_back(edge.first);
+        }
+    }
+    std::sort(alphabet.begin(), alphabet.end());
+    alphabet.erase(std::unique(alphabet.begin(), alphabet.end()), alphabet.end());
+    return alphabet;
+}
+
+template class fsm::DictionaryBuilder<int>;
+template class fsm::DictionaryBuilder<char>;
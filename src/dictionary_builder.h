@@ -0,0 +1,140 @@
+#ifndef AUTOMATA_DICTIONARY_BUILDER_H
+#define AUTOMATA_DICTIONARY_BUILDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "compiled_fsm.h"
+#include "fsm.h"
+
+namespace fsm {
+    /**
+     * DictionaryBuilder builds the minimal acyclic machine accepting a list of words,
+     * following the incremental algorithm of Daciuk, Mihov, Watson and Watson.
+     * Words are added in lexicographic order. Only the path of the last word is open,
+     * every other state is already merged with its equivalent states, so the builder
+     * is minimal at every step and its memory is proportional to the minimal machine.
+     */
+    template <typename T>
+    class DictionaryBuilder {
+    private:
+        /**
+         * A state of the machine, its edges are sorted by symbol.
+         */
+        struct Node {
+            bool final;
+            std::vector<std::pair<T, uint32_t>> edges;
+        };
+
+        /**
+         * Hashes a state by its finality and its edges.
+         */
+        struct NodeHash {
+            const DictionaryBuilder *builder;
+            std::size_t operator()(uint32_t id) const;
+        };
+
+        /**
+         * Two states are equivalent when they have the same finality and the same edges.
+         */
+        struct NodeEqual {
+            const DictionaryBuilder *builder;
+            bool operator()(uint32_t lhs, uint32_t rhs) const;
+        };
+
+        std::vector<Node> nodes_;
+        std::vector<uint32_t> free_;
+        std::unordered_set<uint32_t, NodeHash, NodeEqual> register_;
+        std::vector<uint32_t> path_;
+        std::vector<T> last_word_;
+        std::size_t words_;
+        bool finished_;
+    public:
+        /**
+         * Creates a builder for the empty language.
+         */
+        DictionaryBuilder();
+
+        /**
+         * The register refers back to the builder, so builders are not copied.
+         */
+        DictionaryBuilder(const DictionaryBuilder &rhs) = delete;
+        DictionaryBuilder &operator=(const DictionaryBuilder &rhs) = delete;
+
+        /**
+         * Adds a word. Words must come in lexicographic order, repeating the last word is allowed.
+         * Throws AutomationException if the word is smaller than the previous one or after build.
+         * @param T *word: The symbols of the word.
+         * @param size_t length: Number of symbols in **word**.
+         */
+        void add_word(const T *word, std::size_t length);
+
+        /**
+         * Adds a word. Words must come in lexicographic order, repeating the last word is allowed.
+         * @param vector<T> &word: The symbols of the word.
+         */
+        void add_word(const std::vector<T> &word);
+
+        /**
+         * Adds words given in any order. They are sorted first, so the list is held in memory.
+         * @param vector<vector<T>> words: The words to add.
+         */
+        void add_words(std::vector<std::vector<T>> words);
+
+        /**
+         * Returns the number of distinct words added so far.
+         */
+        std::size_t get_words_count() const;
+
+        /**
+         * Returns the number of states of the machine, without the sink for missing transitions.
+         */
+        uint32_t get_states_count() const;
+
+        /**
+         * Closes the last word and produces the compiled machine. No words can be added afterwards.
+         * States are numbered in breadth first order from the initial state and
+         * missing transitions lead to a non-final sink, which is the last state.
+         * @param Layout layout: The table layout, Layout::Auto picks one based on density.
+         */
+        fsm::CompiledFSM<T> build(fsm::Layout layout = fsm::Layout::Auto);
+
+        /**
+         * Closes the last word and produces a name based FSM. No words can be added afterwards.
+         * States are named q0, q1, ... in breadth first order.
+         */
+        fsm::FSM<T> build_fsm();
+    private:
+
+        /**
+         * Returns the id of a new non-final state without edges.
+         */
+        uint32_t new_node();
+
+        /**
+         * Merges or registers the states of the open path below the given depth.
+         * @param size_t depth: Number of symbols of the path that stay open.
+         */
+        void minimize(std::size_t depth);
+
+        /**
+         * Closes the whole open path.
+         */
+        void finish();
+
+        /**
+         * Returns the live states in breadth first order from the initial state.
+         */
+        std::vector<uint32_t> order() const;
+
+        /**
+         * Returns the sorted symbols used by the edges.
+         */
+        std::vector<T> symbols() const;
+    };
+}
+
+#endif //AUTOMATA_DICTIONARY_BUILDER_H
@@ -0,0 +1,72 @@
+#ifndef AUTOMATA_ERROR_POLICY_H
+#define AUTOMATA_ERROR_POLICY_H
+
+#include <cstddef>
+
+#include "automation_exception.h"
+
+namespace fsm {
+    /**
+     * The errors reported through the ErrorCode policy.
+     */
+    enum class Error {
+        None,
+        NotInAlphabet
+    };
+
+    /**
+     * Error policies choose what the evaluation of a compiled machine does with a symbol
+     * outside its alphabet. The loops are instantiated once per policy, so a policy that
+     * does not check costs nothing at run time.
+     * Throwing raises an AutomationException, the behaviour of the calls without a policy.
+     */
+    struct Throwing {
+        static constexpr bool checked = true;
+
+        /**
+         * Called with the position of the offending symbol.
+         */
+        [[noreturn]] void fail(fsm::Error, std::size_t) const {
+            throw AutomationException("Input is not in alphabet", __FILE__, __LINE__);
+        }
+    };
+
+    /**
+     * ErrorCode stops at the offending symbol and records the error and its position,
+     * for callers that treat bad input as an ordinary outcome. The calls taking one
+     * clear it first, so it can be reused and only ever describes the latest call.
+     */
+    struct ErrorCode {
+        static constexpr bool checked = true;
+
+        fsm::Error error = fsm::Error::None;
+        std::size_t position = 0;
+
+        /**
+         * Returns true if an error was recorded.
+         */
+        bool failed() const {
+            return error != fsm::Error::None;
+        }
+
+        /**
+         * Called with the position of the offending symbol.
+         */
+        void fail(fsm::Error code, std::size_t at) {
+            error = code;
+            position = at;
+        }
+    };
+
+    /**
+     * Unchecked performs no check at all. It is meant for input that was checked in bulk
+     * beforehand with CompiledFSM<T>::validate, the result is undefined for other symbols.
+     */
+    struct Unchecked {
+        static constexpr bool checked = false;
+
+        void fail(fsm::Error, std::size_t) const {}
+    };
+}
+
+#endif //AUTOMATA_ERROR_POLICY_H
@@ -0,0 +1,462 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <unistd.h>
+
+#include "external_product.h"
+#include "automation_exception.h"
+
+namespace {
+    const std::size_t MIN_BUDGET = 1 << 20;
+    const std::size_t READ_BUFFER_WORDS = 1 << 14;
+
+    /**
+     * An unnamed temporary file of 32-bit words. The file is unlinked as soon as it is
+     * created, so it disappears when closed, also when the construction throws.
+     */
+    class TempFile {
+    private:
+        FILE *file_;
+        uint64_t words_;
+    public:
+        explicit TempFile(const fsm::String &dir) : file_(nullptr), words_(0) {
+            fsm::String pattern = dir + "/automata-XXXXXX";
+            const char *chars = pattern.to_char_array();
+            std::vector<char> name(chars, chars + pattern.size() + 1);
+            delete[] chars;
+            int fd = mkstemp(name.data());
+            if (fd < 0) {
+                throw fsm::AutomationException("Cannot create a temporary file", __FILE__, __LINE__);
+            }
+            unlink(name.data());
+            file_ = fdopen(fd, "w+b");
+            if (file_ == nullptr) {
+                close(fd);
+                throw fsm::AutomationException("Cannot create a temporary file", __FILE__, __LINE__);
+            }
+        }
+
+        TempFile(const TempFile &) = delete;
+        TempFile &operator=(const TempFile &) = delete;
+
+        ~TempFile() {
+            std::fclose(file_);
+        }
+
+        void write(const uint32_t *words, std::size_t count) {
+            if (std::fwrite(words, sizeof(uint32_t), count, file_) != count) {
+                throw fsm::AutomationException("Cannot write a temporary file", __FILE__, __LINE__);
+            }
+            words_ += count;
+        }
+
+        /**
+         * Ends writing and goes back to the start for reading.
+         */
+        void rewind() {
+            std::fflush(file_);
+            std::rewind(file_);
+        }
+
+        std::size_t read(uint32_t *words, std::size_t count) {
+            return std::fread(words, sizeof(uint32_t), count, file_);
+        }
+
+        uint64_t get_words_count() const {
+            return words_;
+        }
+    };
+
+    /**
+     * Reads the fixed width records of a TempFile through a buffer.
+     */
+    class RecordReader {
+    private:
+        TempFile *file_;
+        unsigned width_;
+        std::vector<uint32_t> buffer_;
+        std::size_t position_;
+        std::size_t end_;
+    public:
+        RecordReader(TempFile *file, unsigned width, std::size_t buffer_words)
+            : file_(file),
+            width_(width),
+            buffer_(std::max<std::size_t>(buffer_words / width, 1) * width),
+            position_(0),
+            end_(0)
+        {
+            file_->rewind();
+        }
+
+        /**
+         * Points **record** to the next record, returns false at the end of the file.
+         */
+        bool next(const uint32_t *&record) {
+            if (position_ == end_) {
+                end_ = file_->read(buffer_.data(), buffer_.size());
+                position_ = 0;
+                if (end_ < width_) {
+                    return false;
+                }
+            }
+            record = buffer_.data() + position_;
+            position_ += width_;
+            return true;
+        }
+    };
+
+    bool record_less(const uint32_t *a, const uint32_t *b, unsigned width) {
+        return std::lexicographical_compare(a, a + width, b, b + width);
+    }
+
+    /**
+     * Sorts records of **W** words in place.
+     */
+    template <unsigned W>
+    void sort_fixed(std::vector<uint32_t> &records) {
+        std::array<uint32_t, W> *begin = reinterpret_cast<std::array<uint32_t, W>*>(records.data());
+        std::sort(begin, begin + records.size() / W);
+    }
+
+    /**
+     * Sorts fixed width records of 32-bit words lexicographically. Records are gathered in a
+     * buffer of at most **budget** bytes, full buffers are sorted and written as runs and the
+     * runs are merged when the records are read back. Without runs the buffer is read directly.
+     */
+    class RecordSorter {
+    private:
+        const fsm::String &dir_;
+        unsigned width_;
+        std::size_t budget_;
+        std::vector<uint32_t> buffer_;
+        std::vector<std::unique_ptr<TempFile>> runs_;
+        std::vector<std::unique_ptr<RecordReader>> readers_;
+        std::vector<const uint32_t*> heads_;
+        std::vector<unsigned> heap_;
+        std::size_t position_;
+        std::size_t spilled_;
+    public:
+        RecordSorter(const fsm::String &dir, unsigned width, std::size_t budget)
+            : dir_(dir),
+            width_(width),
+            budget_(budget),
+            position_(0),
+            spilled_(0)
+        {
+            buffer_.reserve(std::max<std::size_t>(budget / sizeof(uint32_t) / width, 1) * width);
+        }
+
+        void add(const uint32_t *record) {
+            buffer_.insert(buffer_.end(), record, record + width_);
+            if (buffer_.size() == buffer_.capacity()) {
+                spill();
+                spilled_++;
+            }
+        }
+
+        /**
+         * Ends adding and prepares reading the records in order.
+         */
+        void finish() {
+            position_ = 0;
+            if (runs_.empty()) {
+                sort_buffer();
+                return;
+            }
+
+            // The records left in the buffer become the last run, every run gets an equal share of the budget.
+            spill();
+            std::vector<uint32_t>().swap(buffer_);
+
+            std::size_t share = std::max<std::size_t>(budget_ / sizeof(uint32_t) / runs_.size(), width_);
+            heads_.resize(runs_.size());
+            for (unsigned r = 0; r < runs_.size(); r++) {
+                readers_.emplace_back(new RecordReader(runs_[r].get(), width_, share));
+                if (readers_[r]->next(heads_[r])) {
+                    heap_.push_back(r);
+                }
+            }
+            std::make_heap(heap_.begin(), heap_.end(), [this](unsigned a, unsigned b) {
+                return record_less(heads_[b], heads_[a], width_);
+            });
+        }
+
+        /**
+         * Points **record** to the next record in order, valid until the next call.
+         */
+        bool next(const uint32_t *&record) {
+            if (runs_.empty()) {
+                if (position_ == buffer_.size()) {
+                    return false;
+                }
+                record = &buffer_[position_];
+                position_ += width_;
+                return true;
+            }
+
+            auto greater = [this](unsigned a, unsigned b) {
+                return record_less(heads_[b], heads_[a], width_);
+            };
+            if (position_ != 0) {
+                // Advance the run that produced the previous record.
+                std::pop_heap(heap_.begin(), heap_.end(), greater);
+                unsigned r = heap_.back();
+                if (readers_[r]->next(heads_[r])) {
+                    std::push_heap(heap_.begin(), heap_.end(), greater);
+                } else {
+                    heap_.pop_back();
+                }
+            }
+            position_ = 1;
+            if (heap_.empty()) {
+                return false;
+            }
+            // The run on top only advances on the next call, so its record stays valid until then.
+            record = heads_[heap_.front()];
+            return true;
+        }
+
+        std::size_t get_spilled_runs() const {
+            return spilled_;
+        }
+    private:
+        void spill() {
+            sort_buffer();
+            runs_.emplace_back(new TempFile(dir_));
+            runs_.back()->write(buffer_.data(), buffer_.size());
+            buffer_.clear();
+        }
+
+        void sort_buffer() {
+            // The widths used by products of up to six machines are sorted in place, wider
+            // records through an index and a copy.
+            switch (width_) {
+                case 3: sort_fixed<3>(buffer_); return;
+                case 4: sort_fixed<4>(buffer_); return;
+                case 5: sort_fixed<5>(buffer_); return;
+                case 6: sort_fixed<6>(buffer_); return;
+                case 7: sort_fixed<7>(buffer_); return;
+                case 8: sort_fixed<8>(buffer_); return;
+            }
+
+            std::vector<std::size_t> order(buffer_.size() / width_);
+            for (std::size_t i = 0; i < order.size(); i++) {
+                order[i] = i;
+            }
+            std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+                return record_less(&buffer_[a * width_], &buffer_[b * width_], width_);
+            });
+            std::vector<uint32_t> sorted;
+            sorted.reserve(buffer_.capacity());
+            for (std::size_t index : order) {
+                sorted.insert(sorted.end(), &buffer_[index * width_], &buffer_[(index + 1) * width_]);
+            }
+            buffer_.swap(sorted);
+        }
+    };
+}
+
+template <typename T>
+fsm::ExternalProduct<T>::ExternalProduct(std::size_t memory_budget, const char *work_dir)
+    : memory_budget_(std::max(memory_budget, MIN_BUDGET)),
+    work_dir_(work_dir)
+{
+
+}
+
+template <typename T>
+void fsm::ExternalProduct<T>::add_machine(const fsm::CompiledFSM<T> &machine) {
+    machines_.push_back(&machine);
+}
+
+template <typename T>
+fsm::ProductStats fsm::ExternalProduct<T>::write_intersection(const char *path) const {
+    return write_product(path, true);
+}
+
+template <typename T>
+fsm::ProductStats fsm::ExternalProduct<T>::write_union(const char *path) const {
+    return write_product(path, false);
+}
+
+template <typename T>
+fsm::ProductStats fsm::ExternalProduct<T>::write_product(const char *path, bool intersect) const {
+    if (machines_.empty()) {
+        throw AutomationException("The product has no operands", __FILE__, __LINE__);
+    }
+
+    unsigned k = machines_.size();
+    const std::vector<T> &alphabet = machines_[0]->get_alphabet();
+    uint32_t m = alphabet.size();
+    std::vector<uint32_t> columns((std::size_t)k * m);
+    for (unsigned i = 0; i < k; i++) {
+        for (uint32_t j = 0; j < m; j++) {
+            columns[(std::size_t)j * k + i] = machines_[i]->column_of(alphabet[j]);
+            if (columns[(std::size_t)j * k + i] == fsm::SymbolMap<T>::npos) {
+                throw AutomationException("Input is not in alphabet", __FILE__, __LINE__);
+            }
+        }
+    }
+
+    // Records are a tuple of k operand states followed by an id, a (source, column) pair
+    // or nothing, so sorting them lexicographically sorts them by tuple first.
+    unsigned state_width = k + 1, successor_width = k + 2, edge_width = 3;
+    std::size_t sort_budget = memory_budget_ / 4, read_words = std::min(READ_BUFFER_WORDS, memory_budget_ / 32);
+
+    std::ofstream out(path, std::ios::binary);
+    fsm::MachineFileHeader header = fsm::MachineFileHeader::make(sizeof(T), m, 0, 0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(alphabet.data()), m * sizeof(T));
+
+    TempFile finals(work_dir_), labels(work_dir_);
+    uint64_t states = 0;
+    std::vector<uint32_t> record(successor_width);
+    std::vector<uint32_t> flags_buffer;
+
+    // Assigns the next id to a tuple and records whether it is final and its label.
+    auto add_state = [&](const uint32_t *tuple) {
+        if (states > 0xffffffffull) {
+            throw AutomationException("The product has more than 2^32 states", __FILE__, __LINE__);
+        }
+        uint32_t id = states++;
+        const fsm::Label *label = nullptr;
+        unsigned final_count = 0;
+        for (unsigned i = 0; i < k; i++) {
+            if (machines_[i]->is_final_state(tuple[i])) {
+                final_count++;
+                // Keep the label with the higher priority, earlier operands win ties.
+                const fsm::Label &candidate = machines_[i]->get_label(tuple[i]);
+                if (label == nullptr || candidate.priority > label->priority) {
+                    label = &candidate;
+                }
+            }
+        }
+        bool final = intersect ? final_count == k : final_count > 0;
+        uint32_t flag = final;
+        finals.write(&flag, 1);
+        if (final && (label->token != 0 || label->priority != 0)) {
+            uint32_t entry[3] = {id, label->token, (uint32_t)label->priority};
+            labels.write(entry, 3);
+        }
+        return id;
+    };
+
+    std::unique_ptr<TempFile> visited(new TempFile(work_dir_)), frontier(new TempFile(work_dir_));
+    for (unsigned i = 0; i < k; i++) {
+        record[i] = machines_[i]->get_initial_state();
+    }
+    record[k] = add_state(record.data());
+    visited->write(record.data(), state_width);
+    frontier->write(record.data(), state_width);
+
+    fsm::ProductStats stats{0, 0, 0, 0};
+    std::vector<uint32_t> previous(k), row(m);
+    while (frontier->get_words_count() > 0) {
+        stats.levels++;
+
+        // Expand the frontier, which is in id order.
+        RecordSorter successors(work_dir_, successor_width, sort_budget);
+        {
+            RecordReader reader(frontier.get(), state_width, read_words);
+            const uint32_t *state;
+            while (reader.next(state)) {
+                for (uint32_t j = 0; j < m; j++) {
+                    for (unsigned i = 0; i < k; i++) {
+                        record[i] = machines_[i]->next(state[i], columns[(std::size_t)j * k + i]);
+                    }
+                    record[k] = state[k];
+                    record[k + 1] = j;
+                    successors.add(record.data());
+                }
+            }
+        }
+        successors.finish();
+
+        // Merge the sorted successors with the visited states. Unknown tuples get ids in
+        // tuple order and form the next frontier, the merged file is the new visited set.
+        std::unique_ptr<TempFile> merged(new TempFile(work_dir_)), next_frontier(new TempFile(work_dir_));
+        RecordSorter edges(work_dir_, edge_width, sort_budget);
+        {
+            RecordReader reader(visited.get(), state_width, read_words);
+            const uint32_t *known, *successor;
+            bool has_known = reader.next(known), has_previous = false;
+            uint32_t target = 0;
+            while (successors.next(successor)) {
+                if (!has_previous || !std::equal(successor, successor + k, previous.begin())) {
+                    while (has_known && record_less(known, successor, k)) {
+                        merged->write(known, state_width);
+                        has_known = reader.next(known);
+                    }
+                    if (has_known && std::equal(known, known + k, successor)) {
+                        target = known[k];
+                    } else {
+                        std::copy(successor, successor + k, record.begin());
+                        record[k] = target = add_state(successor);
+                        merged->write(record.data(), state_width);
+                        next_frontier->write(record.data(), state_width);
+                    }
+                    std::copy(successor, successor + k, previous.begin());
+                    has_previous = true;
+                }
+                uint32_t edge[3] = {successor[k], successor[k + 1], target};
+                edges.add(edge);
+            }
+            while (has_known) {
+                merged->write(known, state_width);
+                has_known = reader.next(known);
+            }
+        }
+        edges.finish();
+
+        // The sources of a level are consecutive ids and each has one edge per column,
+        // so the sorted edges are the next rows of the table.
+        const uint32_t *edge;
+        while (edges.next(edge)) {
+            row[edge[1]] = edge[2];
+            if (edge[1] == m - 1) {
+                out.write(reinterpret_cast<const char*>(row.data()), m * sizeof(uint32_t));
+            }
+        }
+        stats.runs += successors.get_spilled_runs() + edges.get_spilled_runs();
+
+        visited.swap(merged);
+        frontier.swap(next_frontier);
+    }
+
+    RecordReader final_reader(&finals, 1, read_words);
+    const uint32_t *flag;
+    while (final_reader.next(flag)) {
+        flags_buffer.push_back(*flag);
+        if (flags_buffer.size() == read_words) {
+            std::vector<uint8_t> bytes(flags_buffer.begin(), flags_buffer.end());
+            out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+            flags_buffer.clear();
+        }
+    }
+    std::vector<uint8_t> bytes(flags_buffer.begin(), flags_buffer.end());
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+
+    uint32_t labels_count = labels.get_words_count() / 3;
+    out.write(reinterpret_cast<const char*>(&labels_count), sizeof(labels_count));
+    RecordReader label_reader(&labels, 3, read_words);
+    const uint32_t *label;
+    while (label_reader.next(label)) {
+        out.write(reinterpret_cast<const char*>(label), 3 * sizeof(uint32_t));
+    }
+
+    header.states_count = states;
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!out) {
+        throw AutomationException("Cannot write the machine file", __FILE__, __LINE__);
+    }
+
+    stats.states = states;
+    stats.transitions = states * m;
+    return stats;
+}
+
+template class fsm::ExternalProduct<int>;
+template class fsm::ExternalProduct<char>;
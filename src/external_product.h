@@ -0,0 +1,74 @@
+#ifndef AUTOMATA_EXTERNAL_PRODUCT_H
+#define AUTOMATA_EXTERNAL_PRODUCT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "compiled_fsm.h"
+#include "custom_string.h"
+
+namespace fsm {
+    /**
+     * Counters of a product built by ExternalProduct.
+     */
+    struct ProductStats {
+        uint64_t states;
+        uint64_t transitions;
+        std::size_t levels;
+        std::size_t runs;
+    };
+
+    /**
+     * ExternalProduct builds the intersection or the union of several compiled machines
+     * when the product does not fit in memory. The search goes level by level: the
+     * successors of a frontier file are sorted in runs on disk, merged and joined with
+     * the sorted file of the visited states, and the new states become the next frontier.
+     * The transitions of a level are sorted by source and appended to the output, so the
+     * machine file (see MachineFileHeader) is written sequentially and never held in memory.
+     * Only the operands and the buffers limited by the memory budget stay in RAM.
+     */
+    template <typename T>
+    class ExternalProduct {
+    private:
+        std::vector<const fsm::CompiledFSM<T>*> machines_;
+        std::size_t memory_budget_;
+        fsm::String work_dir_;
+    public:
+        /**
+         * Creates a builder without operands.
+         * @param size_t memory_budget: Bytes used for sorting and file buffers, at least one megabyte is used.
+         * @param char *work_dir: The directory for the temporary files, they are removed when closed.
+         */
+        ExternalProduct(std::size_t memory_budget, const char *work_dir = "/tmp");
+
+        /**
+         * Adds an operand, the machine must outlive the builder.
+         * Its alphabet must contain every symbol of the alphabet of the first operand.
+         * @param CompiledFSM<T> &machine: The machine to combine.
+         */
+        void add_machine(const fsm::CompiledFSM<T> &machine);
+
+        /**
+         * Writes the intersection of the operands to a machine file.
+         * Throws AutomationException if there are no operands, the alphabets differ or a file cannot be written.
+         * @param char *path: The path to the machine file.
+         */
+        fsm::ProductStats write_intersection(const char *path) const;
+
+        /**
+         * Writes the union of the operands to a machine file, like write_intersection().
+         * @param char *path: The path to the machine file.
+         */
+        fsm::ProductStats write_union(const char *path) const;
+    private:
+
+        /**
+         * Runs the search and writes the product, a state is final if it is final in all
+         * operands when **intersect** is set and in any of them otherwise.
+         */
+        fsm::ProductStats write_product(const char *path, bool intersect) const;
+    };
+}
+
+#endif //AUTOMATA_EXTERNAL_PRODUCT_H
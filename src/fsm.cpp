@@ -1,12 +1,75 @@
-#include <set>
 #include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "fsm.h"
 #include "automation_exception.h"
 
+namespace {
+    const std::size_t PRODUCT_SHARDS = 64;
+    const uint64_t PENDING = 1ull << 63;
+
+    /**
+     * A part of the concurrent set of product states. Settled pairs map to their id,
+     * pairs found in the current level map to PENDING | the rank of their first discovery.
+     */
+    struct ProductShard {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, uint64_t> ids;
+    };
+
+    std::size_t shard_of(uint64_t pair) {
+        return (pair * 0x9e3779b97f4a7c15ull) >> 58;
+    }
+
+    /**
+     * Returns the number of threads to use, 0 means one per hardware thread.
+     */
+    unsigned resolve_threads(unsigned threads) {
+        if (threads == 0) {
+            threads = std::thread::hardware_concurrency();
+        }
+        return std::max(threads, 1u);
+    }
+
+    /**
+     * Splits [0, count) into contiguous ranges of at least **grain** items, at most one per thread,
+     * and calls body(from, to, range) for each of them. The calling thread runs the first range.
+     * The split only depends on the arguments, so calls with the same arguments get the same ranges.
+     */
+    template <typename F>
+    void parallel_for(unsigned threads, std::size_t count, const F &body, std::size_t grain = 1024) {
+        std::size_t ranges = std::min<std::size_t>(threads, (count + grain - 1) / grain);
+        if (ranges <= 1) {
+            body(0, count, 0);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        for (std::size_t r = 1; r < ranges; r++) {
+            workers.emplace_back([&body, count, ranges, r]() {
+                body(count * r / ranges, count * (r + 1) / ranges, r);
+            });
+        }
+        body(0, count / ranges, 0);
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+    }
+}
+
 template <typename T>
-fsm::FSM<T>::FSM() {
+fsm::FSM<T>::FSM()
+    : data_(empty_definition()),
+    complemented_(false),
+    current_state_(npos)
+{
 
 }
 
@@ -16,20 +79,28 @@ fsm::FSM<T>::FSM(const std::vector<fsm::State> &states,
     const fsm::State &initial_state,
     const std::vector<fsm::State> &final_states,
     const std::vector<std::vector<fsm::State>> &transition_table)
-        : states_(states),
-    alphabet_(alphabet),
-    initial_state_(initial_state),
-    final_states_(final_states),
-    transition_table_(transition_table)
+        : complemented_(false),
+    current_state_(npos)
 {
-    current_state_ = &initial_state_;
+    std::shared_ptr<Definition> data = std::make_shared<Definition>();
+    data->states = states;
+    data->alphabet = alphabet;
+    data->initial_state = initial_state;
+    data->transition_table = transition_table;
+    index_states(*data);
+    data_ = data;
+
     validate_states();
     validate_initial_state();
-    validate_final_states();
+    set_final_states(final_states);
+    restart();
 }
 
 template <typename T>
 fsm::FSM<T>::FSM(const char* destPath)
+    : data_(empty_definition()),
+    complemented_(false),
+    current_state_(npos)
 {
     std::ifstream f(destPath);
     f >> *this;
@@ -37,26 +108,51 @@ fsm::FSM<T>::FSM(const char* destPath)
 
 template <typename T>
 fsm::FSM<T>::FSM(const fsm::FSM<T>& rhs)
-    : states_(rhs.states_),
-    alphabet_(rhs.alphabet_),
-    initial_state_(rhs.initial_state_),
-    final_states_(rhs.final_states_),
-    transition_table_(rhs.transition_table_)
+    : data_(rhs.data_),
+    complemented_(rhs.complemented_),
+    final_states_list_(rhs.final_states_list_),
+    current_state_(rhs.current_state_)
 {
-    current_state_ = &states_[indexOfState(*rhs.current_state_)];
+
+}
+
+template <typename T>
+fsm::FSM<T>::FSM(fsm::FSM<T>&& rhs) noexcept
+    : data_(std::move(rhs.data_)),
+    complemented_(rhs.complemented_),
+    final_states_list_(std::move(rhs.final_states_list_)),
+    current_state_(rhs.current_state_)
+{
+    rhs.data_ = empty_definition();
+    rhs.complemented_ = false;
+    rhs.current_state_ = npos;
 }
 
 template <typename T>
 fsm::FSM<T>& fsm::FSM<T>::operator=(const fsm::FSM<T>& rhs)
 {
     if (this != &rhs) {
-        states_ = rhs.states_;
-        alphabet_ = rhs.alphabet_;
-        initial_state_ = rhs.initial_state_;
-        final_states_ = rhs.final_states_;
-        transition_table_ = rhs.transition_table_;
+        data_ = rhs.data_;
+        complemented_ = rhs.complemented_;
+        final_states_list_ = rhs.final_states_list_;
+        current_state_ = rhs.current_state_;
+    }
 
-        current_state_ = &states_[indexOfState(*rhs.current_state_)];
+    return *this;
+}
+
+template <typename T>
+fsm::FSM<T>& fsm::FSM<T>::operator=(fsm::FSM<T>&& rhs) noexcept
+{
+    if (this != &rhs) {
+        data_ = std::move(rhs.data_);
+        complemented_ = rhs.complemented_;
+        final_states_list_ = std::move(rhs.final_states_list_);
+        current_state_ = rhs.current_state_;
+
+        rhs.data_ = empty_definition();
+        rhs.complemented_ = false;
+        rhs.current_state_ = npos;
     }
 
     return *this;
@@ -64,157 +160,247 @@ fsm::FSM<T>& fsm::FSM<T>::operator=(const fsm::FSM<T>& rhs)
 
 template <typename T>
 fsm::FSM<T>::~FSM() = default;
-//    delete [] current_state_;
-//};
+
+template <typename T>
+const std::shared_ptr<const typename fsm::FSM<T>::Definition> &fsm::FSM<T>::empty_definition() {
+    static const std::shared_ptr<const Definition> empty = std::make_shared<Definition>();
+    return empty;
+}
+
+template <typename T>
+typename fsm::FSM<T>::Definition &fsm::FSM<T>::mutate() {
+    if (data_.use_count() != 1) {
+        data_ = std::make_shared<Definition>(*data_);
+    }
+    // The definition is created non-const and no other machine refers to it now.
+    return const_cast<Definition &>(*data_);
+}
 
 template <typename T>
 int fsm::FSM<T>::get_states_count() const {
-    return states_.size();
+    return data_->states.size();
 }
 
 template <typename T>
 const std::vector<fsm::State> &fsm::FSM<T>::get_states() const {
-    return states_;
+    return data_->states;
 }
 
 template <typename T>
 void fsm::FSM<T>::set_states(const std::vector<fsm::State> &states) {
-    states_ = states;
+    // Final states and the current state follow their names into the new numbering.
+    std::vector<fsm::State> final_states = get_final_states();
+    fsm::State current = get_current_state();
+
+    Definition &data = mutate();
+    data.states = states;
+    index_states(data);
+
+    data.final_states = fsm::Bitmap(data.states.size());
+    complemented_ = false;
+    for (const fsm::State &state : final_states) {
+        unsigned id = find_state(state);
+        if (id != npos) {
+            data.final_states.set(id);
+        }
+    }
+    final_states_list_.reset();
+    current_state_ = find_state(current);
 }
 
 template <typename T>
 int fsm::FSM<T>::get_alphabet_count() const {
-    return alphabet_.size();
+    return data_->alphabet.size();
 }
 
 template <typename T>
 const std::vector<T> &fsm::FSM<T>::get_alphabet() const {
-    return alphabet_;
+    return data_->alphabet;
 }
 
 template <typename T>
 void fsm::FSM<T>::set_alphabet(const std::vector<T> &alphabet) {
-    alphabet_ = alphabet;
+    mutate().alphabet = alphabet;
 }
 
 template <typename T>
 const fsm::State &fsm::FSM<T>::get_initial_state() const {
-    return initial_state_;
+    return data_->initial_state;
 }
 
 template <typename T>
 void fsm::FSM<T>::set_initial_state(const fsm::State &initialState) {
-    initial_state_ = initialState;
+    mutate().initial_state = initialState;
 }
 
 template <typename T>
 int fsm::FSM<T>::get_final_states_count() const {
-    return final_states_.size();
+    std::size_t count = data_->final_states.count();
+    return complemented_ ? data_->states.size() - count : count;
 }
 
 template <typename T>
 const std::vector<fsm::State> &fsm::FSM<T>::get_final_states() const {
-    return final_states_;
+    if (!final_states_list_) {
+        std::shared_ptr<std::vector<fsm::State>> final_states = std::make_shared<std::vector<fsm::State>>();
+        for (unsigned i = 0; i < data_->states.size(); i++) {
+            if (data_->final_states.test(i) != complemented_) {
+                final_states->push_back(data_->states[i]);
+            }
+        }
+        final_states_list_ = final_states;
+    }
+    return *final_states_list_;
 }
 
 template <typename T>
 void fsm::FSM<T>::set_final_states(const std::vector<fsm::State> &final_states) {
-    final_states_ = final_states;
+    fsm::Bitmap bitmap(data_->states.size());
+    for (const fsm::State &state : final_states) {
+        unsigned id = find_state(state);
+        if (id == npos) {
+            throw AutomationException("At least one final state is not a valid state", __FILE__, __LINE__);
+        }
+        bitmap.set(id);
+    }
+
+    mutate().final_states = bitmap;
+    complemented_ = false;
+    final_states_list_.reset();
 }
 
 template <typename T>
 const std::vector<std::vector<fsm::State>> &fsm::FSM<T>::get_transition_table() const {
-    return transition_table_;
+    return data_->transition_table;
 }
 
 template <typename T>
 void fsm::FSM<T>::set_transition_table(const std::vector<std::vector<fsm::State>> &transition_table) {
-    transition_table_ = transition_table;
+    mutate().transition_table = transition_table;
 }
 
 template <typename T>
 fsm::State fsm::FSM<T>::get_current_state() const {
-    return *current_state_;
+    return current_state_ < data_->states.size() ? data_->states[current_state_] : fsm::State();
 }
 
 template <typename T>
 void fsm::FSM<T>::add_state(const fsm::State &state) {
-    states_.push_back(state);
-    transition_table_.emplace_back(alphabet_.size());
+    Definition &data = mutate();
+    data.state_ids.emplace(state.get_name(), data.states.size());
+    data.states.push_back(state);
+    data.transition_table.emplace_back(data.alphabet.size());
+
+    // New states are not final, also when the bitmap is read inverted.
+    data.final_states.resize(data.states.size());
+    if (complemented_) {
+        data.final_states.set(data.states.size() - 1);
+    }
 }
 
 template <typename T>
 void fsm::FSM<T>::add_symbol(T symbol) {
-    alphabet_.push_back(symbol);
-    for (std::vector<fsm::State> row : transition_table_) {
-        row.resize(row.size() + 1);
+    Definition &data = mutate();
+    data.alphabet.push_back(symbol);
+    for (std::vector<fsm::State> &row : data.transition_table) {
+        row.resize(data.alphabet.size());
     }
 }
 
 template <typename T>
 void fsm::FSM<T>::add_final_state(const fsm::State &state) {
-    final_states_.push_back(state);
+    unsigned id = find_state(state);
+    if (id == npos) {
+        throw AutomationException("At least one final state is not a valid state", __FILE__, __LINE__);
+    }
+    if (complemented_) {
+        mutate().final_states.reset(id);
+    } else {
+        mutate().final_states.set(id);
+    }
+    final_states_list_.reset();
+}
+
+template <typename T>
+void fsm::FSM<T>::add_final_state(const fsm::State &state, unsigned token, int priority) {
+    add_final_state(state);
+    mutate().labels[state.get_name()] = fsm::Label{token, priority};
+}
+
+template <typename T>
+const fsm::Label *fsm::FSM<T>::get_final_label(const fsm::State &state) const {
+    auto it = data_->labels.find(state.get_name());
+    return it == data_->labels.end() ? nullptr : &it->second;
 }
 
 template <typename T>
 void fsm::FSM<T>::add_transition_rule(const fsm::State &state, T symbol, const fsm::State &next_state) {
-    int row = 0, column = 0;
-    for (; row < states_.size(); row++) {
-        if (states_[row] == state) {
-            break;
-        }
-    }
-    for (; column < alphabet_.size(); column++) {
-        if (alphabet_[column] == symbol) {
+    const std::vector<T> &alphabet = data_->alphabet;
+    unsigned row = find_state(state), column = 0;
+    for (; column < alphabet.size(); column++) {
+        if (alphabet[column] == symbol) {
             break;
         }
     }
 
-    if (column >= alphabet_.size()) {
+    if (row >= data_->states.size()) {
+        throw AutomationException("State is not a valid state", __FILE__, __LINE__);
+    }
+    if (column >= alphabet.size()) {
         throw AutomationException("Input is not in alphabet", __FILE__, __LINE__);
     }
 
-    transition_table_[row][column] = next_state;
+    mutate().transition_table[row][column] = next_state;
 }
 
 template <typename T>
 void fsm::FSM<T>::transition(T input) {
-    int row = 0, column = 0;
-    for (; row < states_.size(); row++) {
-        if (states_[row] == *current_state_) {
-            break;
-        }
-    }
-    for (; column < alphabet_.size(); column++) {
-        if (alphabet_[column] == input) {
+    const std::vector<T> &alphabet = data_->alphabet;
+    unsigned column = 0;
+    for (; column < alphabet.size(); column++) {
+        if (alphabet[column] == input) {
             break;
         }
     }
 
-    if (column >= alphabet_.size()) {
-        throw "input is not in alphabet (TODO exception)";
+    if (current_state_ >= data_->states.size()) {
+        throw AutomationException("State is not a valid state", __FILE__, __LINE__);
+    }
+    if (column >= alphabet.size()) {
+        throw AutomationException("Input is not in alphabet", __FILE__, __LINE__);
     }
 
-    current_state_ = &transition_table_[row][column];
+    current_state_ = find_state(data_->transition_table[current_state_][column]);
 }
 
 template <typename T>
 unsigned fsm::FSM<T>::indexOfState(const fsm::State& st) const {
-    unsigned i = 0;
-
-    while (i < states_.size() - 1 && !(states_[i] == st)) {
-        i++;
+    unsigned id = find_state(st);
+    if (id == npos) {
+        throw AutomationException("State is not a valid state", __FILE__, __LINE__);
     }
 
-    return i;
+    return id;
 }
 
 template <typename T>
-bool fsm::FSM<T>::is_in_final_state() const {
-    if (std::find(final_states_.begin(), final_states_.end(), *current_state_) != final_states_.end()) {
-       return true;
+unsigned fsm::FSM<T>::find_state(const fsm::State &state) const {
+    auto it = data_->state_ids.find(state.get_name());
+    return it == data_->state_ids.end() ? npos : it->second;
+}
+
+template <typename T>
+void fsm::FSM<T>::index_states(Definition &data) {
+    data.state_ids.clear();
+    data.state_ids.reserve(data.states.size());
+    for (unsigned i = 0; i < data.states.size(); i++) {
+        data.state_ids.emplace(data.states[i].get_name(), i);
     }
-    return false;
+}
+
+template <typename T>
+bool fsm::FSM<T>::is_in_final_state() const {
+    return current_state_ < data_->states.size() && data_->final_states.test(current_state_) != complemented_;
 }
 
 template <typename T>
@@ -237,41 +423,853 @@ void fsm::FSM<T>::toTXT(const char* dest) const
 
 template <typename T>
 void fsm::FSM<T>::restart() {
-    current_state_ = &initial_state_;
+    current_state_ = find_state(data_->initial_state);
+}
+
+template <typename T>
+void fsm::FSM<T>::trim() {
+    const Definition &data = *data_;
+    unsigned n = data.states.size(), m = data.alphabet.size();
+    if (n == 0) {
+        return;
+    }
+
+    // Cells naming an unknown state get id n, they can never accept.
+    auto id_of = [this, n](const fsm::State &st) {
+        unsigned id = find_state(st);
+        return id == npos ? n : id;
+    };
+
+    std::vector<unsigned> next((std::size_t)n * m);
+    for (unsigned i = 0; i < n; i++) {
+        for (unsigned j = 0; j < m; j++) {
+            next[(std::size_t)i * m + j] = id_of(data.transition_table[i][j]);
+        }
+    }
+
+    // Forward reachability from the initial state.
+    std::vector<char> reachable(n + 1, 0), useful(n + 1, 0);
+    std::vector<unsigned> stack;
+    unsigned initial = id_of(data.initial_state);
+    if (initial < n) {
+        reachable[initial] = 1;
+        stack.push_back(initial);
+    }
+    while (!stack.empty()) {
+        unsigned s = stack.back();
+        stack.pop_back();
+        for (unsigned j = 0; j < m; j++) {
+            unsigned t = next[(std::size_t)s * m + j];
+            if (t < n && !reachable[t]) {
+                reachable[t] = 1;
+                stack.push_back(t);
+            }
+        }
+    }
+
+    // Reverse co-reachability from the reachable final states.
+    std::vector<unsigned> offsets(n + 1, 0), sources;
+    for (unsigned s = 0; s < n; s++) {
+        for (unsigned j = 0; reachable[s] && j < m; j++) {
+            unsigned t = next[(std::size_t)s * m + j];
+            if (t < n) {
+                offsets[t + 1]++;
+            }
+        }
+    }
+    for (unsigned s = 0; s < n; s++) {
+        offsets[s + 1] += offsets[s];
+    }
+    sources.resize(offsets[n]);
+    std::vector<unsigned> cursor(offsets.begin(), offsets.end() - 1);
+    for (unsigned s = 0; s < n; s++) {
+        for (unsigned j = 0; reachable[s] && j < m; j++) {
+            unsigned t = next[(std::size_t)s * m + j];
+            if (t < n) {
+                sources[cursor[t]++] = s;
+            }
+        }
+    }
+    for (unsigned f = 0; f < n; f++) {
+        if (reachable[f] && data.final_states.test(f) != complemented_) {
+            useful[f] = 1;
+            stack.push_back(f);
+        }
+    }
+    while (!stack.empty()) {
+        unsigned t = stack.back();
+        stack.pop_back();
+        for (unsigned i = offsets[t]; i < offsets[t + 1]; i++) {
+            if (!useful[sources[i]]) {
+                useful[sources[i]] = 1;
+                stack.push_back(sources[i]);
+            }
+        }
+    }
+
+    // Renumber the useful states and route everything else to a single sink.
+    std::vector<unsigned> renumber(n + 1, n);
+    std::vector<fsm::State> states;
+    for (unsigned s = 0; s < n; s++) {
+        if (useful[s]) {
+            renumber[s] = states.size();
+            states.push_back(data.states[s]);
+        }
+    }
+
+    bool needs_sink = initial >= n || !useful[initial];
+    for (unsigned s = 0; s < n && !needs_sink; s++) {
+        for (unsigned j = 0; useful[s] && j < m; j++) {
+            if (!useful[next[(std::size_t)s * m + j]]) {
+                needs_sink = true;
+                break;
+            }
+        }
+    }
+
+    if (needs_sink) {
+        // Reuse the name of a merged state, the initial one when the language is empty.
+        fsm::State sink("sink");
+        if (initial < n && !useful[initial]) {
+            sink = data.states[initial];
+        } else {
+            for (unsigned s = 0; s < n; s++) {
+                if (reachable[s] && !useful[s]) {
+                    sink = data.states[s];
+                    break;
+                }
+            }
+        }
+        while (find_state(sink) != npos && useful[find_state(sink)]) {
+            sink = sink + fsm::State("'");
+        }
+        states.push_back(sink);
+    }
+
+    unsigned sink_id = states.size() - 1;
+    std::vector<std::vector<fsm::State>> table(states.size(), std::vector<fsm::State>(m));
+    for (unsigned s = 0; s < n; s++) {
+        if (!useful[s]) {
+            continue;
+        }
+        for (unsigned j = 0; j < m; j++) {
+            unsigned t = renumber[next[(std::size_t)s * m + j]];
+            table[renumber[s]][j] = states[t == n ? sink_id : t];
+        }
+    }
+    if (needs_sink) {
+        for (unsigned j = 0; j < m; j++) {
+            table[sink_id][j] = states[sink_id];
+        }
+    }
+
+    fsm::Bitmap final_states(states.size());
+    for (unsigned f = 0; f < n; f++) {
+        if (useful[f] && data.final_states.test(f) != complemented_) {
+            final_states.set(renumber[f]);
+        }
+    }
+
+    std::shared_ptr<Definition> trimmed = std::make_shared<Definition>();
+    trimmed->states = states;
+    trimmed->alphabet = data.alphabet;
+    trimmed->initial_state = initial >= n || !useful[initial] ? states[sink_id] : data.initial_state;
+    trimmed->final_states = final_states;
+    for (unsigned i = 0; i < states.size(); i++) {
+        auto it = data.labels.find(states[i].get_name());
+        if (final_states.test(i) && it != data.labels.end()) {
+            trimmed->labels.insert(*it);
+        }
+    }
+    trimmed->transition_table = std::move(table);
+    index_states(*trimmed);
+
+    data_ = trimmed;
+    complemented_ = false;
+    final_states_list_.reset();
+    restart();
+}
+
+template <typename T>
+fsm::FSM<T> fsm::FSM<T>::trimmed() const {
+    fsm::FSM<T> machine = *this;
+    machine.trim();
+    return machine;
+}
+
+template <typename T>
+uint64_t fsm::FSM<T>::structural_hash() const {
+    fsm::FSM<T> trimmed = *this;
+    trimmed.trim();
+    const Definition &data = *trimmed.data_;
+    unsigned n = data.states.size(), m = data.alphabet.size();
+
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&h](uint64_t value) {
+        h = (h ^ value) * 1099511628211ull;
+        h ^= h >> 29;
+    };
+
+    mix(m);
+    for (const T &symbol : data.alphabet) {
+        mix(std::hash<T>()(symbol));
+    }
+
+    // Number the states in the order a breadth first search discovers them.
+    std::vector<unsigned> number(n, npos), queue;
+    queue.reserve(n);
+    unsigned initial = trimmed.find_state(data.initial_state);
+    if (initial != npos) {
+        number[initial] = 0;
+        queue.push_back(initial);
+    }
+    for (std::size_t i = 0; i < queue.size(); i++) {
+        unsigned s = queue[i];
+        for (unsigned j = 0; j < m; j++) {
+            unsigned t = trimmed.find_state(data.transition_table[s][j]);
+            if (t != npos && number[t] == npos) {
+                number[t] = queue.size();
+                queue.push_back(t);
+            }
+        }
+    }
+
+    mix(queue.size());
+    for (unsigned s : queue) {
+        bool final = data.final_states.test(s) != trimmed.complemented_;
+        const fsm::Label *label = final ? trimmed.get_final_label(data.states[s]) : nullptr;
+        mix(final ? 1 : 0);
+        mix(label == nullptr ? 0 : ((uint64_t)label->token << 32 | (uint32_t)label->priority) + 1);
+        for (unsigned j = 0; j < m; j++) {
+            unsigned t = trimmed.find_state(data.transition_table[s][j]);
+            mix(t == npos ? npos : number[t]);
+        }
+    }
+
+    return h;
+}
+
+template <typename T>
+void fsm::FSM<T>::minimize() {
+    trim();
+
+    const Definition &data = *data_;
+    unsigned n = data.states.size(), m = data.alphabet.size();
+    if (n == 0) {
+        return;
+    }
+
+    std::vector<unsigned> next((std::size_t)n * m);
+    for (unsigned i = 0; i < n; i++) {
+        for (unsigned j = 0; j < m; j++) {
+            next[(std::size_t)i * m + j] = find_state(data.transition_table[i][j]);
+        }
+    }
+
+    // Sources of the transitions entering each state, grouped by (target, symbol).
+    std::vector<unsigned> offsets((std::size_t)n * m + 1, 0), sources((std::size_t)n * m);
+    for (std::size_t cell = 0; cell < next.size(); cell++) {
+        offsets[(std::size_t)next[cell] * m + cell % m + 1]++;
+    }
+    for (std::size_t i = 0; i < (std::size_t)n * m; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+    std::vector<unsigned> cursor(offsets.begin(), offsets.end() - 1);
+    for (std::size_t cell = 0; cell < next.size(); cell++) {
+        sources[cursor[(std::size_t)next[cell] * m + cell % m]++] = cell / m;
+    }
+
+    // The initial partition separates states by finality and label.
+    auto key = [this, &data](unsigned s) {
+        const fsm::Label *label = data.final_states.test(s) ? get_final_label(data.states[s]) : nullptr;
+        return std::make_tuple(data.final_states.test(s), label != nullptr,
+            label == nullptr ? 0u : label->token, label == nullptr ? 0 : label->priority);
+    };
+    std::vector<unsigned> elements(n), location(n), block(n), first, last, marked;
+    for (unsigned s = 0; s < n; s++) {
+        elements[s] = s;
+    }
+    std::stable_sort(elements.begin(), elements.end(), [&key](unsigned a, unsigned b) {
+        return key(a) < key(b);
+    });
+    for (unsigned i = 0; i < n; i++) {
+        if (i == 0 || key(elements[i]) != key(elements[i - 1])) {
+            first.push_back(i);
+            last.push_back(i);
+        }
+        last.back() = i + 1;
+        block[elements[i]] = first.size() - 1;
+        location[elements[i]] = i;
+    }
+    marked.assign(first.size(), 0);
+
+    // Every initial block but the largest one is a splitter.
+    std::vector<unsigned> work;
+    std::vector<char> waiting(first.size(), 0);
+    unsigned largest = 0;
+    for (unsigned b = 1; b < first.size(); b++) {
+        if (last[b] - first[b] > last[largest] - first[largest]) {
+            largest = b;
+        }
+    }
+    for (unsigned b = 0; b < first.size(); b++) {
+        if (b != largest) {
+            work.push_back(b);
+            waiting[b] = 1;
+        }
+    }
+
+    std::vector<unsigned> splitter, touched;
+    while (!work.empty()) {
+        unsigned b = work.back();
+        work.pop_back();
+        waiting[b] = 0;
+        splitter.assign(elements.begin() + first[b], elements.begin() + last[b]);
+
+        for (unsigned j = 0; j < m; j++) {
+            // Move the predecessors to the front of their blocks.
+            for (unsigned t : splitter) {
+                std::size_t cell = (std::size_t)t * m + j;
+                for (unsigned k = offsets[cell]; k < offsets[cell + 1]; k++) {
+                    unsigned s = sources[k], c = block[s];
+                    if (location[s] < first[c] + marked[c]) {
+                        continue;
+                    }
+                    if (marked[c] == 0) {
+                        touched.push_back(c);
+                    }
+                    unsigned swap_position = first[c] + marked[c], other = elements[swap_position];
+                    std::swap(elements[location[s]], elements[swap_position]);
+                    location[other] = location[s];
+                    location[s] = swap_position;
+                    marked[c]++;
+                }
+            }
+
+            // Split the blocks that were entered only partially.
+            for (unsigned c : touched) {
+                unsigned size = last[c] - first[c];
+                if (marked[c] < size) {
+                    unsigned split = first.size();
+                    first.push_back(first[c]);
+                    last.push_back(first[c] + marked[c]);
+                    first[c] += marked[c];
+                    marked.push_back(0);
+                    for (unsigned i = first[split]; i < last[split]; i++) {
+                        block[elements[i]] = split;
+                    }
+                    if (waiting[c] || marked[c] <= size - marked[c]) {
+                        work.push_back(split);
+                        waiting.push_back(1);
+                    } else {
+                        work.push_back(c);
+                        waiting[c] = 1;
+                        waiting.push_back(0);
+                    }
+                }
+                marked[c] = 0;
+            }
+            touched.clear();
+        }
+    }
+
+    collapse(next, block, first.size());
+}
+
+template <typename T>
+fsm::FSM<T> fsm::FSM<T>::canonical() const {
+    fsm::FSM<T> minimal = *this;
+    minimal.minimize();
+    const Definition &data = *minimal.data_;
+    unsigned n = data.states.size(), m = data.alphabet.size();
+
+    std::vector<unsigned> columns(m);
+    for (unsigned j = 0; j < m; j++) {
+        columns[j] = j;
+    }
+    std::sort(columns.begin(), columns.end(), [&data](unsigned a, unsigned b) {
+        return data.alphabet[a] < data.alphabet[b];
+    });
+
+    // Number the states in the order a breadth first search over the sorted alphabet finds them.
+    std::vector<unsigned> number(n, npos), queue;
+    queue.reserve(n);
+    unsigned initial = minimal.find_state(data.initial_state);
+    if (initial != npos) {
+        number[initial] = 0;
+        queue.push_back(initial);
+    }
+    for (std::size_t i = 0; i < queue.size(); i++) {
+        for (unsigned j : columns) {
+            unsigned t = minimal.find_state(data.transition_table[queue[i]][j]);
+            if (number[t] == npos) {
+                number[t] = queue.size();
+                queue.push_back(t);
+            }
+        }
+    }
+
+    std::shared_ptr<Definition> canonical = std::make_shared<Definition>();
+    for (unsigned j : columns) {
+        canonical->alphabet.push_back(data.alphabet[j]);
+    }
+    for (unsigned i = 0; i < queue.size(); i++) {
+        canonical->states.emplace_back(fsm::String("q") + fsm::String((int)i));
+    }
+    canonical->final_states = fsm::Bitmap(queue.size());
+    canonical->transition_table.assign(queue.size(), std::vector<fsm::State>(m));
+    for (unsigned i = 0; i < queue.size(); i++) {
+        unsigned s = queue[i];
+        for (unsigned j = 0; j < m; j++) {
+            unsigned t = minimal.find_state(data.transition_table[s][columns[j]]);
+            canonical->transition_table[i][j] = canonical->states[number[t]];
+        }
+        if (data.final_states.test(s)) {
+            canonical->final_states.set(i);
+            const fsm::Label *label = minimal.get_final_label(data.states[s]);
+            if (label != nullptr) {
+                canonical->labels.emplace(canonical->states[i].get_name(), *label);
+            }
+        }
+    }
+    if (!queue.empty()) {
+        canonical->initial_state = canonical->states[0];
+    }
+    index_states(*canonical);
+
+    fsm::FSM<T> result;
+    result.data_ = canonical;
+    result.restart();
+    return result;
+}
+
+template <typename T>
+fsm::Hash128 fsm::FSM<T>::canonical_hash() const {
+    fsm::FSM<T> form = canonical();
+    const Definition &data = *form.data_;
+    unsigned n = data.states.size(), m = data.alphabet.size();
+
+    // Two independent multiply-xorshift lanes over the same sequence of values.
+    uint64_t low = 0x243f6a8885a308d3ull, high = 0x13198a2e03707344ull;
+    auto mix = [&low, &high](uint64_t value) {
+        low = (low ^ value) * 0x9e3779b97f4a7c15ull;
+        low ^= low >> 32;
+        high = (high + value) * 0xbf58476d1ce4e5b9ull;
+        high ^= high >> 29;
+    };
+
+    mix(m);
+    for (const T &symbol : data.alphabet) {
+        mix(std::hash<T>()(symbol));
+    }
+    mix(n);
+    for (unsigned s = 0; s < n; s++) {
+        const fsm::Label *label = data.final_states.test(s) ? form.get_final_label(data.states[s]) : nullptr;
+        mix(data.final_states.test(s) ? 1 : 0);
+        mix(label == nullptr ? 0 : ((uint64_t)label->token << 32 | (uint32_t)label->priority) + 1);
+        for (unsigned j = 0; j < m; j++) {
+            mix(form.find_state(data.transition_table[s][j]));
+        }
+    }
+
+    return fsm::Hash128{low, high};
+}
+
+template <typename T>
+bool fsm::FSM<T>::equivalent(const fsm::FSM<T> &rhs) const {
+    fsm::FSM<T> lhs_form = canonical(), rhs_form = rhs.canonical();
+    const Definition &a = *lhs_form.data_, &b = *rhs_form.data_;
+    if (a.alphabet != b.alphabet || a.states.size() != b.states.size()) {
+        return false;
+    }
+
+    // Canonical states are named by their position, so rows compare by name.
+    for (unsigned s = 0; s < a.states.size(); s++) {
+        if (a.final_states.test(s) != b.final_states.test(s) || a.transition_table[s] != b.transition_table[s]) {
+            return false;
+        }
+        const fsm::Label *label_a = lhs_form.get_final_label(a.states[s]);
+        const fsm::Label *label_b = rhs_form.get_final_label(b.states[s]);
+        if ((label_a == nullptr) != (label_b == nullptr)
+            || (label_a != nullptr && (label_a->token != label_b->token || label_a->priority != label_b->priority))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+fsm::FSM<T> fsm::FSM<T>::parallel_union(const fsm::FSM<T> &rhs, unsigned threads) const {
+    return parallel_product(rhs, false, threads);
+}
+
+template <typename T>
+fsm::FSM<T> fsm::FSM<T>::parallel_intersection(const fsm::FSM<T> &rhs, unsigned threads) const {
+    return parallel_product(rhs, true, threads);
+}
+
+template <typename T>
+fsm::FSM<T> fsm::FSM<T>::parallel_product(const fsm::FSM<T> &rhs, bool intersect, unsigned threads) const {
+    threads = resolve_threads(threads);
+    const Definition &left = *data_, &right = *rhs.data_;
+    unsigned m = left.alphabet.size();
+
+    std::vector<unsigned> columns(m);
+    for (unsigned j = 0; j < m; j++) {
+        auto it = std::find(right.alphabet.begin(), right.alphabet.end(), left.alphabet[j]);
+        if (it == right.alphabet.end()) {
+            throw AutomationException("Input is not in alphabet", __FILE__, __LINE__);
+        }
+        columns[j] = it - right.alphabet.begin();
+    }
+
+    unsigned initial1 = find_state(left.initial_state), initial2 = rhs.find_state(right.initial_state);
+    if (initial1 == npos || initial2 == npos) {
+        throw AutomationException("The initial state is not a valid state", __FILE__, __LINE__);
+    }
+    std::vector<unsigned> next1 = transition_ids(threads), next2 = rhs.transition_ids(threads);
+
+    // Ids are given in breadth first order. The states of a level are numbered after the
+    // level is expanded, in the order of the first (state, symbol) that reached them,
+    // which is the order a single thread would produce.
+    std::vector<ProductShard> shards(PRODUCT_SHARDS);
+    std::vector<uint64_t> pairs{(uint64_t)initial1 << 32 | initial2};
+    std::vector<uint64_t> targets;
+    std::vector<unsigned> table;
+    shards[shard_of(pairs[0])].ids.emplace(pairs[0], 0);
+
+    for (std::size_t begin = 0; begin < pairs.size();) {
+        std::size_t end = pairs.size();
+        std::vector<std::vector<uint64_t>> discovered(threads);
+        std::atomic<bool> incomplete(false);
+        targets.resize((end - begin) * m);
+
+        parallel_for(threads, end - begin, [&](std::size_t from, std::size_t to, std::size_t worker) {
+            for (std::size_t i = from; i < to; i++) {
+                uint64_t pair = pairs[begin + i];
+                std::size_t row1 = (std::size_t)(pair >> 32) * m, row2 = (std::size_t)(uint32_t)pair * right.alphabet.size();
+                for (unsigned j = 0; j < m; j++) {
+                    unsigned a = next1[row1 + j], b = next2[row2 + columns[j]];
+                    if (a == npos || b == npos) {
+                        incomplete = true;
+                        continue;
+                    }
+                    uint64_t key = (uint64_t)a << 32 | b, rank = i * m + j;
+                    targets[i * m + j] = key;
+
+                    ProductShard &shard = shards[shard_of(key)];
+                    std::lock_guard<std::mutex> lock(shard.mutex);
+                    auto inserted = shard.ids.emplace(key, PENDING | rank);
+                    if (inserted.second) {
+                        discovered[worker].push_back(key);
+                    } else if ((inserted.first->second & PENDING) && rank < (inserted.first->second & ~PENDING)) {
+                        inserted.first->second = PENDING | rank;
+                    }
+                }
+            }
+        });
+        if (incomplete) {
+            throw AutomationException("State is not a valid state", __FILE__, __LINE__);
+        }
+
+        // No state is inserted until the next level, so the shards are only read and
+        // distinct entries updated from here on.
+        std::vector<std::pair<uint64_t, uint64_t>> fresh;
+        for (const std::vector<uint64_t> &keys : discovered) {
+            for (uint64_t key : keys) {
+                fresh.emplace_back(shards[shard_of(key)].ids.find(key)->second & ~PENDING, key);
+            }
+        }
+        std::sort(fresh.begin(), fresh.end());
+        parallel_for(threads, fresh.size(), [&](std::size_t from, std::size_t to, std::size_t) {
+            for (std::size_t k = from; k < to; k++) {
+                shards[shard_of(fresh[k].second)].ids.find(fresh[k].second)->second = end + k;
+            }
+        });
+        for (const auto &entry : fresh) {
+            pairs.push_back(entry.second);
+        }
+
+        table.resize(end * m);
+        parallel_for(threads, end - begin, [&](std::size_t from, std::size_t to, std::size_t) {
+            for (std::size_t cell = from * m; cell < to * m; cell++) {
+                table[begin * m + cell] = shards[shard_of(targets[cell])].ids.find(targets[cell])->second;
+            }
+        });
+        begin = end;
+    }
+
+    std::size_t n = pairs.size();
+    std::shared_ptr<Definition> data = std::make_shared<Definition>();
+    data->alphabet = left.alphabet;
+    data->states.resize(n);
+    data->transition_table.resize(n);
+    parallel_for(threads, n, [&](std::size_t from, std::size_t to, std::size_t) {
+        for (std::size_t s = from; s < to; s++) {
+            data->states[s] = left.states[pairs[s] >> 32] + right.states[(uint32_t)pairs[s]];
+        }
+    });
+    parallel_for(threads, n, [&](std::size_t from, std::size_t to, std::size_t) {
+        for (std::size_t s = from; s < to; s++) {
+            data->transition_table[s].resize(m);
+            for (unsigned j = 0; j < m; j++) {
+                data->transition_table[s][j] = data->states[table[s * m + j]];
+            }
+        }
+    });
+
+    data->initial_state = data->states[0];
+    data->final_states = fsm::Bitmap(n);
+    for (std::size_t s = 0; s < n; s++) {
+        unsigned a = pairs[s] >> 32, b = (uint32_t)pairs[s];
+        bool final1 = left.final_states.test(a) != complemented_, final2 = right.final_states.test(b) != rhs.complemented_;
+        if (intersect ? !(final1 && final2) : !(final1 || final2)) {
+            continue;
+        }
+
+        // Keep the label with the higher priority, the left operand wins ties.
+        data->final_states.set(s);
+        const fsm::Label *label1 = final1 ? get_final_label(left.states[a]) : nullptr;
+        const fsm::Label *label2 = final2 ? rhs.get_final_label(right.states[b]) : nullptr;
+        if (label1 != nullptr && (label2 == nullptr || label1->priority >= label2->priority)) {
+            data->labels.emplace(data->states[s].get_name(), *label1);
+        } else if (label2 != nullptr) {
+            data->labels.emplace(data->states[s].get_name(), *label2);
+        }
+    }
+
+    index_states(*data);
+    if (data->state_ids.size() != n) {
+        throw AutomationException("The names of two product states collide", __FILE__, __LINE__);
+    }
+
+    fsm::FSM<T> productMachine;
+    productMachine.data_ = data;
+    productMachine.restart();
+    return productMachine;
+}
+
+template <typename T>
+void fsm::FSM<T>::parallel_minimize(unsigned threads) {
+    threads = resolve_threads(threads);
+    trim();
+
+    const Definition &data = *data_;
+    unsigned n = data.states.size(), m = data.alphabet.size();
+    if (n == 0) {
+        return;
+    }
+    std::vector<unsigned> next = transition_ids(threads);
+
+    // The initial partition separates states by finality and label, numbered in key order.
+    std::vector<std::tuple<bool, bool, unsigned, int>> keys(n);
+    for (unsigned s = 0; s < n; s++) {
+        const fsm::Label *label = data.final_states.test(s) ? get_final_label(data.states[s]) : nullptr;
+        keys[s] = std::make_tuple(data.final_states.test(s), label != nullptr,
+            label == nullptr ? 0u : label->token, label == nullptr ? 0 : label->priority);
+    }
+    std::vector<std::tuple<bool, bool, unsigned, int>> distinct(keys);
+    std::sort(distinct.begin(), distinct.end());
+    distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+    std::vector<unsigned> block(n), refined(n);
+    for (unsigned s = 0; s < n; s++) {
+        block[s] = std::lower_bound(distinct.begin(), distinct.end(), keys[s]) - distinct.begin();
+    }
+    unsigned blocks = distinct.size();
+
+    // Moore rounds: states stay together while their block and the blocks of all their
+    // successors agree. Each round signatures are hashed in parallel and the states are
+    // bucketed by hash, one bucket per thread, so the grouping runs in parallel too.
+    std::vector<uint64_t> hashes(n);
+    std::vector<unsigned> bucketed(n), local(n);
+    std::vector<std::size_t> counts((std::size_t)threads * threads), offsets(threads + 1);
+    std::vector<std::vector<unsigned>> firsts(threads);
+    auto same_signature = [&next, &block, m](unsigned a, unsigned b) {
+        if (block[a] != block[b]) {
+            return false;
+        }
+        for (unsigned j = 0; j < m; j++) {
+            if (block[next[(std::size_t)a * m + j]] != block[next[(std::size_t)b * m + j]]) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    for (;;) {
+        std::fill(counts.begin(), counts.end(), 0);
+        parallel_for(threads, n, [&](std::size_t from, std::size_t to, std::size_t worker) {
+            for (std::size_t s = from; s < to; s++) {
+                uint64_t h = block[s] * 0x9e3779b97f4a7c15ull;
+                for (unsigned j = 0; j < m; j++) {
+                    h = (h ^ block[next[s * m + j]]) * 0xbf58476d1ce4e5b9ull;
+                    h ^= h >> 31;
+                }
+                hashes[s] = h;
+                counts[worker * threads + h % threads]++;
+            }
+        });
+
+        // Bucket b holds its states in increasing order: the ranges are concatenated in order.
+        std::vector<std::size_t> cursors((std::size_t)threads * threads);
+        std::size_t position = 0;
+        for (unsigned b = 0; b < threads; b++) {
+            offsets[b] = position;
+            for (unsigned w = 0; w < threads; w++) {
+                cursors[w * threads + b] = position;
+                position += counts[w * threads + b];
+            }
+        }
+        offsets[threads] = position;
+        parallel_for(threads, n, [&](std::size_t from, std::size_t to, std::size_t worker) {
+            for (std::size_t s = from; s < to; s++) {
+                bucketed[cursors[worker * threads + hashes[s] % threads]++] = s;
+            }
+        });
+
+        // Within a bucket, blocks are numbered by their first state.
+        parallel_for(threads, threads, [&](std::size_t from, std::size_t to, std::size_t) {
+            for (std::size_t b = from; b < to; b++) {
+                // Blocks with the same hash are chained from the last one found.
+                std::unordered_map<uint64_t, unsigned> heads;
+                std::vector<unsigned> chain;
+                heads.reserve(offsets[b + 1] - offsets[b]);
+                firsts[b].clear();
+                for (std::size_t k = offsets[b]; k < offsets[b + 1]; k++) {
+                    unsigned s = bucketed[k];
+                    auto head = heads.emplace(hashes[s], npos).first;
+                    unsigned found = head->second;
+                    while (found != npos && !same_signature(firsts[b][found], s)) {
+                        found = chain[found];
+                    }
+                    if (found == npos) {
+                        found = firsts[b].size();
+                        firsts[b].push_back(s);
+                        chain.push_back(head->second);
+                        head->second = found;
+                    }
+                    local[s] = found;
+                }
+            }
+        }, 1);
+
+        // Number the new blocks by their first state, independently of the buckets.
+        std::vector<unsigned> starts;
+        for (unsigned b = 0; b < threads; b++) {
+            starts.insert(starts.end(), firsts[b].begin(), firsts[b].end());
+        }
+        std::sort(starts.begin(), starts.end());
+        unsigned refined_blocks = starts.size();
+        std::vector<unsigned> number(n);
+        for (unsigned i = 0; i < refined_blocks; i++) {
+            number[starts[i]] = i;
+        }
+        parallel_for(threads, n, [&](std::size_t from, std::size_t to, std::size_t) {
+            for (std::size_t s = from; s < to; s++) {
+                refined[s] = number[firsts[hashes[s] % threads][local[s]]];
+            }
+        });
+
+        block.swap(refined);
+        if (refined_blocks == blocks) {
+            break;
+        }
+        blocks = refined_blocks;
+    }
+
+    collapse(next, block, blocks);
+}
+
+template <typename T>
+std::vector<unsigned> fsm::FSM<T>::transition_ids(unsigned threads) const {
+    const Definition &data = *data_;
+    unsigned m = data.alphabet.size();
+    std::vector<unsigned> next(data.states.size() * m);
+    parallel_for(threads, data.states.size(), [&](std::size_t from, std::size_t to, std::size_t) {
+        for (std::size_t i = from; i < to; i++) {
+            for (unsigned j = 0; j < m; j++) {
+                next[i * m + j] = find_state(data.transition_table[i][j]);
+            }
+        }
+    });
+    return next;
+}
+
+template <typename T>
+void fsm::FSM<T>::collapse(const std::vector<unsigned> &next, const std::vector<unsigned> &block, unsigned blocks) {
+    const Definition &data = *data_;
+    unsigned n = data.states.size(), m = data.alphabet.size();
+
+    // One state per block, named after its first state in the original order.
+    std::vector<unsigned> representative(blocks, n);
+    for (unsigned s = 0; s < n; s++) {
+        representative[block[s]] = std::min(representative[block[s]], s);
+    }
+    std::vector<unsigned> order(representative.begin(), representative.end());
+    std::sort(order.begin(), order.end());
+    std::vector<unsigned> renumber(blocks);
+    for (unsigned i = 0; i < blocks; i++) {
+        renumber[block[order[i]]] = i;
+    }
+
+    std::shared_ptr<Definition> minimal = std::make_shared<Definition>();
+    minimal->alphabet = data.alphabet;
+    minimal->final_states = fsm::Bitmap(blocks);
+    minimal->transition_table.assign(blocks, std::vector<fsm::State>(m));
+    for (unsigned i = 0; i < blocks; i++) {
+        minimal->states.push_back(data.states[order[i]]);
+    }
+    for (unsigned i = 0; i < blocks; i++) {
+        unsigned s = order[i];
+        for (unsigned j = 0; j < m; j++) {
+            minimal->transition_table[i][j] = minimal->states[renumber[block[next[(std::size_t)s * m + j]]]];
+        }
+        if (data.final_states.test(s)) {
+            minimal->final_states.set(i);
+            auto it = data.labels.find(data.states[s].get_name());
+            if (it != data.labels.end()) {
+                minimal->labels.insert(*it);
+            }
+        }
+    }
+    minimal->initial_state = minimal->states[renumber[block[find_state(data.initial_state)]]];
+    index_states(*minimal);
+
+    data_ = minimal;
+    complemented_ = false;
+    final_states_list_.reset();
+    restart();
 }
 
 template <typename T>
 void fsm::FSM<T>::validate_states() const {
-    std::set<fsm::String> uniq_states;
-    for (const State& state : states_) {
+    std::unordered_set<fsm::String> uniq_states;
+    uniq_states.reserve(data_->states.size());
+    for (const State& state : data_->states) {
         uniq_states.insert(state.get_name());
     }
-    if (uniq_states.size() > states_.size()) {
+    if (uniq_states.size() < data_->states.size()) {
         throw AutomationException("Duplicated states", __FILE__, __LINE__);
     }
 }
 
 template <typename T>
 void fsm::FSM<T>::validate_initial_state() const {
-    for (const State& state : states_) {
-        if (state == initial_state_) {
-            return;
-        }
+    if (find_state(data_->initial_state) != npos) {
+        return;
     }
     throw AutomationException("Initial state is not a valid state", __FILE__, __LINE__);
 }
 
 template <typename T>
 void fsm::FSM<T>::validate_final_states() const {
-    for (const State& final_state : final_states_) {
-        bool missing = true;
-        for (const State &state : states_) {
-            if (state == final_state) {
-                missing = false;
-                break;
-            }
-        }
-        if (missing) {
+    std::unordered_set<fsm::String> names;
+    names.reserve(data_->states.size());
+    for (const State& state : data_->states) {
+        names.insert(state.get_name());
+    }
+    for (const State& final_state : get_final_states()) {
+        if (names.count(final_state.get_name()) == 0) {
             throw AutomationException("At least one final state is not a valid state", __FILE__, __LINE__);
         }
     }
@@ -282,7 +1280,11 @@ bool fsm::FSM<T>::evaluate(const char* input) {
     fsm::String word(input);
 
     for(int i = 0, l = word.size(); i < l; i++){
-        FSM::transition(word[i] - '0'); // convert char to int
+        if constexpr (std::is_same<T, char>::value) {
+            FSM::transition(word[i]);
+        } else {
+            FSM::transition(word[i] - '0'); // convert char to int
+        }
     }
 
     bool flag = FSM::is_in_final_state();
@@ -293,22 +1295,19 @@ bool fsm::FSM<T>::evaluate(const char* input) {
 
 template <typename T>
 fsm::FSM<T> fsm::FSM<T>::operator!() const {
-    std::vector<fsm::State> newFinalStates;
     fsm::FSM<T> complementMachine = *this;
-
-    for(int i = 0, sz = get_states_count(); i < sz; i++){
-        if(std::find(final_states_.begin(),final_states_.end(),states_[i]) == final_states_.end()){
-            newFinalStates.push_back(states_[i]);
-        }
-    }
-
-    complementMachine.set_final_states(newFinalStates);
-
+    complementMachine.complemented_ = !complemented_;
+    complementMachine.final_states_list_.reset();
     return complementMachine;
 }
 
 template <typename T>
 fsm::FSM<T> fsm::FSM<T>::operator|(const fsm::FSM<T> &rhs) const {
+    return product(rhs);
+}
+
+template <typename T>
+fsm::FSM<T> fsm::FSM<T>::product(const fsm::FSM<T> &rhs) const {
     fsm::FSM<T> unionMachine, thisMachine = *this, otherMachine = rhs;
     thisMachine.restart();
     otherMachine.restart();
@@ -320,7 +1319,7 @@ fsm::FSM<T> fsm::FSM<T>::operator|(const fsm::FSM<T> &rhs) const {
     for (int i = 0, sz = get_alphabet_count(); i < sz; i++) {
       unionMachine.add_symbol(alphabet[i]);
     }
-    unionMachine.add_state(comboState);
+    fsm::add_product_state(thisMachine, otherMachine, unionMachine, comboState);
 
     fsm::fill(thisMachine, otherMachine, unionMachine, comboState);
 
@@ -334,7 +1333,7 @@ template <typename T>
 void fsm::fill(fsm::FSM<T> m1, fsm::FSM<T> m2, fsm::FSM<T> &m3, fsm::State prevState) {
     for (int i = 0, sz = m1.get_alphabet_count(); i < sz; i++) {
         auto m1old = m1, m2old = m2;
-        auto m3States = m3.get_states();
+        const std::vector<fsm::State> &m3States = m3.get_states();
         char currLetter = m3.get_alphabet()[i];
 
         m1.transition(currLetter);
@@ -343,10 +1342,7 @@ void fsm::fill(fsm::FSM<T> m1, fsm::FSM<T> m2, fsm::FSM<T> &m3, fsm::State prevS
         fsm::State comboState = m1.get_current_state() + m2.get_current_state();
 
         if (std::find(m3States.begin(), m3States.end(), comboState) == m3States.end()){
-            m3.add_state(comboState);
-            if (m1.is_in_final_state() || m2.is_in_final_state()) {
-                m3.add_final_state(comboState);
-            }
+            fsm::add_product_state(m1, m2, m3, comboState);
             fsm::fill(m1, m2, m3, comboState);
         }
         m3.add_transition_rule(prevState, currLetter, comboState);
@@ -355,10 +1351,27 @@ void fsm::fill(fsm::FSM<T> m1, fsm::FSM<T> m2, fsm::FSM<T> &m3, fsm::State prevS
     }
 }
 
+template <typename T>
+void fsm::add_product_state(const fsm::FSM<T> &m1, const fsm::FSM<T> &m2, fsm::FSM<T> &m3, const fsm::State &comboState) {
+    m3.add_state(comboState);
+    if (m1.is_in_final_state() || m2.is_in_final_state()) {
+        // Keep the label with the higher priority, the left operand wins ties.
+        const fsm::Label *label1 = m1.is_in_final_state() ? m1.get_final_label(m1.get_current_state()) : nullptr;
+        const fsm::Label *label2 = m2.is_in_final_state() ? m2.get_final_label(m2.get_current_state()) : nullptr;
+        if (label1 != nullptr && (label2 == nullptr || label1->priority >= label2->priority)) {
+            m3.add_final_state(comboState, label1->token, label1->priority);
+        } else if (label2 != nullptr) {
+            m3.add_final_state(comboState, label2->token, label2->priority);
+        } else {
+            m3.add_final_state(comboState);
+        }
+    }
+}
+
 template <typename T>
 fsm::FSM<T> fsm::FSM<T>::operator&(const fsm::FSM<T> &rhs) const {
     std::vector<fsm::State> newEndStates;
-    fsm::FSM<T> unionMachine = *this | rhs;
+    fsm::FSM<T> unionMachine = product(rhs);
     auto thisFinalStates = get_final_states();  // get sub-final states
     auto otherFinalStates = rhs.get_final_states(); // get sub-final states
     auto unionEndStates = unionMachine.get_final_states();
@@ -374,7 +1387,6 @@ fsm::FSM<T> fsm::FSM<T>::operator&(const fsm::FSM<T> &rhs) const {
 
     fsm::FSM<T> intersectionMachine = unionMachine;
     intersectionMachine.set_final_states(newEndStates);
-
     return intersectionMachine;
 }
 
@@ -385,7 +1397,7 @@ std::ostream &fsm::FSM<T>::ins(std::ostream &out) const {
     fsm::State st;
 
     for(int i = 0; i < stateC; i++){
-        out << states_[i] << " | ";
+        out << data_->states[i] << " | ";
         for(int j = 0; j < alphaC; j++){
             st = table[i][j];
             out << st << "\t";
@@ -404,29 +1416,34 @@ std::ostream& fsm::FSM<T>::fins(std::ostream& out) const {
     out << alphaC;
 
     for (int i = 0; i < alphaC; i++) {
-        out << " " << alphabet_[i] - '0';
+        if constexpr (std::is_same<T, char>::value) {
+            out << " " << data_->alphabet[i];
+        } else {
+            out << " " << data_->alphabet[i] - '0';
+        }
     }
 
     out << "\n" << stateC;
 
     for (int i = 0; i < stateC; i++) {
-        out << " " << states_[i].get_name();
+        out << " " << data_->states[i].get_name();
     }
 
     out << "\n";
     for (int i = 0; i < stateC; i++) {
         for (int j = 0; j < alphaC; j++) {
-            out << transition_table_[i][j].get_name() << " ";
+            out << data_->transition_table[i][j].get_name() << " ";
             //if (j < alphaC - 1) { out << " "; }
         }
         out << "\n";
     }
 
-    out << initial_state_.get_name() << "\n";
+    out << data_->initial_state.get_name() << "\n";
     out << endSC;
 
+    const std::vector<fsm::State> &final_states = get_final_states();
     for (int i = 0; i < endSC; i++) {
-        out << " " << final_states_[i].get_name();
+        out << " " << final_states[i].get_name();
     }
 
     return out;
@@ -442,9 +1459,6 @@ std::istream& fsm::FSM<T>::ext(std::istream& in) {
         std::cout.setstate(std::ios_base::failbit);
     }
 
-    // Bug: If states are added before symbols, the
-    // transition table does not resize.
-
     std::cout << "Enter the number of letters: ";
     in >> alphaCount;
 
@@ -465,15 +1479,16 @@ std::istream& fsm::FSM<T>::ext(std::istream& in) {
 
     for (int i = 0; i < stateCount; i++) {
         for (int j = 0; j < alphaCount; j++) {
-            std::cout << "\nWhere does " << states_[i] << " go with letter \"" << char(alphabet_[j]) << "\" ?: ";
+            std::cout << "\nWhere does " << data_->states[i] << " go with letter \"" << char(data_->alphabet[j]) << "\" ?: ";
             in >> stateName;
-            add_transition_rule(states_[i], alphabet_[j], states_[indexOfState(fsm::State(stateName))]);
+            fsm::State next_state = data_->states[indexOfState(fsm::State(stateName))];
+            add_transition_rule(data_->states[i], data_->alphabet[j], next_state);
         }
     }
 
     std::cout << "\nEnter the starting state: ";
     in >> stateName;
-    initial_state_ = states_[indexOfState(fsm::State(stateName))];
+    set_initial_state(data_->states[indexOfState(fsm::State(stateName))]);
 
     std::cout << "\nEnter the number of end-states: ";
     in >> endStateCount;
@@ -481,10 +1496,10 @@ std::istream& fsm::FSM<T>::ext(std::istream& in) {
     for (int i = 0; i < endStateCount; i++) {
         std::cout << "\nEnter name of end-state " << i << " : ";
         in >> stateName;
-        add_final_state(states_[indexOfState(fsm::State(stateName))]);
+        add_final_state(data_->states[indexOfState(fsm::State(stateName))]);
     }
 
-    current_state_ = &initial_state_;
+    restart();
 
     validate_states();
     validate_initial_state();
@@ -513,3 +1528,5 @@ template class fsm::FSM<int>;
 template class fsm::FSM<char>;
 template std::ostream &fsm::operator<<(std::ostream &out, const fsm::FSM<int> &rhs);
 template std::ostream &fsm::operator<<(std::ostream &out, const fsm::FSM<char> &rhs);
+template std::istream &fsm::operator>>(std::istream &in, fsm::FSM<int> &rhs);
+template std::istream &fsm::operator>>(std::istream &in, fsm::FSM<char> &rhs);
@@ -1,12 +1,41 @@
 #ifndef AUTOMATA_FSM_H
 #define AUTOMATA_FSM_H
 
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
+#include "bitmap.h"
 #include "state.h"
 
 namespace fsm {
+    /**
+     * The token carried by a labelled final state.
+     * When machines are combined, the label with the higher priority wins.
+     */
+    struct Label {
+        unsigned token;
+        int priority;
+    };
+
+    /**
+     * A 128-bit hash of the canonical form of a machine.
+     */
+    struct Hash128 {
+        uint64_t low;
+        uint64_t high;
+
+        bool operator==(const Hash128 &rhs) const {
+            return low == rhs.low && high == rhs.high;
+        }
+
+        bool operator!=(const Hash128 &rhs) const {
+            return !(*this == rhs);
+        }
+    };
+
     /**
      * FSM is a class that implments a finite state machine.
      * An FSM instance can be in an exactly one state at a time
@@ -14,16 +43,32 @@ namespace fsm {
      * Changes from state to state happen by reading an input
      * symbol from the alphabet of the FSM and follow the transiton
      * rules defined by the transition_table of the FSM.
+     * States are indexed by name and the final states are kept in a bitmap
+     * indexed by state id, so accept checks are a single bit test and the
+     * complement only flips how the bitmap is read.
+     * Copies share the definition of the machine and the first mutator called
+     * on a shared copy detaches it, so copying and passing machines is O(1).
      */
     template <typename T>
     class FSM {
     private:
-        std::vector<fsm::State> states_;
-        std::vector<T> alphabet_;
-        fsm::State initial_state_;
-        std::vector<fsm::State> final_states_;
-        std::vector<std::vector<fsm::State>> transition_table_;
-        fsm::State *current_state_;
+        /**
+         * The definition of a machine, shared between copies until one of them changes it.
+         */
+        struct Definition {
+            std::vector<fsm::State> states;
+            std::unordered_map<fsm::String, unsigned> state_ids;
+            std::vector<T> alphabet;
+            fsm::State initial_state;
+            fsm::Bitmap final_states;
+            std::unordered_map<fsm::String, fsm::Label> labels;
+            std::vector<std::vector<fsm::State>> transition_table;
+        };
+
+        std::shared_ptr<const Definition> data_;
+        bool complemented_;
+        mutable std::shared_ptr<const std::vector<fsm::State>> final_states_list_;
+        unsigned current_state_;
     public:
         /**
          * No arguments constructor for the FSM.
@@ -54,6 +99,12 @@ namespace fsm {
          */
         FSM(const fsm::FSM<T>& rhs);
 
+        /**
+         * A move constructor for FSM. Leaves **rhs** as an empty machine.
+         * @param FSM<T> &&rhs: An FSM to be moved.
+         */
+        FSM(fsm::FSM<T>&& rhs) noexcept;
+
         /**
          * A destructor for the FSM.
          */
@@ -66,6 +117,12 @@ namespace fsm {
          */
         fsm::FSM<T>& operator=(const fsm::FSM<T>& rhs);
 
+        /**
+         * A move assignment operator for FSM. Leaves **rhs** as an empty machine.
+         * @param FSM<T> &&rhs: An FSM that we wish to move to the one on the left side of the operator.
+         */
+        fsm::FSM<T>& operator=(fsm::FSM<T>&& rhs) noexcept;
+
         /**
          * Returns the number of states for the FSM.
          */
@@ -154,6 +211,21 @@ namespace fsm {
          */
         void add_final_state(const State& state);
 
+        /**
+         * Adds a new final state to the FSM that carries a token.
+         * Final states added without a label carry token 0 with priority 0.
+         * @param State &state: A state that will be added to the set of valid final states for the FSM.
+         * @param unsigned token: The token recognised when the machine stops in **state**.
+         * @param int priority: Decides which token wins when this machine is combined with another one.
+         */
+        void add_final_state(const State& state, unsigned token, int priority = 0);
+
+        /**
+         * Returns the label of a final state or nullptr if it was added without one.
+         * @param State &state: A final state of the FSM.
+         */
+        const fsm::Label *get_final_label(const State& state) const;
+
         /**
          * Adds a new symbol to the machine's alphabet.
          * Note: it automatically grows the transition table by adding a new column at the end.
@@ -172,6 +244,7 @@ namespace fsm {
         /**
          * Takes an input and transitions the state of the machine
          * to the next state according to the to the transition table.
+         * Throws AutomationException if the symbol is not in the alphabet.
          * @param T input: A symbol from the FSM's alphabet.
          */
         void transition(T input);
@@ -183,11 +256,13 @@ namespace fsm {
 
         /**
          * Returns true if the word is recognised by the machine.
+         * An FSM<char> reads the characters as they are, other machines read the digit '0' + s as the symbol s.
          */
         bool evaluate(const char* word);
 
         /**
          * Returns the compliment machine.
+         * Only the interpretation of the final states bitmap is flipped, no states are searched.
          */
         fsm::FSM<T> operator!() const;
 
@@ -238,14 +313,142 @@ namespace fsm {
          * Returns the machine back to the initial state.
          */
         void restart();
+
+        /**
+         * Removes the states that are unreachable from the initial state and merges
+         * the states that can never reach a final state into a single non-final sink.
+         * The remaining states keep their relative order and the machine is restarted.
+         * Runs in time linear in the size of the transition table.
+         */
+        void trim();
+
+        /**
+         * Returns a trimmed copy of the machine, for trimming the result of an expression in place,
+         * as in (a & b).trimmed().
+         */
+        fsm::FSM<T> trimmed() const;
+
+        /**
+         * Returns a hash of the structure of the machine that ignores state names.
+         * The trimmed machine is numbered in breadth first order from the initial state,
+         * following the alphabet order, and its alphabet, final states, labels and
+         * transitions are hashed. Equal machines up to renaming and unreachable or
+         * useless states get the same hash.
+         */
+        uint64_t structural_hash() const;
+
+        /**
+         * Trims the machine and merges its equivalent states with Hopcroft's algorithm in O(m n log n).
+         * Final states with different labels are never merged. Every merged block keeps
+         * the name of its first state and the machine is restarted.
+         */
+        void minimize();
+
+        /**
+         * Returns the canonical form of the machine: minimized, with a sorted alphabet and
+         * states renamed q0, q1, ... in breadth first order from the initial state.
+         * Machines accepting the same language with the same labels have identical canonical forms.
+         */
+        fsm::FSM<T> canonical() const;
+
+        /**
+         * Returns a 128-bit hash of the canonical form, equal for equivalent machines.
+         */
+        fsm::Hash128 canonical_hash() const;
+
+        /**
+         * Returns true if both machines accept the same language with the same labels,
+         * by comparing their canonical forms.
+         * @param FSM<T> &rhs: Another FSM to compare with **this**.
+         */
+        bool equivalent(const fsm::FSM<T> &rhs) const;
+
+        /**
+         * Returns the union of the operands, built by a level-synchronous breadth first search
+         * over the pairs of states that runs on several threads.
+         * States are numbered in breadth first order, the same for every thread count.
+         * @param FSM<T> &rhs: Another FSM that will be unified with **this**.
+         * @param unsigned threads: Number of threads, 0 uses one per hardware thread.
+         */
+        fsm::FSM<T> parallel_union(const fsm::FSM<T> &rhs, unsigned threads = 0) const;
+
+        /**
+         * Returns the intersection of the operands, built like parallel_union().
+         * @param FSM<T> &rhs: Another FSM that will be intersected with **this**.
+         * @param unsigned threads: Number of threads, 0 uses one per hardware thread.
+         */
+        fsm::FSM<T> parallel_intersection(const fsm::FSM<T> &rhs, unsigned threads = 0) const;
+
+        /**
+         * Minimizes the machine with Moore's algorithm, refining the partition in parallel rounds.
+         * The result is identical to minimize() for every thread count.
+         * @param unsigned threads: Number of threads, 0 uses one per hardware thread.
+         */
+        void parallel_minimize(unsigned threads = 0);
     private:
 
+        /**
+         * Returns the product of the operands, a state is final if it is final in either operand.
+         * @param FSM<T> &rhs: Another FSM that will be combined with **this**.
+         */
+        fsm::FSM<T> product(const fsm::FSM<T> &rhs) const;
+
+        /**
+         * Returns the product of the operands built on several threads.
+         * @param FSM<T> &rhs: Another FSM that will be combined with **this**.
+         * @param bool intersect: Whether a state is final only if it is final in both operands.
+         * @param unsigned threads: Number of threads.
+         */
+        fsm::FSM<T> parallel_product(const fsm::FSM<T> &rhs, bool intersect, unsigned threads) const;
+
+        /**
+         * Returns the transition table as state ids, row after row, npos for unknown states.
+         */
+        std::vector<unsigned> transition_ids(unsigned threads) const;
+
+        /**
+         * Replaces the machine with one state per block of a partition of its trimmed states.
+         * Every block keeps the name of its first state and the blocks keep the order of those states.
+         * @param vector<unsigned> &next: The transition table as state ids.
+         * @param vector<unsigned> &block: The block of every state.
+         * @param unsigned blocks: Number of blocks.
+         */
+        void collapse(const std::vector<unsigned> &next, const std::vector<unsigned> &block, unsigned blocks);
+
+        /**
+         * Id of states that are not part of the machine.
+         */
+        static constexpr unsigned npos = 0xffffffffu;
+
+        /**
+         * Returns the definition shared by all empty machines.
+         */
+        static const std::shared_ptr<const Definition> &empty_definition();
+
+        /**
+         * Returns the definition for writing, copying it first if it is shared with another machine.
+         */
+        Definition &mutate();
+
         /**
          * Returns the index at which a given state resides.
+         * Throws AutomationException if the state is not part of the machine.
          * @param State &st: The state for which the FSM is queried.
          */
         unsigned indexOfState(const fsm::State& st) const;
 
+        /**
+         * Returns the index of a state or npos if the state is not part of the machine.
+         * @param State &st: The state for which the FSM is queried.
+         */
+        unsigned find_state(const fsm::State& st) const;
+
+        /**
+         * Rebuilds the name index of the states.
+         * @param Definition &data: The definition to index.
+         */
+        static void index_states(Definition &data);
+
         /**
          * Validates that there are no duplicated states.
          */
@@ -280,6 +483,24 @@ namespace fsm {
 
     template <typename T>
     void fill(fsm::FSM<T> m1, fsm::FSM<T> m2, fsm::FSM<T> &m3, fsm::State prevState = State());
+
+    /**
+     * Adds the pair of the current states of **m1** and **m2** to **m3**, final if either of them is final.
+     */
+    template <typename T>
+    void add_product_state(const fsm::FSM<T> &m1, const fsm::FSM<T> &m2, fsm::FSM<T> &m3, const fsm::State &comboState);
+}
+
+namespace std {
+    /**
+     * Hash support so canonical hashes can be used as keys of unordered containers.
+     */
+    template <>
+    struct hash<fsm::Hash128> {
+        std::size_t operator()(const fsm::Hash128 &h) const noexcept {
+            return h.low ^ (h.high * 0x9e3779b97f4a7c15ull);
+        }
+    };
 }
 
 #endif //AUTOMATA_FSM_H
@@ -0,0 +1,224 @@
+#include <algorithm>
+
+#include "fsm_builder.h"
+#include "automation_exception.h"
+
+template <typename T>
+fsm::FSMBuilder<T>::FSMBuilder() : stride_(0), initial_state_(0) {}
+
+template <typename T>
+void fsm::FSMBuilder<T>::reserve(std::size_t states, std::size_t symbols) {
+    states_.reserve(states);
+    state_ids_.reserve(states);
+    final_states_.reserve(states);
+    labels_.reserve(states);
+    alphabet_.reserve(symbols);
+    columns_.reserve(symbols);
+
+    if (symbols > stride_) {
+        // Re-layout the rows with the wider stride.
+        std::vector<uint32_t> table(std::max(states, states_.size()) * symbols, npos);
+        for (std::size_t i = 0; i < states_.size(); i++) {
+            std::copy(table_.begin() + i * stride_, table_.begin() + i * stride_ + alphabet_.size(),
+                table.begin() + i * symbols);
+        }
+        table.resize(states_.size() * symbols);
+        table_.swap(table);
+        stride_ = symbols;
+    }
+    table_.reserve(states * stride_);
+}
+
+template <typename T>
+uint32_t fsm::FSMBuilder<T>::add_state(const fsm::State &state) {
+    uint32_t id = states_.size();
+    if (!state_ids_.emplace(state.get_name(), id).second) {
+        throw AutomationException("Duplicated states", __FILE__, __LINE__);
+    }
+    states_.push_back(state);
+    final_states_.push_back(0);
+    labels_.push_back(fsm::Label{0, 0});
+    table_.resize(table_.size() + stride_, npos);
+    return id;
+}
+
+template <typename T>
+uint32_t fsm::FSMBuilder<T>::add_symbol(T symbol) {
+    auto inserted = columns_.emplace(symbol, alphabet_.size());
+    if (!inserted.second) {
+        return inserted.first->second;
+    }
+    if (alphabet_.size() == stride_) {
+        reserve(states_.size(), std::max<std::size_t>(4, 2 * (std::size_t)stride_));
+    }
+    alphabet_.push_back(symbol);
+    return inserted.first->second;
+}
+
+template <typename T>
+uint32_t fsm::FSMBuilder<T>::get_state_id(const fsm::State &state) const {
+    auto it = state_ids_.find(state.get_name());
+    return it == state_ids_.end() ? npos : it->second;
+}
+
+template <typename T>
+uint32_t fsm::FSMBuilder<T>::get_column(T symbol) const {
+    auto it = columns_.find(symbol);
+    return it == columns_.end() ? npos : it->second;
+}
+
+template <typename T>
+uint32_t fsm::FSMBuilder<T>::get_states_count() const {
+    return states_.size();
+}
+
+template <typename T>
+uint32_t fsm::FSMBuilder<T>::get_alphabet_count() const {
+    return alphabet_.size();
+}
+
+template <typename T>
+void fsm::FSMBuilder<T>::set_initial_state(const fsm::State &state) {
+    initial_state_ = id_of(state);
+}
+
+template <typename T>
+void fsm::FSMBuilder<T>::add_final_state(const fsm::State &state) {
+    uint32_t id = id_of(state);
+    final_states_[id] |= FINAL;
+}
+
+template <typename T>
+void fsm::FSMBuilder<T>::add_final_state(const fsm::State &state, unsigned token, int priority) {
+    uint32_t id = id_of(state);
+    final_states_[id] = FINAL | LABELLED;
+    labels_[id] = fsm::Label{token, priority};
+}
+
+template <typename T>
+void fsm::FSMBuilder<T>::add_transition_rule(const fsm::State &current_state, T symbol, const fsm::State &next_state) {
+    uint32_t state = id_of(current_state), next = id_of(next_state);
+    add_transition_rule(state, add_symbol(symbol), next);
+}
+
+template <typename T>
+void fsm::FSMBuilder<T>::add_transition_rule(uint32_t state, uint32_t column, uint32_t next_state) {
+    if (state >= states_.size() || next_state >= states_.size()) {
+        throw AutomationException("Unknown state", __FILE__, __LINE__);
+    }
+    if (column >= alphabet_.size()) {
+        throw AutomationException("Input is not in alphabet", __FILE__, __LINE__);
+    }
+    table_[(std::size_t)state * stride_ + column] = next_state;
+}
+
+template <typename T>
+uint32_t fsm::FSMBuilder<T>::id_of(const fsm::State &state) const {
+    uint32_t id = get_state_id(state);
+    if (id == npos) {
+        throw AutomationException("Unknown state", __FILE__, __LINE__);
+    }
+    return id;
+}
+
+template <typename T>
+uint32_t fsm::FSMBuilder<T>::validate() const {
+    if (states_.empty()) {
+        throw AutomationException("Machine has no states", __FILE__, __LINE__);
+    }
+
+    // Names, symbols and final states are checked on insertion, only unset cells are left.
+    for (std::size_t i = 0; i < states_.size(); i++) {
+        const uint32_t *row = &table_[i * stride_];
+        if (std::find(row, row + alphabet_.size(), npos) != row + alphabet_.size()) {
+            return states_.size();
+        }
+    }
+    return npos;
+}
+
+template <typename T>
+uint32_t fsm::FSMBuilder<T>::cell(uint32_t state, uint32_t column, uint32_t sink) const {
+    uint32_t target = table_[(std::size_t)state * stride_ + column];
+    return target == npos ? sink : target;
+}
+
+template <typename T>
+fsm::State fsm::FSMBuilder<T>::sink_state() const {
+    fsm::State sink("sink");
+    while (state_ids_.count(sink.get_name()) != 0) {
+        sink = sink + fsm::State("'");
+    }
+    return sink;
+}
+
+template <typename T>
+fsm::CompiledFSM<T> fsm::FSMBuilder<T>::build(fsm::Layout layout) const {
+    uint32_t sink = validate();
+    uint32_t columns = alphabet_.size();
+
+    std::vector<fsm::SparseRow> rows;
+    rows.reserve(states_.size() + 1);
+    std::vector<uint32_t> cells(columns);
+    for (uint32_t i = 0; i < states_.size(); i++) {
+        for (uint32_t j = 0; j < columns; j++) {
+            cells[j] = cell(i, j, sink);
+        }
+        rows.push_back(fsm::make_sparse_row(cells.data(), columns));
+    }
+
+    fsm::CompiledFSM<T> machine;
+    machine.alphabet_ = alphabet_;
+    machine.symbols_ = fsm::SymbolMap<T>(alphabet_);
+    machine.states_ = states_;
+    machine.initial_state_ = initial_state_;
+    machine.flags_.assign(states_.size(), 0);
+    machine.labels_ = labels_;
+    for (uint32_t i = 0; i < states_.size(); i++) {
+        machine.flags_[i] = final_states_[i] != 0 ? fsm::CompiledFSM<T>::FINAL : 0;
+    }
+
+    if (sink != npos) {
+        rows.push_back(fsm::SparseRow{sink, {}});
+        machine.states_.push_back(sink_state());
+        machine.flags_.push_back(0);
+        machine.labels_.push_back(fsm::Label{0, 0});
+    }
+
+    machine.build_table(rows, layout);
+    return machine;
+}
+
+template <typename T>
+fsm::FSM<T> fsm::FSMBuilder<T>::build_fsm() const {
+    uint32_t sink = validate();
+    std::vector<fsm::State> states = states_;
+    if (sink != npos) {
+        states.push_back(sink_state());
+    }
+
+    std::vector<std::vector<fsm::State>> table(states.size(), std::vector<fsm::State>(alphabet_.size()));
+    for (uint32_t i = 0; i < states.size(); i++) {
+        for (uint32_t j = 0; j < alphabet_.size(); j++) {
+            table[i][j] = states[i == sink ? sink : cell(i, j, sink)];
+        }
+    }
+
+    std::vector<fsm::State> final_states;
+    for (uint32_t i = 0; i < states_.size(); i++) {
+        if (final_states_[i] == FINAL) {
+            final_states.push_back(states_[i]);
+        }
+    }
+
+    fsm::FSM<T> machine(states, alphabet_, states_[initial_state_], final_states, table);
+    for (uint32_t i = 0; i < states_.size(); i++) {
+        if ((final_states_[i] & LABELLED) != 0) {
+            machine.add_final_state(states_[i], labels_[i].token, labels_[i].priority);
+        }
+    }
+    return machine;
+}
+
+template class fsm::FSMBuilder<int>;
+template class fsm::FSMBuilder<char>;
@@ -0,0 +1,156 @@
+#ifndef AUTOMATA_FSM_BUILDER_H
+#define AUTOMATA_FSM_BUILDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "compiled_fsm.h"
+#include "fsm.h"
+#include "state.h"
+
+namespace fsm {
+    /**
+     * FSMBuilder constructs large machines rule by rule in linear time.
+     * States and symbols are indexed with hash maps, the transition table grows
+     * geometrically in both directions and validation happens once in build().
+     * Transitions that are never set lead to a non-final sink added by build().
+     */
+    template <typename T>
+    class FSMBuilder {
+    private:
+        std::vector<fsm::State> states_;
+        std::unordered_map<fsm::String, uint32_t> state_ids_;
+        std::vector<T> alphabet_;
+        std::unordered_map<T, uint32_t> columns_;
+        std::vector<uint32_t> table_;
+        uint32_t stride_;
+        uint32_t initial_state_;
+        std::vector<uint8_t> final_states_;
+        std::vector<fsm::Label> labels_;
+
+        static constexpr uint8_t FINAL = 1;
+        static constexpr uint8_t LABELLED = 2;
+    public:
+        /**
+         * Id of the states and columns that are not known to the builder.
+         */
+        static constexpr uint32_t npos = 0xffffffffu;
+
+        /**
+         * Creates an empty builder.
+         */
+        FSMBuilder();
+
+        /**
+         * Pre-allocates room for the given number of states and symbols.
+         * @param size_t states: Expected number of states.
+         * @param size_t symbols: Expected number of symbols.
+         */
+        void reserve(std::size_t states, std::size_t symbols);
+
+        /**
+         * Adds a new state and returns its id. The first state is the initial state by default.
+         * Throws AutomationException if a state with the same name exists.
+         * @param State &state: A new state.
+         */
+        uint32_t add_state(const fsm::State &state);
+
+        /**
+         * Adds a new symbol and returns its column. Adding an existing symbol returns its column.
+         * @param T symbol: A symbol to be added to the alphabet.
+         */
+        uint32_t add_symbol(T symbol);
+
+        /**
+         * Returns the id of a state or npos.
+         */
+        uint32_t get_state_id(const fsm::State &state) const;
+
+        /**
+         * Returns the column of a symbol or npos.
+         */
+        uint32_t get_column(T symbol) const;
+
+        /**
+         * Returns the number of states added so far.
+         */
+        uint32_t get_states_count() const;
+
+        /**
+         * Returns the number of symbols added so far.
+         */
+        uint32_t get_alphabet_count() const;
+
+        /**
+         * Sets the initial state.
+         * @param State &state: One of the added states.
+         */
+        void set_initial_state(const fsm::State &state);
+
+        /**
+         * Marks a state as final.
+         * @param State &state: One of the added states.
+         */
+        void add_final_state(const fsm::State &state);
+
+        /**
+         * Marks a state as final and attaches a token to it.
+         * @param State &state: One of the added states.
+         * @param unsigned token: The token recognised when the machine stops in **state**.
+         * @param int priority: Decides which token wins when machines are combined.
+         */
+        void add_final_state(const fsm::State &state, unsigned token, int priority = 0);
+
+        /**
+         * Sets a transition in O(1). Unknown symbols are added to the alphabet.
+         * @param State &current_state: The state the rule applies to.
+         * @param T symbol: The input symbol.
+         * @param State &next_state: The state the symbol leads to.
+         */
+        void add_transition_rule(const fsm::State &current_state, T symbol, const fsm::State &next_state);
+
+        /**
+         * Sets a transition by ids, skipping the name and symbol lookups.
+         * @param uint32_t state: Id of the state the rule applies to.
+         * @param uint32_t column: Column of the input symbol.
+         * @param uint32_t next_state: Id of the state the symbol leads to.
+         */
+        void add_transition_rule(uint32_t state, uint32_t column, uint32_t next_state);
+
+        /**
+         * Validates the definition and produces the compiled machine.
+         * @param Layout layout: The table layout, Layout::Auto picks one based on density.
+         */
+        fsm::CompiledFSM<T> build(fsm::Layout layout = fsm::Layout::Auto) const;
+
+        /**
+         * Validates the definition and produces a name based FSM.
+         */
+        fsm::FSM<T> build_fsm() const;
+    private:
+
+        /**
+         * Returns the id of a state, throws AutomationException if it is unknown.
+         */
+        uint32_t id_of(const fsm::State &state) const;
+
+        /**
+         * Checks the definition and returns the id of the sink for unset cells, or npos if none is needed.
+         */
+        uint32_t validate() const;
+
+        /**
+         * Returns the target of a cell, with unset cells mapped to **sink**.
+         */
+        uint32_t cell(uint32_t state, uint32_t column, uint32_t sink) const;
+
+        /**
+         * Returns a name for the implicit sink that does not clash with the added states.
+         */
+        fsm::State sink_state() const;
+    };
+}
+
+#endif //AUTOMATA_FSM_BUILDER_H
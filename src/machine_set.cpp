@@ -0,0 +1,177 @@
+#include <algorithm>
+
+#include "machine_set.h"
+#include "automation_exception.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define AUTOMATA_GATHER 1
+#endif
+
+namespace {
+    const std::size_t DECIDED_CHECK_INTERVAL = 16;
+
+    /**
+     * Moves every state of **states** along **column**. States are row offsets into **cells**.
+     */
+    void advance(const uint32_t *cells, uint32_t *states, std::size_t count, uint32_t column) {
+        for (std::size_t k = 0; k < count; k++) {
+            states[k] = cells[states[k] + column];
+        }
+    }
+
+#ifdef AUTOMATA_GATHER
+    /**
+     * advance() eight states at a time, **count** must be a multiple of 8.
+     */
+    __attribute__((target("avx2")))
+    void advance_gather(const uint32_t *cells, uint32_t *states, std::size_t count, uint32_t column) {
+        const __m256i offset = _mm256_set1_epi32(column);
+        for (std::size_t k = 0; k < count; k += 8) {
+            __m256i *lanes = reinterpret_cast<__m256i*>(states + k);
+            __m256i rows = _mm256_loadu_si256(lanes);
+            rows = _mm256_i32gather_epi32(reinterpret_cast<const int*>(cells), _mm256_add_epi32(rows, offset), 4);
+            _mm256_storeu_si256(lanes, rows);
+        }
+    }
+#endif
+}
+
+template <typename T>
+fsm::MachineSet<T>::MachineSet(const std::vector<fsm::CompiledFSM<T>> &machines) {
+    stack(machines);
+}
+
+template <typename T>
+fsm::MachineSet<T>::MachineSet(const std::vector<fsm::FSM<T>> &machines) {
+    std::vector<fsm::CompiledFSM<T>> compiled;
+    compiled.reserve(machines.size());
+    for (const fsm::FSM<T> &machine : machines) {
+        compiled.emplace_back(machine);
+    }
+    stack(compiled);
+}
+
+template <typename T>
+void fsm::MachineSet<T>::stack(const std::vector<fsm::CompiledFSM<T>> &machines) {
+    for (const fsm::CompiledFSM<T> &machine : machines) {
+        for (const T &symbol : machine.get_alphabet()) {
+            if (std::find(alphabet_.begin(), alphabet_.end(), symbol) == alphabet_.end()) {
+                alphabet_.push_back(symbol);
+            }
+        }
+    }
+    symbols_ = fsm::SymbolMap<T>(alphabet_);
+    machines_ = machines.size();
+
+    // The last column is for symbols in no alphabet, row 0 is a dead state shared by all machines.
+    columns_ = alphabet_.size() + 1;
+    uint64_t states = 1;
+    for (const fsm::CompiledFSM<T> &machine : machines) {
+        states += machine.get_states_count();
+    }
+    if (states * columns_ >= (uint64_t(1) << 31)) {
+        throw AutomationException("The machines are too large to be evaluated together", __FILE__, __LINE__);
+    }
+
+    // Cells hold the row offset of the target, so a step is a single add and load.
+    cells_.assign(states * columns_, 0);
+    flags_.assign(states, 0);
+    flags_[0] = DECIDED;
+    initial_states_.assign((machines_ + LANES - 1) / LANES * LANES, 0);
+
+    uint32_t offset = 1;
+    for (uint32_t k = 0; k < machines_; k++) {
+        const fsm::CompiledFSM<T> &machine = machines[k];
+        initial_states_[k] = (offset + machine.get_initial_state()) * columns_;
+        for (uint32_t s = 0; s < machine.get_states_count(); s++) {
+            uint32_t *row = &cells_[(std::size_t)(offset + s) * columns_];
+            uint32_t unknown = machine.is_always_accepting(s) ? offset + s : 0;
+            for (uint32_t j = 0; j < columns_; j++) {
+                uint32_t column = j < alphabet_.size() ? machine.column_of(alphabet_[j]) : fsm::SymbolMap<T>::npos;
+                row[j] = (column == fsm::SymbolMap<T>::npos ? unknown : offset + machine.next(s, column)) * columns_;
+            }
+            flags_[offset + s] = (machine.is_final_state(s) ? FINAL : 0) | (machine.is_decided(s) ? DECIDED : 0);
+        }
+        offset += machine.get_states_count();
+    }
+
+#ifdef AUTOMATA_GATHER
+    gather_ = __builtin_cpu_supports("avx2");
+#else
+    gather_ = false;
+#endif
+}
+
+template <typename T>
+uint32_t fsm::MachineSet<T>::get_machines_count() const {
+    return machines_;
+}
+
+template <typename T>
+bool fsm::MachineSet<T>::uses_gather() const {
+    return gather_;
+}
+
+template <typename T>
+fsm::Bitmap fsm::MachineSet<T>::evaluate(const T *word, std::size_t length) const {
+    fsm::Bitmap accepted;
+    evaluate(word, length, accepted);
+    return accepted;
+}
+
+template <typename T>
+fsm::Bitmap fsm::MachineSet<T>::evaluate(const std::vector<T> &word) const {
+    return evaluate(word.data(), word.size());
+}
+
+template <typename T>
+std::size_t fsm::MachineSet<T>::evaluate(const T *word, std::size_t length, fsm::Bitmap &accepted) const {
+    // The padding lanes stay in the dead row, so gathers never need a scalar tail.
+    thread_local std::vector<uint32_t> states;
+    states.assign(initial_states_.begin(), initial_states_.end());
+
+    std::size_t i = 0;
+    if (!all_decided(states.data())) {
+        while (i < length) {
+            uint32_t column = symbols_.column(word[i++]);
+            if (column == fsm::SymbolMap<T>::npos) {
+                column = columns_ - 1;
+            }
+#ifdef AUTOMATA_GATHER
+            if (gather_) {
+                advance_gather(cells_.data(), states.data(), states.size(), column);
+            } else {
+                advance(cells_.data(), states.data(), machines_, column);
+            }
+#else
+            advance(cells_.data(), states.data(), machines_, column);
+#endif
+            if (i % DECIDED_CHECK_INTERVAL == 0 && all_decided(states.data())) {
+                break;
+            }
+        }
+    }
+
+    accepted.resize(machines_);
+    accepted.clear();
+    for (uint32_t k = 0; k < machines_; k++) {
+        if (flags_[states[k] / columns_] & FINAL) {
+            accepted.set(k);
+        }
+    }
+    return i;
+}
+
+template <typename T>
+bool fsm::MachineSet<T>::all_decided(const uint32_t *states) const {
+    for (uint32_t k = 0; k < machines_; k++) {
+        if ((flags_[states[k] / columns_] & DECIDED) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template class fsm::MachineSet<int>;
+template class fsm::MachineSet<char>;
@@ -0,0 +1,97 @@
+#ifndef AUTOMATA_MACHINE_SET_H
+#define AUTOMATA_MACHINE_SET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bitmap.h"
+#include "compiled_fsm.h"
+#include "fsm.h"
+#include "symbol_map.h"
+
+namespace fsm {
+    /**
+     * MachineSet evaluates many unrelated machines over the same input in a single pass.
+     * The tables of all machines are stacked into one over the union of their alphabets,
+     * so the current states of the machines sit in one array and a symbol advances all of
+     * them with one gather (AVX2 when the CPU has it). A machine rejects a word with a symbol
+     * outside its alphabet, unless it was already in an always accepting state.
+     * Reading stops once every machine is in a dead or always accepting state.
+     */
+    template <typename T>
+    class MachineSet {
+    private:
+        std::vector<T> alphabet_;
+        fsm::SymbolMap<T> symbols_;
+        uint32_t columns_;
+        uint32_t machines_;
+        std::vector<uint32_t> cells_;
+        std::vector<uint32_t> initial_states_;
+        std::vector<uint8_t> flags_;
+        bool gather_;
+
+        static constexpr uint8_t FINAL = 1;
+        static constexpr uint8_t DECIDED = 2;
+        static constexpr std::size_t LANES = 8;
+    public:
+        /**
+         * Stacks compiled machines.
+         * Throws AutomationException if the stacked table has 2^31 cells or more.
+         * @param vector<CompiledFSM<T>> &machines: The machines, a word's result for machine i is bit i.
+         */
+        MachineSet(const std::vector<fsm::CompiledFSM<T>> &machines);
+
+        /**
+         * Compiles and stacks machines.
+         * Throws AutomationException if the stacked table has 2^31 cells or more.
+         * @param vector<FSM<T>> &machines: The machines, a word's result for machine i is bit i.
+         */
+        MachineSet(const std::vector<fsm::FSM<T>> &machines);
+
+        /**
+         * Returns the number of machines.
+         */
+        uint32_t get_machines_count() const;
+
+        /**
+         * Returns true if the states are advanced with SIMD gathers.
+         */
+        bool uses_gather() const;
+
+        /**
+         * Returns the bitmap of the machines that accept the word.
+         * @param T *word: The symbols of the word.
+         * @param size_t length: Number of symbols in the word.
+         */
+        fsm::Bitmap evaluate(const T *word, std::size_t length) const;
+
+        /**
+         * Returns the bitmap of the machines that accept the word.
+         * @param vector<T> &word: The symbols of the word.
+         */
+        fsm::Bitmap evaluate(const std::vector<T> &word) const;
+
+        /**
+         * Evaluates the word into an existing bitmap, so batches do not allocate per word.
+         * Returns the number of symbols read.
+         * @param T *word: The symbols of the word.
+         * @param size_t length: Number of symbols in the word.
+         * @param Bitmap &accepted: Resized to the number of machines, bit i is set if machine i accepts.
+         */
+        std::size_t evaluate(const T *word, std::size_t length, fsm::Bitmap &accepted) const;
+    private:
+
+        /**
+         * Builds the stacked table.
+         */
+        void stack(const std::vector<fsm::CompiledFSM<T>> &machines);
+
+        /**
+         * Returns true if every machine of **states** is in a deciding state.
+         */
+        bool all_decided(const uint32_t *states) const;
+    };
+}
+
+#endif //AUTOMATA_MACHINE_SET_H
@@ -1,186 +1,215 @@
-#include <iostream>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
 
-#include "state.h"
 #include "fsm.h"
-
-void t1(){
-    fsm::State s1("s1"), s2("s2");
-    std::vector<fsm::State> states = {s1, s2};
-    std::vector<int> alphabet = {0, 1};
-    fsm::State &final_state = s2;
-    std::vector<fsm::State> final_states = {final_state};
-    fsm::State &initial_state = s1;
-    std::vector<std::vector<fsm::State>> transition_table = {
-            {states[0], states[1]},
-            {states[1], states[1]},
-    };
-    fsm::FSM<int> machine(states, alphabet, initial_state, final_states, transition_table);
-    std::cout << "is in final state: " << machine.is_in_final_state() << std::endl;
-    machine.transition(0);
-    std::cout << "is in final state: " << machine.is_in_final_state() << std::endl;
-    machine.transition(1);
-    std::cout << "is in final state: " << machine.is_in_final_state() << std::endl;
-    std::cout << "Current state: " << machine.get_current_state() << std::endl;
-    std::cout << "Restarting" << std::endl;
-    machine.restart();
-    std::cout << "Current state: " << machine.get_current_state() << std::endl;
-
-    fsm::State s3("s3");
-    machine.add_state(s3);
-    machine.add_transition_rule(s3, alphabet[0], s1);
-    machine.add_transition_rule(s3, alphabet[1], s2);
-
-    machine.set_initial_state(s3);
-    machine.transition(1);
-    std::cout << "Current state: " << machine.get_current_state() << std::endl;
-    std::cout << "is in final state: " << machine.is_in_final_state() << std::endl;
-}
-
-void t2(){
-    fsm::State s1("s1"), s2("s2"), s3("s3"), s4("s4"), s5("s5");
-    std::vector<fsm::State> states1 = {s1, s2, s3};
-    std::vector<fsm::State> states2 = {s4, s5};
-
-    std::vector<int> alphabet = {0, 1};
-
-    fsm::State &initial_state1 = s1, &initial_state2 = s4;
-    fsm::State &final_state1 = s3, &final_state2 = s5;
-
-    std::vector<fsm::State> final_states1 = {final_state1};
-    std::vector<fsm::State> final_states2 = {final_state2};
-
-    std::vector<std::vector<fsm::State>> transition_table1 = {
-            {states1[2], states1[1]},
-            {states1[2], states1[0]},
-            {states1[1], states1[2]},
-    };
-    std::vector<std::vector<fsm::State>> transition_table2 = {
-            {states2[0], states2[1]},
-            {states2[1], states2[0]}
-    };
-
-    fsm::FSM<int> machine1(states1, alphabet, initial_state1, final_states1, transition_table1);
-    fsm::FSM<int> machine2(states2, alphabet, initial_state2, final_states2, transition_table2);
-
-    std::cout << (machine1 & machine2) << std::endl;
-}
-
-void t3() {
-    fsm::State s1("s1"), s2("s2"), s3("s3"), s4("s4");
-    std::vector<fsm::State> states1 = {s1, s2};
-    std::vector<fsm::State> states2 = {s3, s4};
-
-    std::vector<int> alphabet = {0, 1, 2};
-
-    fsm::State &initial_state1 = s1, &initial_state2 = s3;
-    fsm::State &final_state1 = s2, &final_state2 = s4;
-
-    std::vector<fsm::State> final_states1 = {final_state1};
-    std::vector<fsm::State> final_states2 = {final_state2};
-
-    std::vector<std::vector<fsm::State>> transition_table1 = {
-            {states1[0], states1[1], states1[1]},
-            {states1[0], states1[0], states1[1]}
-    };
-    std::vector<std::vector<fsm::State>> transition_table2 = {
-            {states2[0], states2[0], states2[1]},
-            {states2[0], states2[1], states2[0]}
-    };
-
-    fsm::FSM<int> machine1(states1, alphabet, initial_state1, final_states1, transition_table1);
-    fsm::FSM<int> machine2(states2, alphabet, initial_state2, final_states2, transition_table2);
-
-    std::cout << (machine1 & machine2) << std::endl;
+#include "compiled_fsm.h"
+#include "record_matcher.h"
+#include "automation_exception.h"
+#include "demo.h"
+
+namespace {
+    const char *USAGE =
+        "usage: automata <command> [options]\n"
+        "\n"
+        "commands:\n"
+        "  match [options] MACHINE [FILE...]  print the records of the files (or stdin) the machine accepts\n"
+        "  compile MACHINE OUTPUT             write a machine as a binary machine file\n"
+        "  info MACHINE                       print the size of a machine\n"
+        "  demo                               run the examples\n"
+        "\n"
+        "MACHINE is a binary machine file or a text machine (see m1.txt) over single byte symbols.\n"
+        "\n"
+        "match options:\n"
+        "  -z               records end with a NUL byte instead of a newline\n"
+        "  -v               select the records that are not accepted\n"
+        "  -c               print the number of selected records instead of the records\n"
+        "  -b               print the byte offset of every selected record before it\n"
+        "  -k, --ordered    keep the input order (blocks are otherwise written as they finish)\n"
+        "  -j N             number of matching threads, all cores by default\n"
+        "  --block-size N   bytes read at once, 4 MiB by default\n"
+        "  --stats          report the throughput on stderr\n";
+
+    int usage_error(const char *message) {
+        std::fprintf(stderr, "automata: %s\n%s", message, USAGE);
+        return 2;
+    }
+
+    /**
+     * Loads a binary machine file, or a text machine when the file does not start with the magic.
+     */
+    fsm::CompiledFSM<char> load_machine(const char *path) {
+        char magic[4] = {0, 0, 0, 0};
+        std::ifstream probe(path, std::ios::binary);
+        if (!probe) {
+            throw fsm::AutomationException("Cannot open the machine", __FILE__, __LINE__);
+        }
+        probe.read(magic, sizeof(magic));
+        probe.close();
+        if (std::memcmp(magic, "FSMC", sizeof(magic)) == 0) {
+            return fsm::CompiledFSM<char>::load(path);
+        }
+
+        std::ifstream in(path);
+        fsm::FSM<char> machine;
+        in >> machine;
+        if (in.fail()) {
+            throw fsm::AutomationException("Cannot parse the text machine", __FILE__, __LINE__);
+        }
+        return fsm::CompiledFSM<char>(machine);
+    }
+
+    int match(int argc, char **argv) {
+        fsm::MatchOptions options;
+        bool count = false, stats = false;
+        int i = 0;
+        for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+            const char *option = argv[i];
+            if (std::strcmp(option, "--") == 0) {
+                i++;
+                break;
+            } else if (std::strcmp(option, "-z") == 0) {
+                options.separator = '\0';
+            } else if (std::strcmp(option, "-v") == 0) {
+                options.invert = true;
+            } else if (std::strcmp(option, "-c") == 0) {
+                count = true;
+            } else if (std::strcmp(option, "-b") == 0) {
+                options.output = fsm::MatchOutput::Offsets;
+            } else if (std::strcmp(option, "-k") == 0 || std::strcmp(option, "--ordered") == 0) {
+                options.ordered = true;
+            } else if (std::strcmp(option, "--stats") == 0) {
+                stats = true;
+            } else if ((std::strcmp(option, "-j") == 0 || std::strcmp(option, "--block-size") == 0) && i + 1 < argc) {
+                char *end;
+                unsigned long long value = std::strtoull(argv[++i], &end, 10);
+                if (*end != '\0' || value == 0) {
+                    return usage_error("expected a positive number");
+                }
+                if (option[1] == 'j') {
+                    options.threads = value;
+                } else {
+                    options.block_size = value;
+                }
+            } else {
+                return usage_error("unknown option");
+            }
+        }
+        if (i == argc) {
+            return usage_error("missing machine");
+        }
+        if (count) {
+            options.output = fsm::MatchOutput::Count;
+        }
+
+        fsm::CompiledFSM<char> machine = load_machine(argv[i++]);
+        std::vector<const char*> files(argv + i, argv + argc);
+        if (files.empty()) {
+            files.push_back("-");
+        }
+
+        // Like grep, the file name prefixes the output when there are several files.
+        bool selected = false, failed = false;
+        fsm::MatchStats total{0, 0, 0, 0};
+        for (const char *file : files) {
+            bool is_stdin = std::strcmp(file, "-") == 0;
+            int fd = is_stdin ? STDIN_FILENO : open(file, O_RDONLY);
+            if (fd < 0) {
+                std::fprintf(stderr, "automata: %s: %s\n", file, std::strerror(errno));
+                failed = true;
+                continue;
+            }
+
+            std::vector<char> prefix;
+            if (files.size() > 1) {
+                prefix.assign(file, file + std::strlen(file));
+                prefix.push_back(':');
+            }
+            prefix.push_back('\0');
+            options.prefix = prefix.data();
+
+            fsm::MatchStats result;
+            try {
+                result = fsm::RecordMatcher(machine, options).run(fd, STDOUT_FILENO);
+            } catch (const fsm::AutomationException &exception) {
+                std::cerr << "automata: " << file << ": " << exception.get_msg() << std::endl;
+                failed = true;
+                result = fsm::MatchStats{0, 0, 0, 0};
+            }
+            if (!is_stdin) {
+                close(fd);
+            }
+
+            if (count) {
+                std::printf("%s%llu\n", prefix.data(), (unsigned long long)result.selected);
+                std::fflush(stdout);
+            }
+            selected = selected || result.selected > 0;
+            total.bytes += result.bytes;
+            total.records += result.records;
+            total.selected += result.selected;
+            total.seconds += result.seconds;
+        }
+
+        if (stats) {
+            std::fprintf(stderr, "%llu bytes, %llu records, %llu selected in %.3f s, %.1f MB/s\n",
+                (unsigned long long)total.bytes, (unsigned long long)total.records,
+                (unsigned long long)total.selected, total.seconds,
+                total.seconds > 0 ? total.bytes / total.seconds / 1e6 : 0.0);
+        }
+        return failed ? 2 : (selected ? 0 : 1);
+    }
+
+    int compile(int argc, char **argv) {
+        if (argc != 2) {
+            return usage_error("compile needs a machine and an output file");
+        }
+        load_machine(argv[0]).save(argv[1]);
+        return 0;
+    }
+
+    int info(int argc, char **argv) {
+        if (argc != 1) {
+            return usage_error("info needs a machine");
+        }
+        fsm::CompiledFSM<char> machine = load_machine(argv[0]);
+        std::printf("%u states, %u symbols, %s table with %u byte ids, %zu bytes\n",
+            machine.get_states_count(), machine.get_alphabet_count(),
+            machine.get_layout() == fsm::Layout::Comb ? "comb" : "dense",
+            machine.get_state_id_size(), machine.memory_usage());
+        return 0;
+    }
 }
 
-void t4(){
-    fsm::State s1("s1"), s2("s2"), s3("s3"), s4("s4"), s5("s5"), s6("s6");
-    std::vector<fsm::State> states1 = {s1, s2, s3};
-    std::vector<fsm::State> states2 = {s4, s5, s6};
-
-    std::vector<int> alphabet = {0, 7};
-
-    fsm::State &initial_state1 = s1, &initial_state2 = s4;
-    fsm::State &final_state1 = s3, &final_state2 = s6;
-
-    std::vector<fsm::State> final_states1 = {final_state1};
-    std::vector<fsm::State> final_states2 = {final_state2};
-
-    std::vector<std::vector<fsm::State>> transition_table1 = {
-            {states1[1], states1[0]},
-            {states1[2], states1[0]},
-            {states1[2], states1[2]}
-    };
-    std::vector<std::vector<fsm::State>> transition_table2 = {
-            {states2[0], states2[1]},
-            {states2[0], states2[2]},
-            {states2[2], states2[2]}
-    };
-
-    fsm::FSM<int> machine1(states1, alphabet, initial_state1, final_states1, transition_table1);
-    fsm::FSM<int> machine2(states2, alphabet, initial_state2, final_states2, transition_table2);
-
-    std::cout << machine1.evaluate("07007") << std::endl;  // Recognises words containing "00".
-    std::cout << machine2.evaluate("07707") << std::endl;  // Recognises words containing "77".
-    std::cout << !machine2.evaluate("77007") << std::endl;  // Recognises words NOT containing "77".
-
-    // Recognises words containing "00" OR "77".
-    std::cout << (machine1 | machine2).evaluate("07070") << std::endl;
-    std::cout << (machine1 | machine2).evaluate("77070") << std::endl;
-
-    // Recognises words containing "00" AND NOT "77".
-    std::cout << (machine1 & !machine2).evaluate("700770") << std::endl;
-    std::cout << (machine1 & !machine2).evaluate("070070") << std::endl;
-}
-
-void t5() {
-
-    fsm::FSM<int> m1, m2;
-
-    std::cin >> m1 >> m2;
-
-    std::cout << m1 << std::endl;
-    std::cout << m2 << std::endl;
-
-    std::cout << (m1 | m2);
-}
-
-void t6() {
-    fsm::FSM<int> m1, m2;
-
-    std::ifstream f1("m1.txt");
-    std::ifstream f2("m2.txt");
-
-    f1 >> m1;
-    f2 >> m2;
-
-    std::cout << m1 << std::endl;
-    std::cout << m2 << std::endl;
-
-    std::cout << (m1 | m2);
-}
-
-void t7() {
-    fsm::FSM<int> m1("m1.txt"), m2;
-
-    m1.toTXT("m1Test.txt");
-    m2.fromTXT("m1Test.txt");
-
-    //these should be the same.
-    std::cout << m1 << std::endl;
-    std::cout << m2 << std::endl;
-}
-
-int main() {
-
-    t1();
-    t2();
-    t3();
-    t4();
-    //t5();
-    t6();
-    t7();
-
-    return 0;
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        return usage_error("missing command");
+    }
+
+    const char *command = argv[1];
+    try {
+        if (std::strcmp(command, "match") == 0) {
+            return match(argc - 2, argv + 2);
+        } else if (std::strcmp(command, "compile") == 0) {
+            return compile(argc - 2, argv + 2);
+        } else if (std::strcmp(command, "info") == 0) {
+            return info(argc - 2, argv + 2);
+        } else if (std::strcmp(command, "demo") == 0) {
+            run_demos();
+            return 0;
+        } else if (std::strcmp(command, "help") == 0 || std::strcmp(command, "--help") == 0) {
+            std::printf("%s", USAGE);
+            return 0;
+        }
+    } catch (const fsm::AutomationException &exception) {
+        std::cerr << "automata: " << exception.get_msg() << std::endl;
+        return 2;
+    }
+    return usage_error("unknown command");
 }
@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "matcher.h"
+#include "automation_exception.h"
+
+namespace {
+    /**
+     * Hashes a set of positions stored as words.
+     */
+    struct SetHash {
+        std::size_t operator()(const std::vector<uint64_t> &set) const {
+            uint64_t h = 0x243f6a8885a308d3ull;
+            for (uint64_t word : set) {
+                h = (h ^ word) * 0x9e3779b97f4a7c15ull;
+                h ^= h >> 32;
+            }
+            return h;
+        }
+    };
+}
+
+template <typename T>
+fsm::Matcher<T>::Matcher(const fsm::Pattern<T> &pattern, uint32_t max_states)
+    : deterministic_(false)
+{
+    fsm::PositionAutomaton<T> automaton = pattern.positions();
+    deterministic_ = determinize(automaton, false, max_states, anchored_)
+        && determinize(automaton, true, max_states, unanchored_);
+    if (!deterministic_) {
+        // Too many states, the BitNFA is used.
+        anchored_ = fsm::CompiledFSM<T>();
+        unanchored_ = fsm::CompiledFSM<T>();
+        nfa_ = std::make_shared<const fsm::BitNFA<T>>(pattern);
+    }
+}
+
+template <typename T>
+bool fsm::Matcher<T>::determinize(const fsm::PositionAutomaton<T> &automaton, bool unanchored, uint32_t max_states,
+                                  fsm::CompiledFSM<T> &machine) {
+    uint32_t positions = automaton.symbols.size() - 1;
+    std::size_t words = positions / 64 + 1;
+    std::vector<T> alphabet;
+    for (uint32_t p = 1; p <= positions; p++) {
+        if (std::find(alphabet.begin(), alphabet.end(), automaton.symbols[p]) == alphabet.end()) {
+            alphabet.push_back(automaton.symbols[p]);
+        }
+    }
+    fsm::SymbolMap<T> symbols(alphabet);
+    uint32_t columns = alphabet.size();
+
+    // Sets of positions are bitsets, with one mask per symbol of the positions it enters.
+    std::vector<uint64_t> masks(columns * words, 0), follow((positions + 1) * words, 0), last(words, 0);
+    for (uint32_t p = 0; p <= positions; p++) {
+        if (p > 0) {
+            masks[symbols.column(automaton.symbols[p]) * words + p / 64] |= 1ull << (p % 64);
+        }
+        if (automaton.last[p]) {
+            last[p / 64] |= 1ull << (p % 64);
+        }
+        for (uint32_t q : automaton.follow[p]) {
+            follow[p * words + q / 64] |= 1ull << (q % 64);
+        }
+    }
+
+    std::vector<std::vector<uint64_t>> sets{std::vector<uint64_t>(words, 0)};
+    sets[0][0] = 1;
+    std::unordered_map<std::vector<uint64_t>, uint32_t, SetHash> ids{{sets[0], 0}};
+    std::vector<fsm::SparseRow> rows;
+    std::vector<uint32_t> final_states, cells(columns);
+    std::vector<uint64_t> reached(words), next(words);
+
+    for (uint32_t id = 0; id < sets.size(); id++) {
+        bool accepting = false;
+        std::fill(reached.begin(), reached.end(), 0);
+        for (std::size_t w = 0; w < words; w++) {
+            accepting |= (sets[id][w] & last[w]) != 0;
+            for (uint64_t bits = sets[id][w]; bits != 0; bits &= bits - 1) {
+                const uint64_t *targets = &follow[(w * 64 + __builtin_ctzll(bits)) * words];
+                for (std::size_t v = 0; v < words; v++) {
+                    reached[v] |= targets[v];
+                }
+            }
+        }
+
+        for (uint32_t j = 0; j < columns; j++) {
+            for (std::size_t w = 0; w < words; w++) {
+                next[w] = reached[w] & masks[j * words + w];
+            }
+            if (unanchored) {
+                next[0] |= 1;
+            }
+            auto found = ids.emplace(next, sets.size());
+            if (found.second) {
+                if (sets.size() == max_states) {
+                    return false;
+                }
+                sets.push_back(next);
+            }
+            cells[j] = found.first->second;
+        }
+        rows.push_back(fsm::make_sparse_row(cells.data(), columns));
+        if (accepting) {
+            final_states.push_back(id);
+        }
+    }
+    machine = fsm::CompiledFSM<T>(alphabet, rows, 0, final_states);
+    return true;
+}
+
+template <typename T>
+bool fsm::Matcher<T>::is_deterministic() const {
+    return deterministic_;
+}
+
+template <typename T>
+bool fsm::Matcher<T>::evaluate(const T *word, std::size_t length) const {
+    if (!deterministic_) {
+        return nfa_->evaluate(word, length);
+    }
+
+    // Symbols that do not occur in the pattern reject the word, like in the BitNFA.
+    uint32_t state = anchored_.get_initial_state();
+    for (std::size_t i = 0; i < length; i++) {
+        uint32_t column = anchored_.column_of(word[i]);
+        if (column == fsm::SymbolMap<T>::npos) {
+            return false;
+        }
+        state = anchored_.next(state, column);
+    }
+    return anchored_.is_final_state(state);
+}
+
+template <typename T>
+bool fsm::Matcher<T>::evaluate(const std::vector<T> &word) const {
+    return evaluate(word.data(), word.size());
+}
+
+template <typename T>
+bool fsm::Matcher<T>::search(const T *text, std::size_t length, std::size_t &end) const {
+    if (!deterministic_) {
+        return nfa_->search(text, length, end);
+    }
+
+    // An unknown symbol ends every partial match, leaving only the start active.
+    uint32_t state = unanchored_.get_initial_state();
+    for (end = 0; !unanchored_.is_final_state(state); end++) {
+        if (end == length) {
+            return false;
+        }
+        uint32_t column = unanchored_.column_of(text[end]);
+        state = column == fsm::SymbolMap<T>::npos ? unanchored_.get_initial_state() : unanchored_.next(state, column);
+    }
+    return true;
+}
+
+template class fsm::Matcher<int>;
+template class fsm::Matcher<char>;
@@ -0,0 +1,76 @@
+#ifndef AUTOMATA_MATCHER_H
+#define AUTOMATA_MATCHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "bit_nfa.h"
+#include "compiled_fsm.h"
+#include "pattern.h"
+
+namespace fsm {
+    /**
+     * Matcher evaluates and searches a pattern with the faster of two engines.
+     * A deterministic machine costs one table lookup per symbol but can need exponentially
+     * many states, the BitNFA has a small fixed size but does more work per symbol.
+     * The estimate of the deterministic size is the subset construction itself, stopped as
+     * soon as it needs more than **max_states** states, so the choice is cheap either way.
+     * The construction works on the positions directly, so patterns too long for a BitNFA
+     * are still matched when their deterministic machine is small.
+     */
+    template <typename T>
+    class Matcher {
+    private:
+        std::shared_ptr<const fsm::BitNFA<T>> nfa_;
+        bool deterministic_;
+        fsm::CompiledFSM<T> anchored_;
+        fsm::CompiledFSM<T> unanchored_;
+    public:
+        /**
+         * Builds the engines for a pattern.
+         * Throws AutomationException if the deterministic machine needs more than **max_states** states
+         * and the pattern has more than BitNFA<T>::MAX_POSITIONS positions.
+         * @param Pattern<T> &pattern: The pattern to match.
+         * @param uint32_t max_states: The largest deterministic machine worth building.
+         */
+        Matcher(const fsm::Pattern<T> &pattern, uint32_t max_states = 4096);
+
+        /**
+         * Returns true if deterministic machines were built, false if the BitNFA is used.
+         */
+        bool is_deterministic() const;
+
+        /**
+         * Returns true if the whole word matches the pattern.
+         * @param T *word: The symbols of the word.
+         * @param size_t length: Number of symbols in the word.
+         */
+        bool evaluate(const T *word, std::size_t length) const;
+
+        /**
+         * Returns true if the whole word matches the pattern.
+         * @param vector<T> &word: The symbols of the word.
+         */
+        bool evaluate(const std::vector<T> &word) const;
+
+        /**
+         * Looks for the first place in the text where a match of the pattern ends, see BitNFA<T>::search.
+         * @param T *text: The symbols to search.
+         * @param size_t length: Number of symbols in the text.
+         * @param size_t &end: Set to the number of symbols read up to the end of the first match.
+         */
+        bool search(const T *text, std::size_t length, std::size_t &end) const;
+    private:
+
+        /**
+         * Builds the deterministic machine of the positions with the subset construction, see
+         * BitNFA<T>::determinize. Returns false, leaving **machine** unchanged, if more than
+         * **max_states** states are needed.
+         */
+        static bool determinize(const fsm::PositionAutomaton<T> &automaton, bool unanchored, uint32_t max_states,
+            fsm::CompiledFSM<T> &machine);
+    };
+}
+
+#endif //AUTOMATA_MATCHER_H
@@ -0,0 +1,102 @@
+#include <algorithm>
+
+#include "op_cache.h"
+
+template <typename T>
+bool fsm::OpCache<T>::Key::operator==(const Key &other) const {
+    return operation == other.operation && lhs == other.lhs && rhs == other.rhs;
+}
+
+template <typename T>
+std::size_t fsm::OpCache<T>::KeyHash::operator()(const Key &key) const {
+    uint64_t h = std::hash<fsm::Hash128>()(key.lhs) * 0x9e3779b97f4a7c15ull ^ std::hash<fsm::Hash128>()(key.rhs);
+    return h * 31 + (uint64_t)key.operation;
+}
+
+template <typename T>
+fsm::OpCache<T>::OpCache(std::size_t capacity)
+    : capacity_(std::max<std::size_t>(capacity, 1)),
+    stats_{0, 0, 0}
+{
+    index_.reserve(capacity_);
+}
+
+template <typename T>
+fsm::FSM<T> fsm::OpCache<T>::union_of(const fsm::FSM<T> &lhs, const fsm::FSM<T> &rhs) {
+    Key key{fsm::Operation::Union, lhs.canonical_hash(), rhs.canonical_hash()};
+    if (const fsm::FSM<T> *cached = find(key)) {
+        return *cached;
+    }
+    fsm::FSM<T> result = lhs | rhs;
+    insert(key, result);
+    return result;
+}
+
+template <typename T>
+fsm::FSM<T> fsm::OpCache<T>::intersection_of(const fsm::FSM<T> &lhs, const fsm::FSM<T> &rhs) {
+    Key key{fsm::Operation::Intersection, lhs.canonical_hash(), rhs.canonical_hash()};
+    if (const fsm::FSM<T> *cached = find(key)) {
+        return *cached;
+    }
+    fsm::FSM<T> result = lhs & rhs;
+    insert(key, result);
+    return result;
+}
+
+template <typename T>
+fsm::FSM<T> fsm::OpCache<T>::complement_of(const fsm::FSM<T> &machine) {
+    Key key{fsm::Operation::Complement, machine.canonical_hash(), fsm::Hash128{0, 0}};
+    if (const fsm::FSM<T> *cached = find(key)) {
+        return *cached;
+    }
+    fsm::FSM<T> result = !machine;
+    insert(key, result);
+    return result;
+}
+
+template <typename T>
+const fsm::CacheStats &fsm::OpCache<T>::get_stats() const {
+    return stats_;
+}
+
+template <typename T>
+std::size_t fsm::OpCache<T>::get_size() const {
+    return entries_.size();
+}
+
+template <typename T>
+std::size_t fsm::OpCache<T>::get_capacity() const {
+    return capacity_;
+}
+
+template <typename T>
+void fsm::OpCache<T>::clear() {
+    entries_.clear();
+    index_.clear();
+}
+
+template <typename T>
+const fsm::FSM<T> *fsm::OpCache<T>::find(const Key &key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        stats_.misses++;
+        return nullptr;
+    }
+    stats_.hits++;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return &it->second->second;
+}
+
+template <typename T>
+void fsm::OpCache<T>::insert(const Key &key, const fsm::FSM<T> &result) {
+    if (entries_.size() == capacity_) {
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+        stats_.evictions++;
+    }
+    entries_.emplace_front(key, result);
+    index_[key] = entries_.begin();
+}
+
+template class fsm::OpCache<int>;
+template class fsm::OpCache<char>;
@@ -0,0 +1,114 @@
+#ifndef AUTOMATA_OP_CACHE_H
+#define AUTOMATA_OP_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+#include "fsm.h"
+
+namespace fsm {
+    /**
+     * The set operations whose results OpCache remembers.
+     */
+    enum class Operation {
+        Union,
+        Intersection,
+        Complement
+    };
+
+    /**
+     * Counters of an OpCache.
+     */
+    struct CacheStats {
+        std::size_t hits;
+        std::size_t misses;
+        std::size_t evictions;
+    };
+
+    /**
+     * OpCache remembers the results of set operations keyed by the operation and the
+     * canonical hashes of the operands, so repeating a combination of the same machines,
+     * or of any machines equivalent to them, returns the stored result instead of
+     * rebuilding it. The least recently used result is evicted when the cache is full.
+     * A result keeps the state names of the operands it was first built from.
+     */
+    template <typename T>
+    class OpCache {
+    private:
+        struct Key {
+            fsm::Operation operation;
+            fsm::Hash128 lhs;
+            fsm::Hash128 rhs;
+
+            bool operator==(const Key &other) const;
+        };
+
+        struct KeyHash {
+            std::size_t operator()(const Key &key) const;
+        };
+
+        typedef std::list<std::pair<Key, fsm::FSM<T>>> Entries;
+
+        std::size_t capacity_;
+        Entries entries_;
+        std::unordered_map<Key, typename Entries::iterator, KeyHash> index_;
+        fsm::CacheStats stats_;
+    public:
+        /**
+         * Creates an empty cache.
+         * @param size_t capacity: The number of results kept, at least one.
+         */
+        OpCache(std::size_t capacity = 256);
+
+        /**
+         * Returns **lhs** | **rhs**, built only if the combination is not cached.
+         */
+        fsm::FSM<T> union_of(const fsm::FSM<T> &lhs, const fsm::FSM<T> &rhs);
+
+        /**
+         * Returns **lhs** & **rhs**, built only if the combination is not cached.
+         */
+        fsm::FSM<T> intersection_of(const fsm::FSM<T> &lhs, const fsm::FSM<T> &rhs);
+
+        /**
+         * Returns !**machine**, built only if it is not cached.
+         */
+        fsm::FSM<T> complement_of(const fsm::FSM<T> &machine);
+
+        /**
+         * Returns the hit, miss and eviction counters.
+         */
+        const fsm::CacheStats &get_stats() const;
+
+        /**
+         * Returns the number of cached results.
+         */
+        std::size_t get_size() const;
+
+        /**
+         * Returns the maximal number of cached results.
+         */
+        std::size_t get_capacity() const;
+
+        /**
+         * Drops all results, the counters are kept.
+         */
+        void clear();
+    private:
+
+        /**
+         * Returns the cached result for the key or nullptr, marking it as most recently used.
+         */
+        const fsm::FSM<T> *find(const Key &key);
+
+        /**
+         * Stores a result as the most recently used one, evicting the least recently used if needed.
+         */
+        void insert(const Key &key, const fsm::FSM<T> &result);
+    };
+}
+
+#endif //AUTOMATA_OP_CACHE_H
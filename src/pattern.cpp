@@ -0,0 +1,140 @@
+#include <utility>
+
+#include "pattern.h"
+#include "automation_exception.h"
+
+template <typename T>
+fsm::Pattern<T>::Pattern(std::shared_ptr<const Node> root, std::size_t positions)
+    : root_(std::move(root)),
+    positions_(positions)
+{
+
+}
+
+template <typename T>
+fsm::Pattern<T>::Pattern()
+    : root_(std::make_shared<const Node>(Node{Kind::Empty, T(), nullptr, nullptr})),
+    positions_(0)
+{
+
+}
+
+template <typename T>
+fsm::Pattern<T> fsm::Pattern<T>::symbol(T symbol) {
+    return fsm::Pattern<T>(std::make_shared<const Node>(Node{Kind::Symbol, symbol, nullptr, nullptr}), 1);
+}
+
+template <typename T>
+fsm::Pattern<T> fsm::Pattern<T>::any_of(const std::vector<T> &symbols) {
+    if (symbols.empty()) {
+        throw AutomationException("A pattern needs at least one symbol", __FILE__, __LINE__);
+    }
+    fsm::Pattern<T> pattern = symbol(symbols[0]);
+    for (std::size_t i = 1; i < symbols.size(); i++) {
+        pattern = pattern | symbol(symbols[i]);
+    }
+    return pattern;
+}
+
+template <typename T>
+fsm::Pattern<T> fsm::Pattern<T>::word(const std::vector<T> &word) {
+    fsm::Pattern<T> pattern;
+    for (const T &s : word) {
+        pattern = pattern + symbol(s);
+    }
+    return pattern;
+}
+
+template <typename T>
+fsm::Pattern<T> fsm::Pattern<T>::operator+(const fsm::Pattern<T> &rhs) const {
+    return fsm::Pattern<T>(std::make_shared<const Node>(Node{Kind::Concatenation, T(), root_, rhs.root_}),
+        positions_ + rhs.positions_);
+}
+
+template <typename T>
+fsm::Pattern<T> fsm::Pattern<T>::operator|(const fsm::Pattern<T> &rhs) const {
+    return fsm::Pattern<T>(std::make_shared<const Node>(Node{Kind::Alternation, T(), root_, rhs.root_}),
+        positions_ + rhs.positions_);
+}
+
+template <typename T>
+fsm::Pattern<T> fsm::Pattern<T>::star() const {
+    return fsm::Pattern<T>(std::make_shared<const Node>(Node{Kind::Star, T(), root_, nullptr}), positions_);
+}
+
+template <typename T>
+fsm::Pattern<T> fsm::Pattern<T>::plus() const {
+    return *this + star();
+}
+
+template <typename T>
+fsm::Pattern<T> fsm::Pattern<T>::optional() const {
+    return *this | fsm::Pattern<T>();
+}
+
+template <typename T>
+std::size_t fsm::Pattern<T>::get_positions_count() const {
+    return positions_;
+}
+
+template <typename T>
+fsm::PositionAutomaton<T> fsm::Pattern<T>::positions() const {
+    fsm::PositionAutomaton<T> automaton;
+    automaton.symbols.push_back(T());
+    automaton.follow.emplace_back();
+
+    Sets sets = visit(*root_, automaton);
+    automaton.follow[0] = sets.first;
+    automaton.last.assign(automaton.symbols.size(), 0);
+    automaton.last[0] = sets.nullable;
+    for (uint32_t p : sets.last) {
+        automaton.last[p] = 1;
+    }
+    return automaton;
+}
+
+template <typename T>
+typename fsm::Pattern<T>::Sets fsm::Pattern<T>::visit(const Node &node, fsm::PositionAutomaton<T> &automaton) {
+    switch (node.kind) {
+        case Kind::Symbol: {
+            uint32_t position = automaton.symbols.size();
+            automaton.symbols.push_back(node.symbol);
+            automaton.follow.emplace_back();
+            return Sets{false, {position}, {position}};
+        }
+        case Kind::Concatenation: {
+            Sets a = visit(*node.left, automaton), b = visit(*node.right, automaton);
+            for (uint32_t p : a.last) {
+                automaton.follow[p].insert(automaton.follow[p].end(), b.first.begin(), b.first.end());
+            }
+            Sets sets{a.nullable && b.nullable, a.first, b.last};
+            if (a.nullable) {
+                sets.first.insert(sets.first.end(), b.first.begin(), b.first.end());
+            }
+            if (b.nullable) {
+                sets.last.insert(sets.last.end(), a.last.begin(), a.last.end());
+            }
+            return sets;
+        }
+        case Kind::Alternation: {
+            Sets a = visit(*node.left, automaton), b = visit(*node.right, automaton);
+            a.nullable = a.nullable || b.nullable;
+            a.first.insert(a.first.end(), b.first.begin(), b.first.end());
+            a.last.insert(a.last.end(), b.last.begin(), b.last.end());
+            return a;
+        }
+        case Kind::Star: {
+            Sets a = visit(*node.left, automaton);
+            for (uint32_t p : a.last) {
+                automaton.follow[p].insert(automaton.follow[p].end(), a.first.begin(), a.first.end());
+            }
+            a.nullable = true;
+            return a;
+        }
+        default:
+            return Sets{true, {}, {}};
+    }
+}
+
+template class fsm::Pattern<int>;
+template class fsm::Pattern<char>;
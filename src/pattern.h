@@ -0,0 +1,123 @@
+#ifndef AUTOMATA_PATTERN_H
+#define AUTOMATA_PATTERN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace fsm {
+    /**
+     * The position (Glushkov) automaton of a pattern. Position 0 is the start, every other
+     * position is an occurrence of a symbol in the pattern and is entered only by that symbol.
+     */
+    template <typename T>
+    struct PositionAutomaton {
+        std::vector<T> symbols;
+        std::vector<std::vector<uint32_t>> follow;
+        std::vector<uint8_t> last;
+    };
+
+    /**
+     * Pattern is a regular expression over symbols of type T, built from symbols with
+     * concatenation (+), alternation (|) and repetition. Patterns are immutable and share
+     * their subexpressions, so combining them is O(1).
+     */
+    template <typename T>
+    class Pattern {
+    private:
+        enum class Kind {
+            Empty,
+            Symbol,
+            Concatenation,
+            Alternation,
+            Star
+        };
+
+        struct Node {
+            Kind kind;
+            T symbol;
+            std::shared_ptr<const Node> left;
+            std::shared_ptr<const Node> right;
+        };
+
+        /**
+         * The nullability and the first and last positions of a subexpression.
+         */
+        struct Sets {
+            bool nullable;
+            std::vector<uint32_t> first;
+            std::vector<uint32_t> last;
+        };
+
+        std::shared_ptr<const Node> root_;
+        std::size_t positions_;
+
+        Pattern(std::shared_ptr<const Node> root, std::size_t positions);
+    public:
+        /**
+         * Creates a pattern that matches only the empty word.
+         */
+        Pattern();
+
+        /**
+         * Returns a pattern that matches the single symbol.
+         */
+        static fsm::Pattern<T> symbol(T symbol);
+
+        /**
+         * Returns a pattern that matches any one of the symbols.
+         * @param vector<T> &symbols: The symbols, at least one.
+         */
+        static fsm::Pattern<T> any_of(const std::vector<T> &symbols);
+
+        /**
+         * Returns a pattern that matches exactly the given word.
+         * @param vector<T> &word: The symbols of the word.
+         */
+        static fsm::Pattern<T> word(const std::vector<T> &word);
+
+        /**
+         * Returns the concatenation of **this** and **rhs**.
+         */
+        fsm::Pattern<T> operator+(const fsm::Pattern<T> &rhs) const;
+
+        /**
+         * Returns the alternation of **this** and **rhs**.
+         */
+        fsm::Pattern<T> operator|(const fsm::Pattern<T> &rhs) const;
+
+        /**
+         * Returns zero or more repetitions of the pattern.
+         */
+        fsm::Pattern<T> star() const;
+
+        /**
+         * Returns one or more repetitions of the pattern.
+         */
+        fsm::Pattern<T> plus() const;
+
+        /**
+         * Returns the pattern or the empty word.
+         */
+        fsm::Pattern<T> optional() const;
+
+        /**
+         * Returns the number of symbol occurrences, the positions of the position automaton.
+         */
+        std::size_t get_positions_count() const;
+
+        /**
+         * Builds the position automaton, positions are numbered from 1 left to right.
+         */
+        fsm::PositionAutomaton<T> positions() const;
+    private:
+
+        /**
+         * Numbers the positions below **node** and adds the follow pairs it creates.
+         */
+        static Sets visit(const Node &node, fsm::PositionAutomaton<T> &automaton);
+    };
+}
+
+#endif //AUTOMATA_PATTERN_H
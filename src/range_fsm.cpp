@@ -0,0 +1,300 @@
+#include <deque>
+#include <limits>
+#include <unordered_map>
+
+#include "range_fsm.h"
+#include "automation_exception.h"
+
+template <typename T>
+fsm::RangeFSM<T>::RangeFSM() : initial_state_(0) {}
+
+template <typename T>
+fsm::RangeFSM<T>::RangeFSM(const fsm::FSM<T> &machine) : initial_state_(0) {
+    const auto &states = machine.get_states();
+    const auto &alphabet = machine.get_alphabet();
+    const auto &table = machine.get_transition_table();
+
+    for (const fsm::State &state : states) {
+        add_state(state);
+    }
+    for (std::size_t i = 0; i < states.size(); i++) {
+        for (std::size_t j = 0; j < alphabet.size(); j++) {
+            add_transition_rule(states[i], alphabet[j], alphabet[j], table[i][j]);
+        }
+    }
+    for (const fsm::State &state : machine.get_final_states()) {
+        add_final_state(state);
+    }
+    set_initial_state(machine.get_initial_state());
+}
+
+template <typename T>
+uint32_t fsm::RangeFSM<T>::get_states_count() const {
+    return states_.size();
+}
+
+template <typename T>
+const std::vector<fsm::State> &fsm::RangeFSM<T>::get_states() const {
+    return states_;
+}
+
+template <typename T>
+const fsm::State &fsm::RangeFSM<T>::get_initial_state() const {
+    if (states_.empty()) {
+        throw AutomationException("Machine has no states", __FILE__, __LINE__);
+    }
+    return states_[initial_state_];
+}
+
+template <typename T>
+void fsm::RangeFSM<T>::set_initial_state(const fsm::State &state) {
+    initial_state_ = id_of(state);
+}
+
+template <typename T>
+bool fsm::RangeFSM<T>::is_final_state(uint32_t id) const {
+    return id != npos && final_states_[id] != 0;
+}
+
+template <typename T>
+uint32_t fsm::RangeFSM<T>::get_intervals_count(uint32_t id) const {
+    return rows_[id].lows.size();
+}
+
+template <typename T>
+void fsm::RangeFSM<T>::add_state(const fsm::State &state) {
+    if (!ids_.emplace(state.get_name(), states_.size()).second) {
+        throw AutomationException("Duplicated states", __FILE__, __LINE__);
+    }
+    states_.push_back(state);
+    rows_.push_back(Row{{std::numeric_limits<T>::min()}, {npos}});
+    final_states_.push_back(0);
+}
+
+template <typename T>
+void fsm::RangeFSM<T>::add_final_state(const fsm::State &state) {
+    final_states_[id_of(state)] = 1;
+}
+
+template <typename T>
+void fsm::RangeFSM<T>::add_transition_rule(const fsm::State &state, T first, T last, const fsm::State &next_state) {
+    if (last < first) {
+        throw AutomationException("Empty symbol interval", __FILE__, __LINE__);
+    }
+
+    Row &row = rows_[id_of(state)];
+    uint32_t target = id_of(next_state);
+    Row result;
+
+    auto push = [&result](T low, uint32_t to) {
+        if (result.targets.empty() || result.targets.back() != to) {
+            result.lows.push_back(low);
+            result.targets.push_back(to);
+        }
+    };
+
+    bool inserted = false;
+    for (std::size_t i = 0; i < row.lows.size(); i++) {
+        T low = row.lows[i];
+        bool is_last = i + 1 == row.lows.size();
+        T high = is_last ? std::numeric_limits<T>::max() : T(row.lows[i + 1] - 1);
+
+        if (high < first || low > last) {
+            push(low, row.targets[i]);
+            continue;
+        }
+        if (low < first) {
+            push(low, row.targets[i]);
+        }
+        if (!inserted) {
+            push(first, target);
+            inserted = true;
+        }
+        if (high > last) {
+            push(T(last + 1), row.targets[i]);
+        }
+    }
+
+    row = std::move(result);
+}
+
+template <typename T>
+bool fsm::RangeFSM<T>::evaluate(const T *word, std::size_t length) const {
+    if (states_.empty()) {
+        return false;
+    }
+
+    uint32_t state = initial_state_;
+    for (std::size_t i = 0; i < length && state != npos; i++) {
+        state = next(state, word[i]);
+    }
+    return is_final_state(state);
+}
+
+template <typename T>
+bool fsm::RangeFSM<T>::evaluate(const std::vector<T> &word) const {
+    return evaluate(word.data(), word.size());
+}
+
+template <typename T>
+fsm::RangeFSM<T> fsm::RangeFSM<T>::operator!() const {
+    fsm::RangeFSM<T> complementMachine = *this;
+    bool uses_sink = states_.empty();
+
+    for (std::size_t i = 0; i < rows_.size(); i++) {
+        for (uint32_t &target : complementMachine.rows_[i].targets) {
+            if (target == npos) {
+                target = states_.size();
+                uses_sink = true;
+            }
+        }
+        complementMachine.final_states_[i] = !final_states_[i];
+    }
+
+    if (uses_sink) {
+        fsm::State sink = complementMachine.add_unique_state(fsm::State("sink"));
+        complementMachine.add_transition_rule(sink, std::numeric_limits<T>::min(), std::numeric_limits<T>::max(), sink);
+        complementMachine.add_final_state(sink);
+    }
+
+    return complementMachine;
+}
+
+template <typename T>
+fsm::RangeFSM<T> fsm::RangeFSM<T>::operator&(const fsm::RangeFSM<T> &rhs) const {
+    return product(rhs, true);
+}
+
+template <typename T>
+fsm::RangeFSM<T> fsm::RangeFSM<T>::operator|(const fsm::RangeFSM<T> &rhs) const {
+    return product(rhs, false);
+}
+
+template <typename T>
+fsm::RangeFSM<T> fsm::RangeFSM<T>::product(const fsm::RangeFSM<T> &rhs, bool intersection) const {
+    fsm::RangeFSM<T> productMachine;
+    if (states_.empty() || rhs.states_.empty()) {
+        return intersection ? productMachine : (states_.empty() ? rhs : *this);
+    }
+
+    // Pairs are keyed with npos shifted to 0 so both halves fit in 32 bits.
+    auto key = [](uint32_t a, uint32_t b) {
+        return ((uint64_t)(a + 1) << 32) | (uint32_t)(b + 1);
+    };
+    auto name = [](const fsm::RangeFSM<T> &m, uint32_t id) {
+        return id == npos ? fsm::State("-") : m.states_[id];
+    };
+
+    std::unordered_map<uint64_t, uint32_t> ids;
+    std::deque<std::pair<uint32_t, uint32_t>> queue;
+
+    auto id_of_pair = [&](uint32_t a, uint32_t b) {
+        if (intersection && (a == npos || b == npos)) {
+            return npos;
+        }
+        if (a == npos && b == npos) {
+            return npos;
+        }
+        auto inserted = ids.emplace(key(a, b), productMachine.states_.size());
+        if (inserted.second) {
+            productMachine.add_unique_state(name(*this, a) + name(rhs, b));
+            bool accepts = intersection
+                ? is_final_state(a) && rhs.is_final_state(b)
+                : is_final_state(a) || rhs.is_final_state(b);
+            productMachine.final_states_.back() = accepts;
+            queue.emplace_back(a, b);
+        }
+        return inserted.first->second;
+    };
+
+    id_of_pair(initial_state_, rhs.initial_state_);
+
+    static const Row sink_row = {{std::numeric_limits<T>::min()}, {npos}};
+
+    for (uint32_t id = 0; !queue.empty(); id++) {
+        uint32_t a = queue.front().first, b = queue.front().second;
+        queue.pop_front();
+
+        // Merge the boundaries of both rows, every piece maps to a single pair of targets.
+        const Row &ra = a == npos ? sink_row : rows_[a];
+        const Row &rb = b == npos ? sink_row : rhs.rows_[b];
+        Row row;
+        std::size_t i = 0, j = 0;
+        T low = std::numeric_limits<T>::min();
+
+        while (true) {
+            uint32_t target = id_of_pair(ra.targets[i], rb.targets[j]);
+            if (row.targets.empty() || row.targets.back() != target) {
+                row.lows.push_back(low);
+                row.targets.push_back(target);
+            }
+
+            bool more_a = i + 1 < ra.lows.size(), more_b = j + 1 < rb.lows.size();
+            if (!more_a && !more_b) {
+                break;
+            }
+            if (more_a && (!more_b || ra.lows[i + 1] <= rb.lows[j + 1])) {
+                low = ra.lows[i + 1];
+            } else {
+                low = rb.lows[j + 1];
+            }
+            if (more_a && ra.lows[i + 1] == low) {
+                i++;
+            }
+            if (more_b && rb.lows[j + 1] == low) {
+                j++;
+            }
+        }
+
+        productMachine.rows_[id] = std::move(row);
+    }
+
+    return productMachine;
+}
+
+template <typename T>
+std::ostream &fsm::RangeFSM<T>::ins(std::ostream &out) const {
+    for (std::size_t i = 0; i < states_.size(); i++) {
+        out << states_[i] << " |";
+        const Row &row = rows_[i];
+        for (std::size_t j = 0; j < row.lows.size(); j++) {
+            if (row.targets[j] == npos) {
+                continue;
+            }
+            T high = j + 1 == row.lows.size() ? std::numeric_limits<T>::max() : T(row.lows[j + 1] - 1);
+            out << " [" << (long long)row.lows[j] << ", " << (long long)high << "] -> " << states_[row.targets[j]];
+        }
+        out << "\n";
+    }
+
+    return out;
+}
+
+template <typename T>
+fsm::State fsm::RangeFSM<T>::add_unique_state(const fsm::State &state) {
+    fsm::State unique = state;
+    while (ids_.count(unique.get_name()) != 0) {
+        unique = unique + fsm::State("'");
+    }
+    add_state(unique);
+    return unique;
+}
+
+template <typename T>
+uint32_t fsm::RangeFSM<T>::id_of(const fsm::State &state) const {
+    auto it = ids_.find(state.get_name());
+    if (it == ids_.end()) {
+        throw AutomationException("Unknown state", __FILE__, __LINE__);
+    }
+    return it->second;
+}
+
+template <typename T>
+std::ostream &fsm::operator<<(std::ostream &out, const fsm::RangeFSM<T> &rhs) {
+    return rhs.ins(out);
+}
+
+template class fsm::RangeFSM<int>;
+template class fsm::RangeFSM<char>;
+template std::ostream &fsm::operator<<(std::ostream &out, const fsm::RangeFSM<int> &rhs);
+template std::ostream &fsm::operator<<(std::ostream &out, const fsm::RangeFSM<char> &rhs);
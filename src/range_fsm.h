@@ -0,0 +1,191 @@
+#ifndef AUTOMATA_RANGE_FSM_H
+#define AUTOMATA_RANGE_FSM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "fsm.h"
+#include "state.h"
+
+namespace fsm {
+    /**
+     * RangeFSM is a finite state machine over an integral alphabet whose
+     * transitions are labelled with closed intervals of symbols instead of single symbols.
+     * Every state holds a sorted list of disjoint intervals covering the whole
+     * range of T, each mapped to a target state, so the size of the machine
+     * does not depend on the size of the alphabet.
+     * Symbols without a rule lead to an implicit rejecting sink (RangeFSM::npos).
+     */
+    template <typename T>
+    class RangeFSM {
+    private:
+        /**
+         * The transitions of a state: interval i starts at lows[i] and ends right before lows[i + 1].
+         */
+        struct Row {
+            std::vector<T> lows;
+            std::vector<uint32_t> targets;
+        };
+
+        std::vector<fsm::State> states_;
+        std::map<fsm::String, uint32_t> ids_;
+        std::vector<Row> rows_;
+        std::vector<uint8_t> final_states_;
+        uint32_t initial_state_;
+    public:
+        /**
+         * Target of the symbols that have no transition rule.
+         */
+        static constexpr uint32_t npos = 0xffffffffu;
+
+        /**
+         * Creates a machine without states.
+         */
+        RangeFSM();
+
+        /**
+         * Converts an FSM, every symbol becomes a single symbol interval.
+         * @param FSM<T> &machine: The machine to convert.
+         */
+        RangeFSM(const fsm::FSM<T> &machine);
+
+        /**
+         * Returns the number of states.
+         */
+        uint32_t get_states_count() const;
+
+        /**
+         * Returns a vector with all states, indexed by id.
+         */
+        const std::vector<fsm::State> &get_states() const;
+
+        /**
+         * Returns the initial State.
+         */
+        const fsm::State &get_initial_state() const;
+
+        /**
+         * Sets the initial state. The first added state is the initial state by default.
+         * @param State &state: One of the machine's states.
+         */
+        void set_initial_state(const fsm::State &state);
+
+        /**
+         * Returns true if the state with the given id is a final state.
+         */
+        bool is_final_state(uint32_t id) const;
+
+        /**
+         * Returns the number of intervals in the row of a state.
+         */
+        uint32_t get_intervals_count(uint32_t id) const;
+
+        /**
+         * Adds a new state without any transitions.
+         * @param State &state: A new state with a unique name.
+         */
+        void add_state(const fsm::State &state);
+
+        /**
+         * Marks a state as final.
+         * @param State &state: One of the machine's states.
+         */
+        void add_final_state(const fsm::State &state);
+
+        /**
+         * Makes every symbol in [first, last] go from **state** to **next_state**.
+         * Overrides earlier rules for the overlapping part of the interval.
+         * @param State &state: The state the rule applies to.
+         * @param T first: The first symbol of the interval.
+         * @param T last: The last symbol of the interval (inclusive).
+         * @param State &next_state: The state the symbols lead to.
+         */
+        void add_transition_rule(const fsm::State &state, T first, T last, const fsm::State &next_state);
+
+        /**
+         * Returns the id of the state reached from **state** with **symbol**, or npos.
+         */
+        uint32_t next(uint32_t state, T symbol) const;
+
+        /**
+         * Returns true if the word is recognised by the machine.
+         * @param T *word: The symbols of the word.
+         * @param size_t length: Number of symbols in the word.
+         */
+        bool evaluate(const T *word, std::size_t length) const;
+
+        /**
+         * Returns true if the word is recognised by the machine.
+         * @param vector<T> &word: The symbols of the word.
+         */
+        bool evaluate(const std::vector<T> &word) const;
+
+        /**
+         * Returns the complement machine. The implicit sink becomes an explicit accepting state if it is used.
+         */
+        fsm::RangeFSM<T> operator!() const;
+
+        /**
+         * Returns a machine which is the intersection of the operands.
+         * @param RangeFSM<T> &rhs: Another machine that will be intersected with **this**.
+         */
+        fsm::RangeFSM<T> operator&(const fsm::RangeFSM<T> &rhs) const;
+
+        /**
+         * Returns a machine which is the union of the operands.
+         * @param RangeFSM<T> &rhs: Another machine that will be unified with **this**.
+         */
+        fsm::RangeFSM<T> operator|(const fsm::RangeFSM<T> &rhs) const;
+
+        /**
+         * Writes the intervals of every state to an output stream.
+         * @param ostream &out: An output stream to write to.
+         */
+        std::ostream& ins(std::ostream &out) const;
+    private:
+
+        /**
+         * Returns the id of a state, throws AutomationException if it is unknown.
+         */
+        uint32_t id_of(const fsm::State &state) const;
+
+        /**
+         * Adds a state, appending ' to its name until it does not clash with an existing one.
+         * Returns the added state.
+         */
+        fsm::State add_unique_state(const fsm::State &state);
+
+        /**
+         * Builds the reachable part of the product of **this** and **rhs**.
+         * @param bool intersection: Accept when both operands accept instead of either.
+         */
+        fsm::RangeFSM<T> product(const fsm::RangeFSM<T> &rhs, bool intersection) const;
+    };
+
+    /**
+     * An insertion operator for writting a RangeFSM to an output stream.
+     * @param ostream &out: An output stream to write to.
+     * @param RangeFSM<T> &rhs: A machine that will be written to the output stream.
+     */
+    template <typename T>
+    std::ostream& operator<<(std::ostream &out, const fsm::RangeFSM<T> &rhs);
+
+    template <typename T>
+    inline uint32_t RangeFSM<T>::next(uint32_t state, T symbol) const {
+        // Branchless binary search for the last interval starting at or before the symbol.
+        const Row &row = rows_[state];
+        const T *base = row.lows.data();
+        std::size_t n = row.lows.size();
+        while (n > 1) {
+            std::size_t half = n / 2;
+            base = base[half] <= symbol ? base + half : base;
+            n -= half;
+        }
+        return row.targets[base - row.lows.data()];
+    }
+}
+
+#endif //AUTOMATA_RANGE_FSM_H
@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "record_matcher.h"
+#include "automation_exception.h"
+
+namespace {
+    /**
+     * A chunk of the input cut after a separator, and the output of its records.
+     */
+    struct Block {
+        uint64_t sequence;
+        uint64_t offset;
+        std::size_t length;
+        std::vector<char> data;
+        std::vector<char> output;
+        uint64_t records;
+        uint64_t selected;
+    };
+
+    /**
+     * A blocking FIFO queue. pop() returns false once the queue is closed and drained.
+     */
+    template <typename Item>
+    class Queue {
+    private:
+        std::mutex mutex_;
+        std::condition_variable changed_;
+        std::deque<Item> items_;
+        bool closed_;
+    public:
+        Queue() : closed_(false) {}
+
+        void push(Item item) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                items_.push_back(std::move(item));
+            }
+            changed_.notify_one();
+        }
+
+        bool pop(Item &item) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this]() {
+                return !items_.empty() || closed_;
+            });
+            if (items_.empty()) {
+                return false;
+            }
+            item = std::move(items_.front());
+            items_.pop_front();
+            return true;
+        }
+
+        void close() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                closed_ = true;
+            }
+            changed_.notify_all();
+        }
+    };
+
+    typedef std::unique_ptr<Block> BlockPtr;
+
+    unsigned resolve_threads(unsigned threads) {
+        if (threads == 0) {
+            threads = std::thread::hardware_concurrency();
+        }
+        return std::max(threads, 1u);
+    }
+
+    /**
+     * Fills **data** from **used** on until it is full or the input ends. Returns the new used size.
+     */
+    std::size_t read_fully(int fd, std::vector<char> &data, std::size_t used, bool &eof) {
+        while (used < data.size() && !eof) {
+            ssize_t count = read(fd, data.data() + used, data.size() - used);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw fsm::AutomationException("Cannot read the input", __FILE__, __LINE__);
+            }
+            eof = count == 0;
+            used += count;
+        }
+        return used;
+    }
+
+    void write_all(int fd, const char *bytes, std::size_t length) {
+        while (length > 0) {
+            ssize_t count = write(fd, bytes, length);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw fsm::AutomationException("Cannot write the output", __FILE__, __LINE__);
+            }
+            bytes += count;
+            length -= count;
+        }
+    }
+
+    void append(std::vector<char> &output, const char *bytes, std::size_t length) {
+        output.insert(output.end(), bytes, bytes + length);
+    }
+}
+
+fsm::RecordMatcher::RecordMatcher(const fsm::CompiledFSM<char> &machine, const fsm::MatchOptions &options)
+    : machine_(machine),
+    options_(options)
+{
+    options_.threads = resolve_threads(options_.threads);
+    options_.block_size = std::max<std::size_t>(options_.block_size, 1 << 12);
+}
+
+bool fsm::RecordMatcher::accepts(const char *record, std::size_t length) const {
+    uint32_t state = machine_.get_initial_state();
+    for (std::size_t i = 0; i < length && !machine_.is_decided(state); i++) {
+        uint32_t column = machine_.column_of(record[i]);
+        if (column == fsm::SymbolMap<char>::npos) {
+            return false;
+        }
+        state = machine_.next(state, column);
+    }
+    return machine_.is_final_state(state);
+}
+
+fsm::MatchStats fsm::RecordMatcher::run(int input, int output) const {
+    auto start = std::chrono::steady_clock::now();
+    const char separator = options_.separator;
+    std::size_t prefix_length = options_.prefix != nullptr ? std::strlen(options_.prefix) : 0;
+
+    // Two blocks per stage in flight keep every stage busy.
+    Queue<BlockPtr> free_blocks, work, done;
+    for (unsigned i = 0; i < 2 * options_.threads + 4; i++) {
+        free_blocks.push(BlockPtr(new Block()));
+    }
+
+    std::exception_ptr read_error;
+    std::thread reader([&]() {
+        try {
+            std::vector<char> carry;
+            uint64_t offset = 0, sequence = 0;
+            bool eof = false;
+            BlockPtr block;
+            while (!eof && free_blocks.pop(block)) {
+                std::vector<char> &data = block->data;
+                data.resize(std::max(data.size(), carry.size() + options_.block_size));
+                std::copy(carry.begin(), carry.end(), data.begin());
+                std::size_t used = carry.size(), cut = 0;
+
+                // A block ends after its last separator, it grows while a record does not fit.
+                while (true) {
+                    used = read_fully(input, data, used, eof);
+                    auto last = std::find(std::make_reverse_iterator(data.begin() + used), data.rend(), separator);
+                    cut = data.rend() - last;
+                    if (cut > 0 || eof) {
+                        break;
+                    }
+                    data.resize(data.size() * 2);
+                }
+                if (eof) {
+                    cut = used;
+                }
+
+                carry.assign(data.begin() + cut, data.begin() + used);
+                block->sequence = sequence++;
+                block->offset = offset;
+                block->length = cut;
+                offset += cut;
+                work.push(std::move(block));
+            }
+        } catch (...) {
+            read_error = std::current_exception();
+        }
+        work.close();
+    });
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < options_.threads; t++) {
+        workers.emplace_back([&]() {
+            BlockPtr block;
+            char number[24];
+            while (work.pop(block)) {
+                const char *data = block->data.data();
+                block->output.clear();
+                block->records = 0;
+                block->selected = 0;
+                std::size_t begin = 0;
+                while (begin < block->length) {
+                    const char *found = static_cast<const char*>(std::memchr(data + begin, separator, block->length - begin));
+                    std::size_t end = found != nullptr ? found - data : block->length;
+                    bool selected = accepts(data + begin, end - begin) != options_.invert;
+                    block->records++;
+                    if (selected) {
+                        block->selected++;
+                        if (options_.output != fsm::MatchOutput::Count) {
+                            append(block->output, options_.prefix, prefix_length);
+                            if (options_.output == fsm::MatchOutput::Offsets) {
+                                int digits = std::snprintf(number, sizeof(number), "%llu:",
+                                    (unsigned long long)(block->offset + begin));
+                                append(block->output, number, digits);
+                            }
+                            append(block->output, data + begin, end - begin);
+                            block->output.push_back(separator);
+                        }
+                    }
+                    begin = end + 1;
+                }
+                done.push(std::move(block));
+            }
+        });
+    }
+
+    // Closes the output queue once every worker is finished.
+    std::thread closer([&]() {
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+        done.close();
+    });
+
+    // After a write error the blocks are still drained so the other stages can finish.
+    std::exception_ptr write_error;
+    fsm::MatchStats stats{0, 0, 0, 0};
+    std::map<uint64_t, BlockPtr> waiting;
+    uint64_t next = 0;
+    BlockPtr block;
+    auto finish = [&](BlockPtr &finished) {
+        stats.bytes += finished->length;
+        stats.records += finished->records;
+        stats.selected += finished->selected;
+        if (!write_error) {
+            try {
+                write_all(output, finished->output.data(), finished->output.size());
+            } catch (...) {
+                write_error = std::current_exception();
+            }
+        }
+        free_blocks.push(std::move(finished));
+    };
+    while (done.pop(block)) {
+        if (!options_.ordered) {
+            finish(block);
+            continue;
+        }
+        waiting.emplace(block->sequence, std::move(block));
+        for (auto it = waiting.find(next); it != waiting.end(); it = waiting.find(++next)) {
+            finish(it->second);
+            waiting.erase(it);
+        }
+    }
+
+    free_blocks.close();
+    reader.join();
+    closer.join();
+    if (read_error) {
+        std::rethrow_exception(read_error);
+    }
+    if (write_error) {
+        std::rethrow_exception(write_error);
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
@@ -0,0 +1,79 @@
+#ifndef AUTOMATA_RECORD_MATCHER_H
+#define AUTOMATA_RECORD_MATCHER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "compiled_fsm.h"
+
+namespace fsm {
+    /**
+     * What RecordMatcher writes for the selected records.
+     * Records writes each record followed by the separator, Offsets prefixes it with the
+     * byte offset of the record in its input and Count writes nothing.
+     */
+    enum class MatchOutput { Records, Offsets, Count };
+
+    /**
+     * Options of a RecordMatcher run.
+     */
+    struct MatchOptions {
+        char separator = '\n';
+        fsm::MatchOutput output = fsm::MatchOutput::Records;
+        bool invert = false;
+        bool ordered = false;
+        unsigned threads = 0;
+        std::size_t block_size = 1 << 22;
+        const char *prefix = nullptr;
+    };
+
+    /**
+     * Counts of a RecordMatcher run.
+     */
+    struct MatchStats {
+        uint64_t bytes;
+        uint64_t records;
+        uint64_t selected;
+        double seconds;
+    };
+
+    /**
+     * RecordMatcher selects the records of a stream that a machine accepts, grep style.
+     * It runs as a pipeline: a reader thread fills large blocks cut at record boundaries,
+     * **threads** workers evaluate the records of whole blocks and the calling thread writes
+     * the results. Blocks come from a fixed pool, so memory stays bounded when the output is
+     * slower than the input. Without MatchOptions::ordered blocks are written as soon as
+     * they are done, records inside a block always keep their order.
+     * A record with a symbol outside the alphabet is not accepted.
+     */
+    class RecordMatcher {
+    private:
+        const fsm::CompiledFSM<char> &machine_;
+        fsm::MatchOptions options_;
+    public:
+        /**
+         * Creates a matcher, the machine must outlive it.
+         * @param CompiledFSM<char> &machine: The machine records are matched against.
+         * @param MatchOptions &options: The separator, the output and the pipeline settings.
+         */
+        RecordMatcher(const fsm::CompiledFSM<char> &machine, const fsm::MatchOptions &options);
+
+        /**
+         * Returns true if the machine accepts the record.
+         * @param char *record: The bytes of the record, without separator.
+         * @param size_t length: Number of bytes in the record.
+         */
+        bool accepts(const char *record, std::size_t length) const;
+
+        /**
+         * Matches every record read from **input** and writes the selected ones to **output**.
+         * The last record does not need a separator.
+         * Throws AutomationException if reading or writing fails.
+         * @param int input: The file descriptor to read.
+         * @param int output: The file descriptor to write.
+         */
+        fsm::MatchStats run(int input, int output) const;
+    };
+}
+
+#endif //AUTOMATA_RECORD_MATCHER_H
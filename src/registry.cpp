@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include "registry.h"
+#include "automation_exception.h"
+
+template <typename T>
+fsm::Registry<T>::Reader::Reader(fsm::Registry<T> *registry, Slot *slot)
+    : registry_(registry),
+    slot_(slot),
+    snapshot_(registry->current_.load())
+{
+
+}
+
+template <typename T>
+fsm::Registry<T>::Reader::Reader(Reader &&rhs) noexcept
+    : registry_(rhs.registry_),
+    slot_(rhs.slot_),
+    snapshot_(rhs.snapshot_)
+{
+    rhs.slot_ = nullptr;
+    rhs.snapshot_ = nullptr;
+}
+
+template <typename T>
+fsm::Registry<T>::Reader::~Reader() {
+    if (slot_ != nullptr) {
+        slot_->epoch.store(FREE_SLOT);
+    }
+}
+
+template <typename T>
+const fsm::CompiledFSM<T> *fsm::Registry<T>::Reader::find(const fsm::String &name) const {
+    auto it = snapshot_->machines.find(name);
+    return it == snapshot_->machines.end() ? nullptr : it->second.get();
+}
+
+template <typename T>
+uint64_t fsm::Registry<T>::Reader::get_version() const {
+    return snapshot_->version;
+}
+
+template <typename T>
+fsm::Registry<T>::Registry(std::size_t readers)
+    : current_(new Snapshot{{}, 0}),
+    epoch_(0),
+    slots_(new Slot[std::max<std::size_t>(readers, 1)]),
+    slots_count_(std::max<std::size_t>(readers, 1))
+{
+    for (std::size_t i = 0; i < slots_count_; i++) {
+        slots_[i].epoch.store(FREE_SLOT);
+    }
+}
+
+template <typename T>
+fsm::Registry<T>::~Registry() {
+    delete current_.load();
+    for (const auto &retired : retired_) {
+        delete retired.second;
+    }
+}
+
+template <typename T>
+typename fsm::Registry<T>::Reader fsm::Registry<T>::read() {
+    // Start at a slot picked by the thread, so readers rarely compete for the same line.
+    std::size_t start = std::hash<std::thread::id>()(std::this_thread::get_id()) % slots_count_;
+    for (;;) {
+        for (std::size_t i = 0; i < slots_count_; i++) {
+            Slot &slot = slots_[(start + i) % slots_count_];
+            uint64_t expected = FREE_SLOT;
+            if (slot.epoch.load() == FREE_SLOT && slot.epoch.compare_exchange_strong(expected, epoch_.load())) {
+                // The epoch is announced before the snapshot is loaded, so a writer that
+                // retires this snapshot later tags it with an epoch that is not newer.
+                return Reader(this, &slot);
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+template <typename T>
+bool fsm::Registry<T>::evaluate(const fsm::String &name, const T *word, std::size_t length) {
+    Reader reader = read();
+    const fsm::CompiledFSM<T> *machine = reader.find(name);
+    if (machine == nullptr) {
+        throw AutomationException("Unknown machine", __FILE__, __LINE__);
+    }
+    return machine->evaluate(word, length);
+}
+
+template <typename T>
+void fsm::Registry<T>::publish(const fsm::String &name, fsm::CompiledFSM<T> machine) {
+    std::shared_ptr<const fsm::CompiledFSM<T>> shared = std::make_shared<const fsm::CompiledFSM<T>>(std::move(machine));
+
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    const Snapshot *current = current_.load();
+    Snapshot *snapshot = new Snapshot{current->machines, current->version + 1};
+    snapshot->machines[name] = std::move(shared);
+    replace(snapshot);
+}
+
+template <typename T>
+void fsm::Registry<T>::load(const fsm::String &name, const char *path) {
+    // Parse and compile outside the writer lock, only the swap is serialised.
+    fsm::FSM<T> machine(path);
+    publish(name, fsm::CompiledFSM<T>(machine));
+}
+
+template <typename T>
+bool fsm::Registry<T>::remove(const fsm::String &name) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    const Snapshot *current = current_.load();
+    if (current->machines.count(name) == 0) {
+        return false;
+    }
+    Snapshot *snapshot = new Snapshot{current->machines, current->version + 1};
+    snapshot->machines.erase(name);
+    replace(snapshot);
+    return true;
+}
+
+template <typename T>
+std::size_t fsm::Registry<T>::reclaim() {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    return reclaim_locked();
+}
+
+template <typename T>
+void fsm::Registry<T>::replace(Snapshot *snapshot) {
+    const Snapshot *old = current_.exchange(snapshot);
+    // Readers that can still see the old snapshot announced an epoch up to this one.
+    retired_.emplace_back(epoch_.fetch_add(1), old);
+    reclaim_locked();
+}
+
+template <typename T>
+std::size_t fsm::Registry<T>::reclaim_locked() {
+    uint64_t oldest = FREE_SLOT;
+    for (std::size_t i = 0; i < slots_count_; i++) {
+        oldest = std::min(oldest, slots_[i].epoch.load());
+    }
+
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < retired_.size(); i++) {
+        if (retired_[i].first < oldest) {
+            delete retired_[i].second;
+        } else {
+            retired_[kept++] = retired_[i];
+        }
+    }
+    retired_.resize(kept);
+    return kept;
+}
+
+template class fsm::Registry<int>;
+template class fsm::Registry<char>;
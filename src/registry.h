@@ -0,0 +1,155 @@
+#ifndef AUTOMATA_REGISTRY_H
+#define AUTOMATA_REGISTRY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "compiled_fsm.h"
+#include "custom_string.h"
+
+namespace fsm {
+    /**
+     * Registry maps names to immutable compiled machines and replaces them while they are in use.
+     * Readers open a Reader, which pins the current snapshot of the registry without taking a lock:
+     * it announces the global epoch in a free slot and loads the snapshot pointer.
+     * Writers are serialised by a mutex, publish a new snapshot with an atomic exchange and retire the
+     * old one with the epoch it was replaced in. A retired snapshot is deleted once every announced epoch
+     * is newer, so in-flight evaluations finish on the version they started with.
+     */
+    template <typename T>
+    class Registry {
+    private:
+        /**
+         * An immutable view of the registry. Machines that did not change are shared between snapshots.
+         */
+        struct Snapshot {
+            std::unordered_map<fsm::String, std::shared_ptr<const fsm::CompiledFSM<T>>> machines;
+            uint64_t version;
+        };
+
+        /**
+         * One reader slot per cache line, holding the epoch the reader announced or FREE_SLOT.
+         */
+        struct alignas(64) Slot {
+            std::atomic<uint64_t> epoch;
+        };
+
+        static constexpr uint64_t FREE_SLOT = ~uint64_t(0);
+
+        std::atomic<const Snapshot*> current_;
+        std::atomic<uint64_t> epoch_;
+        std::unique_ptr<Slot[]> slots_;
+        std::size_t slots_count_;
+        std::mutex writer_mutex_;
+        std::vector<std::pair<uint64_t, const Snapshot*>> retired_;
+    public:
+        /**
+         * A pinned snapshot of the registry. Machines found through it stay valid until it is destroyed.
+         */
+        class Reader {
+        private:
+            Registry *registry_;
+            Slot *slot_;
+            const Snapshot *snapshot_;
+
+            friend class Registry;
+
+            Reader(Registry *registry, Slot *slot);
+        public:
+            Reader(Reader &&rhs) noexcept;
+            Reader(const Reader &rhs) = delete;
+            Reader &operator=(const Reader &rhs) = delete;
+            Reader &operator=(Reader &&rhs) = delete;
+
+            /**
+             * Releases the snapshot.
+             */
+            ~Reader();
+
+            /**
+             * Returns the machine registered under **name** or nullptr.
+             * @param String &name: The name of the machine.
+             */
+            const fsm::CompiledFSM<T> *find(const fsm::String &name) const;
+
+            /**
+             * Returns the version of the pinned snapshot, it grows with every change of the registry.
+             */
+            uint64_t get_version() const;
+        };
+
+        /**
+         * Creates an empty registry.
+         * @param size_t readers: Number of reader slots, more concurrent readers wait for a free slot.
+         */
+        Registry(std::size_t readers = 128);
+
+        Registry(const Registry &rhs) = delete;
+        Registry &operator=(const Registry &rhs) = delete;
+
+        /**
+         * Deletes all snapshots. There must be no open readers.
+         */
+        ~Registry();
+
+        /**
+         * Pins the current snapshot. Never blocks on writers.
+         */
+        Reader read();
+
+        /**
+         * Evaluates a word with the current version of a machine.
+         * Throws AutomationException if there is no machine with that name.
+         * @param String &name: The name of the machine.
+         * @param T *word: The symbols of the word.
+         * @param size_t length: Number of symbols in the word.
+         */
+        bool evaluate(const fsm::String &name, const T *word, std::size_t length);
+
+        /**
+         * Registers a machine under a name, replacing the previous version.
+         * @param String &name: The name of the machine.
+         * @param CompiledFSM<T> machine: The new version.
+         */
+        void publish(const fsm::String &name, fsm::CompiledFSM<T> machine);
+
+        /**
+         * Loads a machine from a text file, compiles it and registers it under a name.
+         * @param String &name: The name of the machine.
+         * @param char *path: The path to a file with an FSM definition.
+         */
+        void load(const fsm::String &name, const char *path);
+
+        /**
+         * Removes a machine. Readers that already found it keep using it.
+         * Returns false if there was no machine with that name.
+         * @param String &name: The name of the machine.
+         */
+        bool remove(const fsm::String &name);
+
+        /**
+         * Deletes the retired snapshots that no reader can see anymore.
+         * Called by every change, returns the number of snapshots still waiting.
+         */
+        std::size_t reclaim();
+    private:
+
+        /**
+         * Swaps in a new snapshot and retires the old one. The writer mutex must be held.
+         */
+        void replace(Snapshot *snapshot);
+
+        /**
+         * Deletes the unreachable retired snapshots. The writer mutex must be held.
+         */
+        std::size_t reclaim_locked();
+    };
+}
+
+#endif //AUTOMATA_REGISTRY_H
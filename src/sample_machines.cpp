@@ -0,0 +1,18 @@
+#include <vector>
+
+#include "sample_machines.h"
+
+fsm::FSM<int> fsm::ones_counter(const char *prefix, int modulus, int step) {
+    std::vector<fsm::State> states, final_states;
+    std::vector<std::vector<fsm::State>> table;
+    for (int i = 0; i < modulus; i++) {
+        states.push_back(fsm::State(fsm::String(prefix) + fsm::String(i)));
+    }
+    for (int i = 0; i < modulus; i++) {
+        table.push_back({states[i], states[(i + 1) % modulus]});
+        if (i % step == 0) {
+            final_states.push_back(states[i]);
+        }
+    }
+    return fsm::FSM<int>(states, {0, 1}, states[0], final_states, table);
+}
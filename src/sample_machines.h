@@ -0,0 +1,18 @@
+#ifndef AUTOMATA_SAMPLE_MACHINES_H
+#define AUTOMATA_SAMPLE_MACHINES_H
+
+#include "fsm.h"
+
+namespace fsm {
+    /**
+     * Returns a machine over {0, 1} that counts the ones modulo **modulus** and accepts
+     * every **step**-th count. Products of counters with coprime moduli reach every
+     * pair of states, which makes them handy for examples and benchmarks.
+     * @param char *prefix: The prefix of the state names, followed by the count.
+     * @param int modulus: The number of states.
+     * @param int step: The distance between accepted counts, starting from 0.
+     */
+    fsm::FSM<int> ones_counter(const char *prefix, int modulus, int step);
+}
+
+#endif //AUTOMATA_SAMPLE_MACHINES_H
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <type_traits>
+
+#include "session_table.h"
+#include "automation_exception.h"
+
+namespace {
+    const char SNAPSHOT_MAGIC[4] = {'F', 'S', 'M', 'S'};
+    const uint32_t SNAPSHOT_VERSION = 1;
+
+    /**
+     * The smallest number of bytes that can hold every state id of a machine.
+     */
+    std::size_t width_for(uint32_t states) {
+        if (states <= 0x100u) {
+            return 1;
+        }
+        if (states <= 0x10000u) {
+            return 2;
+        }
+        return 4;
+    }
+}
+
+template <typename T>
+fsm::SessionTable<T>::SessionTable(const fsm::CompiledFSM<T> &machine, std::size_t sessions)
+    : machine_(machine),
+    width_(width_for(machine.get_states_count())),
+    sessions_(0)
+{
+    add_sessions(sessions);
+}
+
+template <typename T>
+std::size_t fsm::SessionTable<T>::add_session() {
+    add_sessions(1);
+    return sessions_ - 1;
+}
+
+template <typename T>
+void fsm::SessionTable<T>::add_sessions(std::size_t count) {
+    uint32_t initial = machine_.get_initial_state();
+    with_states(*this, [this, count, initial](auto &states) {
+        states.resize(sessions_ + count, initial);
+    });
+    sessions_ += count;
+}
+
+template <typename T>
+std::size_t fsm::SessionTable<T>::get_sessions_count() const {
+    return sessions_;
+}
+
+template <typename T>
+std::size_t fsm::SessionTable<T>::get_width() const {
+    return width_;
+}
+
+template <typename T>
+bool fsm::SessionTable<T>::is_accepting(std::size_t session) const {
+    return machine_.is_final_state(get_state(session));
+}
+
+template <typename T>
+void fsm::SessionTable<T>::reset(std::size_t session) {
+    if (session >= sessions_) {
+        throw AutomationException("Unknown session", __FILE__, __LINE__);
+    }
+    uint32_t initial = machine_.get_initial_state();
+    with_states(*this, [session, initial](auto &states) {
+        states[session] = initial;
+    });
+}
+
+template <typename T>
+void fsm::SessionTable<T>::feed(std::size_t session, const T *symbols, std::size_t length) {
+    if (session >= sessions_) {
+        throw AutomationException("Unknown session", __FILE__, __LINE__);
+    }
+    std::size_t consumed;
+    uint32_t state = machine_.feed(get_state(session), symbols, length, consumed);
+    with_states(*this, [session, state](auto &states) {
+        states[session] = state;
+    });
+}
+
+template <typename T>
+void fsm::SessionTable<T>::feed_batch(const fsm::SessionChunk<T> *chunks, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+        if (chunks[i].session >= sessions_) {
+            throw AutomationException("Unknown session", __FILE__, __LINE__);
+        }
+        if (machine_.validate(chunks[i].symbols, chunks[i].length) != chunks[i].length) {
+            throw AutomationException("Input is not in alphabet", __FILE__, __LINE__);
+        }
+    }
+
+    order_.resize(count);
+    std::iota(order_.begin(), order_.end(), 0);
+    std::stable_sort(order_.begin(), order_.end(), [chunks](std::size_t a, std::size_t b) {
+        return chunks[a].session < chunks[b].session;
+    });
+
+    // Dispatch on the width once per batch so the loop works on typed ids.
+    with_states(*this, [this, chunks](auto &states) {
+        feed_sorted(states, chunks);
+    });
+}
+
+template <typename T>
+template <typename S>
+void fsm::SessionTable<T>::feed_sorted(std::vector<S> &states, const fsm::SessionChunk<T> *chunks) {
+    // The symbols were validated with the batch, so they are fed without checks.
+    std::size_t consumed;
+    for (std::size_t i : order_) {
+        const fsm::SessionChunk<T> &chunk = chunks[i];
+        states[chunk.session] = machine_.feed(states[chunk.session], chunk.symbols, chunk.length, consumed,
+            fsm::Unchecked());
+    }
+}
+
+template <typename T>
+void fsm::SessionTable<T>::snapshot(const char *path) const {
+    std::ofstream out(path, std::ios::binary);
+    uint32_t header[3] = {SNAPSHOT_VERSION, (uint32_t)width_, machine_.get_states_count()};
+    uint64_t sessions = sessions_;
+
+    out.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(&sessions), sizeof(sessions));
+    with_states(*this, [this, &out](const auto &states) {
+        out.write(reinterpret_cast<const char*>(states.data()), sessions_ * width_);
+    });
+    if (!out) {
+        throw AutomationException("Cannot write the sessions snapshot", __FILE__, __LINE__);
+    }
+}
+
+template <typename T>
+void fsm::SessionTable<T>::restore(const char *path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[4];
+    uint32_t header[3];
+    uint64_t sessions;
+
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    in.read(reinterpret_cast<char*>(&sessions), sizeof(sessions));
+    if (!in || std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0 || header[0] != SNAPSHOT_VERSION) {
+        throw AutomationException("Not a sessions snapshot", __FILE__, __LINE__);
+    }
+    if (header[1] != width_ || header[2] != machine_.get_states_count()) {
+        throw AutomationException("The snapshot belongs to another machine", __FILE__, __LINE__);
+    }
+
+    // The count comes from the file, so it is checked against the bytes left before anything is allocated.
+    std::streampos start = in.tellg();
+    in.seekg(0, std::ios::end);
+    uint64_t remaining = in.tellg() - start;
+    in.seekg(start);
+    if (!in || sessions > remaining / width_) {
+        throw AutomationException("The sessions snapshot is truncated", __FILE__, __LINE__);
+    }
+
+    // The current sessions are only replaced once the whole snapshot is read and checked.
+    with_states(*this, [this, &in, sessions](auto &states) {
+        typename std::remove_reference<decltype(states)>::type saved(sessions);
+        in.read(reinterpret_cast<char*>(saved.data()), sessions * width_);
+        if (!in) {
+            throw AutomationException("The sessions snapshot is truncated", __FILE__, __LINE__);
+        }
+        for (uint32_t state : saved) {
+            if (state >= machine_.get_states_count()) {
+                throw AutomationException("The snapshot belongs to another machine", __FILE__, __LINE__);
+            }
+        }
+        states.swap(saved);
+    });
+    sessions_ = sessions;
+}
+
+template <typename T>
+std::size_t fsm::SessionTable<T>::memory_usage() const {
+    return with_states(*this, [this](const auto &states) {
+        return states.capacity() * width_;
+    });
+}
+
+template class fsm::SessionTable<int>;
+template class fsm::SessionTable<char>;
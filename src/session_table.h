@@ -0,0 +1,162 @@
+#ifndef AUTOMATA_SESSION_TABLE_H
+#define AUTOMATA_SESSION_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "automation_exception.h"
+#include "compiled_fsm.h"
+
+namespace fsm {
+    /**
+     * A chunk of symbols received by one session.
+     */
+    template <typename T>
+    struct SessionChunk {
+        std::size_t session;
+        const T *symbols;
+        std::size_t length;
+    };
+
+    /**
+     * SessionTable tracks many independent runs of one compiled machine.
+     * Each session is only the id of its current state, packed into 1, 2 or 4 bytes
+     * depending on the number of states, so millions of sessions fit in a few megabytes.
+     * Like CompiledFSM::feed, a session stops moving once it enters a deciding state.
+     */
+    template <typename T>
+    class SessionTable {
+    private:
+        const fsm::CompiledFSM<T> &machine_;
+        std::vector<uint8_t> states8_;
+        std::vector<uint16_t> states16_;
+        std::vector<uint32_t> states32_;
+        std::size_t width_;
+        std::size_t sessions_;
+        std::vector<std::size_t> order_;
+    public:
+        /**
+         * Creates a table for a machine. The machine must outlive the table.
+         * @param CompiledFSM<T> &machine: The machine every session runs.
+         * @param size_t sessions: Number of sessions to open, all in the initial state.
+         */
+        SessionTable(const fsm::CompiledFSM<T> &machine, std::size_t sessions = 0);
+
+        /**
+         * Opens a new session in the initial state and returns its id.
+         */
+        std::size_t add_session();
+
+        /**
+         * Opens **count** new sessions, their ids follow the existing ones.
+         * @param size_t count: Number of sessions to open.
+         */
+        void add_sessions(std::size_t count);
+
+        /**
+         * Returns the number of sessions.
+         */
+        std::size_t get_sessions_count() const;
+
+        /**
+         * Returns the number of bytes stored per session.
+         */
+        std::size_t get_width() const;
+
+        /**
+         * Returns the id of the state a session is in.
+         * Throws AutomationException if the session does not exist.
+         */
+        uint32_t get_state(std::size_t session) const;
+
+        /**
+         * Returns true if the session is in a final state.
+         * Throws AutomationException if the session does not exist.
+         */
+        bool is_accepting(std::size_t session) const;
+
+        /**
+         * Puts a session back to the initial state.
+         * Throws AutomationException if the session does not exist.
+         */
+        void reset(std::size_t session);
+
+        /**
+         * Feeds symbols to one session.
+         * Throws AutomationException if the session does not exist or a symbol is not in the alphabet.
+         * @param size_t session: The id of the session.
+         * @param T *symbols: The symbols received.
+         * @param size_t length: Number of symbols.
+         */
+        void feed(std::size_t session, const T *symbols, std::size_t length);
+
+        /**
+         * Feeds a batch of chunks. The chunks are applied in session order, so the state
+         * array is walked sequentially, and chunks of the same session keep their order.
+         * Throws AutomationException if a session does not exist or a symbol is not in the alphabet,
+         * the whole batch is checked first so no session changes in that case.
+         * @param SessionChunk<T> *chunks: The chunks to feed.
+         * @param size_t count: Number of chunks.
+         */
+        void feed_batch(const fsm::SessionChunk<T> *chunks, std::size_t count);
+
+        /**
+         * Writes the states of all sessions to a binary file.
+         * Throws AutomationException if the file cannot be written.
+         * @param char *path: The path to the file.
+         */
+        void snapshot(const char *path) const;
+
+        /**
+         * Replaces all sessions with the ones saved by snapshot().
+         * Throws AutomationException if the file is unreadable or was saved for a machine with another state count.
+         * @param char *path: The path to the file.
+         */
+        void restore(const char *path);
+
+        /**
+         * Returns the number of bytes used by the session states.
+         */
+        std::size_t memory_usage() const;
+    private:
+
+        /**
+         * Applies the chunks listed in order_ to the given states.
+         */
+        template <typename S>
+        void feed_sorted(std::vector<S> &states, const fsm::SessionChunk<T> *chunks);
+
+        /**
+         * Calls **body** with the state ids of **table** in use, so loops over them are specialised
+         * for their width. The ids are const when the table is.
+         */
+        template <typename Table, typename Body>
+        static auto with_states(Table &table, Body body) -> decltype(body(table.states8_));
+    };
+
+    template <typename T>
+    inline uint32_t SessionTable<T>::get_state(std::size_t session) const {
+        if (session >= sessions_) {
+            throw AutomationException("Unknown session", __FILE__, __LINE__);
+        }
+        return with_states(*this, [session](const auto &states) {
+            return (uint32_t)states[session];
+        });
+    }
+
+    template <typename T>
+    template <typename Table, typename Body>
+    inline auto SessionTable<T>::with_states(Table &table, Body body) -> decltype(body(table.states8_)) {
+        switch (table.width_) {
+            case sizeof(uint8_t):
+                return body(table.states8_);
+            case sizeof(uint16_t):
+                return body(table.states16_);
+            default:
+                return body(table.states32_);
+        }
+    }
+}
+
+#endif //AUTOMATA_SESSION_TABLE_H
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cstring>
+
+#include "symbol_map.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define AUTOMATA_AVX2 1
+#endif
+
+namespace {
+#ifdef AUTOMATA_AVX2
+    const bool has_avx2 = __builtin_cpu_supports("avx2");
+
+    /**
+     * Returns the start of the first block of 32 bytes with a byte outside the set, or of the tail.
+     * A byte is in the set if bit (byte >> 4) of the entry (byte & 15) of the nibble tables is set,
+     * the first 16 tables cover the high nibbles 0 to 7 and the next 16 the high nibbles 8 to 15.
+     */
+    __attribute__((target("avx2")))
+    std::size_t scan_bytes(const uint8_t *bytes, std::size_t length, const uint8_t *nibbles) {
+        const __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(nibbles)));
+        const __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(nibbles + 16)));
+        const __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                              1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+        const __m256i nibble = _mm256_set1_epi8(0x0f), eight = _mm256_set1_epi8(8);
+        std::size_t i = 0;
+        for (; i + 32 <= length; i += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + i));
+            __m256i lo = _mm256_and_si256(block, nibble);
+            __m256i hi = _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble);
+            __m256i upper = _mm256_cmpeq_epi8(_mm256_and_si256(hi, eight), eight);
+            __m256i row = _mm256_blendv_epi8(_mm256_shuffle_epi8(low, lo), _mm256_shuffle_epi8(high, lo), upper);
+            __m256i missing = _mm256_cmpeq_epi8(_mm256_and_si256(row, _mm256_shuffle_epi8(bits, hi)), _mm256_setzero_si256());
+            if (!_mm256_testz_si256(missing, missing)) {
+                break;
+            }
+        }
+        return i;
+    }
+
+    /**
+     * Returns the start of the first block of 8 symbols with a symbol outside a direct map, or of the tail.
+     */
+    __attribute__((target("avx2")))
+    std::size_t scan_direct(const int *symbols, std::size_t length, int min, const uint32_t *direct, uint32_t size) {
+        const __m256i base = _mm256_set1_epi32(min), last = _mm256_set1_epi32(size - 1);
+        const __m256i npos = _mm256_set1_epi32(-1);
+        std::size_t i = 0;
+        for (; i + 8 <= length; i += 8) {
+            __m256i offsets = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(symbols + i)), base);
+            __m256i inside = _mm256_cmpeq_epi32(_mm256_min_epu32(offsets, last), offsets);
+            __m256i columns = _mm256_mask_i32gather_epi32(npos, reinterpret_cast<const int*>(direct), offsets, inside, 4);
+            __m256i missing = _mm256_cmpeq_epi32(columns, npos);
+            if (!_mm256_testz_si256(missing, missing)) {
+                break;
+            }
+        }
+        return i;
+    }
+#endif
+
+    /**
+     * Returns how many leading symbols the SIMD scans cleared, the rest is checked one by one.
+     */
+    std::size_t scan(const char *symbols, std::size_t length, const uint8_t *nibbles, long long, const std::vector<uint32_t> &) {
+#ifdef AUTOMATA_AVX2
+        if (has_avx2) {
+            return scan_bytes(reinterpret_cast<const uint8_t*>(symbols), length, nibbles);
+        }
+#endif
+        return 0;
+    }
+
+    std::size_t scan(const int *symbols, std::size_t length, const uint8_t *, long long min, const std::vector<uint32_t> &direct) {
+#ifdef AUTOMATA_AVX2
+        // Gather offsets are signed, so larger maps are checked one by one.
+        if (has_avx2 && direct.size() < (std::size_t(1) << 31)) {
+            return scan_direct(symbols, length, (int)min, direct.data(), direct.size());
+        }
+#endif
+        return 0;
+    }
+}
+
+template <typename T>
+fsm::SymbolMap<T>::SymbolMap() : min_(0), is_direct_(true) {
+    std::memset(nibbles_, 0, sizeof(nibbles_));
+}
+
+template <typename T>
+fsm::SymbolMap<T>::SymbolMap(const std::vector<T> &alphabet) : min_(0), is_direct_(true) {
+    std::memset(nibbles_, 0, sizeof(nibbles_));
+    if (alphabet.empty()) {
+        return;
+    }
+
+    auto bounds = std::minmax_element(alphabet.begin(), alphabet.end());
+    long long lo = (long long)*bounds.first, hi = (long long)*bounds.second;
+    unsigned long long range = (unsigned long long)(hi - lo) + 1;
+
+    // A direct array is used while it stays within a small factor of the alphabet size.
+    is_direct_ = range <= 4 * (unsigned long long)alphabet.size() + 1024;
+
+    if (is_direct_) {
+        min_ = lo;
+        direct_.assign(range, npos);
+        for (uint32_t i = 0; i < alphabet.size(); i++) {
+            uint32_t &cell = direct_[(long long)alphabet[i] - min_];
+            if (cell == npos) {
+                cell = i;
+            }
+        }
+    } else {
+        hashed_.reserve(alphabet.size());
+        for (uint32_t i = 0; i < alphabet.size(); i++) {
+            hashed_.emplace(alphabet[i], i);
+        }
+    }
+
+    if constexpr (sizeof(T) == 1) {
+        for (unsigned byte = 0; byte < 256; byte++) {
+            if (column((T)byte) != npos) {
+                nibbles_[(byte >> 7) * 16 + (byte & 15)] |= 1 << ((byte >> 4) & 7);
+            }
+        }
+    }
+}
+
+template <typename T>
+std::size_t fsm::SymbolMap<T>::validate(const T *symbols, std::size_t length) const {
+    std::size_t i = is_direct_ && !direct_.empty() ? scan(symbols, length, nibbles_, min_, direct_) : 0;
+    for (; i < length; i++) {
+        if (column(symbols[i]) == npos) {
+            return i;
+        }
+    }
+    return length;
+}
+
+template <typename T>
+bool fsm::SymbolMap<T>::is_direct() const {
+    return is_direct_;
+}
+
+template <typename T>
+std::size_t fsm::SymbolMap<T>::memory_usage() const {
+    return direct_.capacity() * sizeof(uint32_t)
+        + hashed_.size() * (sizeof(T) + sizeof(uint32_t) + 2 * sizeof(void*))
+        + hashed_.bucket_count() * sizeof(void*);
+}
+
+template class fsm::SymbolMap<int>;
+template class fsm::SymbolMap<char>;
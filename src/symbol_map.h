@@ -0,0 +1,94 @@
+#ifndef AUTOMATA_SYMBOL_MAP_H
+#define AUTOMATA_SYMBOL_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace fsm {
+    /**
+     * SymbolMap maps the symbols of an alphabet to their column
+     * in a compiled transition table in constant time.
+     * Alphabets that cover a narrow range of values (like FSM<char>)
+     * are stored as a direct lookup array, sparse alphabets (like
+     * token ids spread over the whole int range) fall back to a hash map.
+     */
+    template <typename T>
+    class SymbolMap {
+    private:
+        std::vector<uint32_t> direct_;
+        long long min_;
+        std::unordered_map<T, uint32_t> hashed_;
+        bool is_direct_;
+        uint8_t nibbles_[32];
+    public:
+        /**
+         * Column returned for symbols that are not in the alphabet.
+         */
+        static constexpr uint32_t npos = 0xffffffffu;
+
+        /**
+         * Creates a SymbolMap for an empty alphabet.
+         */
+        SymbolMap();
+
+        /**
+         * Creates a SymbolMap for the given alphabet.
+         * The column of a symbol is its index in the alphabet.
+         * @param vector<T> &alphabet: The alphabet to index.
+         */
+        SymbolMap(const std::vector<T> &alphabet);
+
+        /**
+         * Returns the column of the symbol or npos if it is not in the alphabet.
+         * @param T symbol: The symbol to look up.
+         */
+        uint32_t column(T symbol) const;
+
+        /**
+         * Returns the column of a symbol that is known to be in the alphabet, without the range check.
+         * @param T symbol: The symbol to look up.
+         */
+        uint32_t column_unchecked(T symbol) const;
+
+        /**
+         * Returns the position of the first symbol that is not in the alphabet, or **length** if all are.
+         * Byte alphabets are checked 32 symbols at a time with nibble shuffles and direct maps
+         * of wider symbols 8 at a time with gathers, when the CPU has AVX2.
+         * @param T *symbols: The symbols to check.
+         * @param size_t length: Number of symbols.
+         */
+        std::size_t validate(const T *symbols, std::size_t length) const;
+
+        /**
+         * Returns true if the symbols are stored in a direct lookup array.
+         */
+        bool is_direct() const;
+
+        /**
+         * Returns the number of bytes used by the map.
+         */
+        std::size_t memory_usage() const;
+    };
+
+    template <typename T>
+    inline uint32_t SymbolMap<T>::column(T symbol) const {
+        if (is_direct_) {
+            unsigned long long offset = (unsigned long long)((long long)symbol - min_);
+            return offset < direct_.size() ? direct_[offset] : npos;
+        }
+        auto it = hashed_.find(symbol);
+        return it == hashed_.end() ? npos : it->second;
+    }
+
+    template <typename T>
+    inline uint32_t SymbolMap<T>::column_unchecked(T symbol) const {
+        if (is_direct_) {
+            return direct_[(long long)symbol - min_];
+        }
+        return hashed_.find(symbol)->second;
+    }
+}
+
+#endif //AUTOMATA_SYMBOL_MAP_H
@@ -0,0 +1,76 @@
+#include <algorithm>
+
+#include "tokenizer.h"
+
+template <typename T>
+fsm::Tokenizer<T>::Tokenizer(const fsm::CompiledFSM<T> &machine) : machine_(machine), capacity_(0) {}
+
+template <typename T>
+void fsm::Tokenizer<T>::reserve(std::size_t length) {
+    if (length <= capacity_ && !trail_.empty()) {
+        return;
+    }
+    std::size_t bits = (length + 1) * machine_.get_states_count();
+    failed_.resize((bits + 63) / 64);
+    trail_.resize(length + 1);
+    capacity_ = length;
+}
+
+template <typename T>
+std::size_t fsm::Tokenizer<T>::tokenize(const T *input, std::size_t length, fsm::Token *tokens, std::size_t capacity,
+    std::size_t &consumed) {
+    reserve(length);
+
+    std::size_t states = machine_.get_states_count();
+    std::size_t words = ((length + 1) * states + 63) / 64;
+    std::fill(failed_.begin(), failed_.begin() + words, 0);
+
+    auto bit = [states](std::size_t position, uint32_t state) {
+        return position * states + state;
+    };
+
+    std::size_t count = 0, pos = 0;
+    while (pos < length && count < capacity) {
+        uint32_t state = machine_.get_initial_state(), last_state = 0;
+        std::size_t last = pos, trail = 0, i = pos;
+
+        // Scan forward remembering the last accepting position and the states seen after it.
+        while (i < length) {
+            uint32_t column = machine_.column_of(input[i]);
+            if (column == fsm::SymbolMap<T>::npos) {
+                break;
+            }
+            state = machine_.next(state, column);
+            i++;
+            std::size_t b = bit(i, state);
+            if (machine_.is_dead_state(state) || (failed_[b / 64] >> (b % 64) & 1) != 0) {
+                break;
+            }
+            if (machine_.is_final_state(state)) {
+                last = i;
+                last_state = state;
+                trail = 0;
+            } else {
+                trail_[trail++] = state;
+            }
+        }
+
+        // None of the states after the last accepting position can lead to a longer token.
+        for (std::size_t k = 0; k < trail; k++) {
+            std::size_t b = bit(last + 1 + k, trail_[k]);
+            failed_[b / 64] |= uint64_t(1) << (b % 64);
+        }
+
+        if (last == pos) {
+            break;
+        }
+        tokens[count++] = fsm::Token{machine_.get_label(last_state).token, pos, last - pos};
+        pos = last;
+    }
+
+    consumed = pos;
+    return count;
+}
+
+template class fsm::Tokenizer<int>;
+template class fsm::Tokenizer<char>;
@@ -0,0 +1,64 @@
+#ifndef AUTOMATA_TOKENIZER_H
+#define AUTOMATA_TOKENIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "compiled_fsm.h"
+
+namespace fsm {
+    /**
+     * A token found by the Tokenizer: the label of the final state it ended in
+     * and its position in the input.
+     */
+    struct Token {
+        unsigned token;
+        std::size_t offset;
+        std::size_t length;
+    };
+
+    /**
+     * Tokenizer splits an input buffer into the longest tokens recognised by a
+     * compiled machine with labelled final states (maximal munch).
+     * Backtracking to the last accepting position is memoised on (state, position)
+     * pairs that are known to never reach an accepting state again, which bounds
+     * the work to O(n) for a fixed machine.
+     */
+    template <typename T>
+    class Tokenizer {
+    private:
+        const fsm::CompiledFSM<T> &machine_;
+        std::vector<uint64_t> failed_;
+        std::vector<uint32_t> trail_;
+        std::size_t capacity_;
+    public:
+        /**
+         * Creates a tokenizer for a machine. The machine must outlive the tokenizer.
+         * @param CompiledFSM<T> &machine: The machine whose final states mark the tokens.
+         */
+        Tokenizer(const fsm::CompiledFSM<T> &machine);
+
+        /**
+         * Allocates the scratch memory for inputs of up to **length** symbols,
+         * tokenize() does not allocate for such inputs afterwards.
+         * @param size_t length: The longest input that will be tokenized.
+         */
+        void reserve(std::size_t length);
+
+        /**
+         * Splits the input into tokens. Stops when the input is exhausted, the token
+         * buffer is full or no token starts at the current position.
+         * Returns the number of tokens written.
+         * @param T *input: The symbols to tokenize.
+         * @param size_t length: Number of symbols in the input.
+         * @param Token *tokens: Caller provided buffer that receives the tokens.
+         * @param size_t capacity: Number of tokens that fit in the buffer.
+         * @param size_t &consumed: Set to the number of symbols covered by the written tokens.
+         */
+        std::size_t tokenize(const T *input, std::size_t length, fsm::Token *tokens, std::size_t capacity,
+            std::size_t &consumed);
+    };
+}
+
+#endif //AUTOMATA_TOKENIZER_H
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+
+#include "transition_table.h"
+
+namespace {
+    const uint32_t FREE_SLOT = 0xffffffffu;
+}
+
+template <typename Id>
+fsm::DenseTable<Id>::DenseTable() : columns_(0) {}
+
+template <typename Id>
+fsm::DenseTable<Id>::DenseTable(uint32_t rows, uint32_t columns)
+    : cells_((std::size_t)rows * columns, 0),
+    columns_(columns) {}
+
+template <typename Id>
+fsm::DenseTable<Id>::DenseTable(const std::vector<fsm::SparseRow> &rows, uint32_t columns)
+    : cells_((std::size_t)rows.size() * columns),
+    columns_(columns)
+{
+    for (std::size_t i = 0; i < rows.size(); i++) {
+        Id *row = &cells_[i * columns_];
+        std::fill(row, row + columns_, (Id)rows[i].default_target);
+        for (const auto &exception : rows[i].exceptions) {
+            row[exception.first] = exception.second;
+        }
+    }
+}
+
+template <typename Id>
+void fsm::DenseTable<Id>::set(uint32_t state, uint32_t column, uint32_t target) {
+    cells_[(std::size_t)state * columns_ + column] = target;
+}
+
+template <typename Id>
+std::size_t fsm::DenseTable<Id>::memory_usage() const {
+    return cells_.capacity() * sizeof(Id);
+}
+
+template class fsm::DenseTable<uint8_t>;
+template class fsm::DenseTable<uint16_t>;
+template class fsm::DenseTable<uint32_t>;
+
+fsm::CombTable::CombTable() : columns_(0) {}
+
+fsm::CombTable::CombTable(const std::vector<fsm::SparseRow> &rows, uint32_t columns)
+    : defaults_(rows.size()),
+    base_(rows.size(), 0),
+    columns_(columns)
+{
+    // Pack the busiest rows first, they are the hardest to fit.
+    std::vector<uint32_t> order(rows.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&rows](uint32_t a, uint32_t b) {
+        return rows[a].exceptions.size() > rows[b].exceptions.size();
+    });
+
+    std::size_t first_free = 0;
+    std::vector<uint32_t> cols;
+
+    for (uint32_t state : order) {
+        const fsm::SparseRow &row = rows[state];
+        defaults_[state] = row.default_target;
+        if (row.exceptions.empty()) {
+            continue;
+        }
+
+        cols.clear();
+        for (const auto &exception : row.exceptions) {
+            cols.push_back(exception.first);
+        }
+        std::sort(cols.begin(), cols.end());
+
+        // First fit: slide the row over the free slots until none of its columns collide.
+        std::size_t base = first_free > cols[0] ? first_free - cols[0] : 0;
+        for (;; base++) {
+            bool fits = true;
+            for (uint32_t col : cols) {
+                std::size_t slot = base + col;
+                if (slot < check_.size() && check_[slot] != FREE_SLOT) {
+                    fits = false;
+                    break;
+                }
+            }
+            if (fits) {
+                break;
+            }
+        }
+
+        std::size_t needed = base + cols.back() + 1;
+        if (needed > check_.size()) {
+            check_.resize(needed, FREE_SLOT);
+            next_.resize(needed, 0);
+        }
+
+        base_[state] = base;
+        for (const auto &exception : row.exceptions) {
+            check_[base + exception.first] = state;
+            next_[base + exception.first] = exception.second;
+        }
+
+        while (first_free < check_.size() && check_[first_free] != FREE_SLOT) {
+            first_free++;
+        }
+    }
+
+    // Every base + column must stay inside the arrays.
+    std::size_t max_base = base_.empty() ? 0 : *std::max_element(base_.begin(), base_.end());
+    std::size_t size = max_base + columns_;
+    if (size > check_.size()) {
+        check_.resize(size, FREE_SLOT);
+        next_.resize(size, 0);
+    }
+    check_.shrink_to_fit();
+    next_.shrink_to_fit();
+}
+
+std::size_t fsm::CombTable::get_slots_count() const {
+    return check_.size();
+}
+
+std::size_t fsm::CombTable::memory_usage() const {
+    return (defaults_.capacity() + base_.capacity() + next_.capacity() + check_.capacity()) * sizeof(uint32_t);
+}
+
+fsm::Layout fsm::choose_layout(const std::vector<fsm::SparseRow> &rows, uint32_t columns, fsm::Layout requested) {
+    if (requested != fsm::Layout::Auto) {
+        return requested;
+    }
+
+    std::size_t exceptions = 0;
+    for (const fsm::SparseRow &row : rows) {
+        exceptions += row.exceptions.size();
+    }
+
+    // Estimate the comb size assuming near perfect packing and only
+    // take it when it at least halves the footprint, dense lookups are cheaper.
+    std::size_t dense = rows.size() * (std::size_t)columns * sizeof(uint32_t);
+    std::size_t comb = (rows.size() * 2 + (exceptions + columns) * 2) * sizeof(uint32_t);
+
+    return comb * 2 < dense ? fsm::Layout::Comb : fsm::Layout::Dense;
+}
+
+unsigned fsm::state_id_size(std::size_t states) {
+    if (states <= 0x100) {
+        return sizeof(uint8_t);
+    }
+    return states <= 0x10000 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+fsm::SparseRow fsm::make_sparse_row(const uint32_t *cells, uint32_t columns) {
+    fsm::SparseRow row;
+    row.default_target = 0;
+    if (columns == 0) {
+        return row;
+    }
+
+    uint32_t best_count = 0;
+    if (columns <= 32) {
+        // Narrow rows are counted in place, a hash map would dominate the cost.
+        for (uint32_t i = 0; i < columns; i++) {
+            uint32_t count = 0;
+            for (uint32_t j = i; j < columns; j++) {
+                count += cells[j] == cells[i];
+            }
+            if (count > best_count) {
+                best_count = count;
+                row.default_target = cells[i];
+            }
+        }
+    } else {
+        std::unordered_map<uint32_t, uint32_t> frequency;
+        for (uint32_t i = 0; i < columns; i++) {
+            uint32_t count = ++frequency[cells[i]];
+            if (count > best_count) {
+                best_count = count;
+                row.default_target = cells[i];
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < columns; i++) {
+        if (cells[i] != row.default_target) {
+            row.exceptions.emplace_back(i, cells[i]);
+        }
+    }
+
+    return row;
+}
@@ -0,0 +1,150 @@
+#ifndef AUTOMATA_TRANSITION_TABLE_H
+#define AUTOMATA_TRANSITION_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace fsm {
+    /**
+     * The memory layout of a compiled transition table.
+     * Auto picks Comb when the table is sparse enough for the packing to pay off.
+     */
+    enum class Layout { Auto, Dense, Comb };
+
+    /**
+     * A row of a transition table described by the state most symbols
+     * go to and the list of (column, target) pairs that differ from it.
+     */
+    struct SparseRow {
+        uint32_t default_target;
+        std::vector<std::pair<uint32_t, uint32_t>> exceptions;
+    };
+
+    /**
+     * A row-major table with one state id per (state, column) cell.
+     * Ids are stored as **Id**, which must be able to hold every state id of the table,
+     * see state_id_size. Narrow ids fit more rows into each cache line.
+     */
+    template <typename Id>
+    class DenseTable {
+    private:
+        std::vector<Id> cells_;
+        uint32_t columns_;
+    public:
+        /**
+         * Creates an empty table.
+         */
+        DenseTable();
+
+        /**
+         * Creates a table with the given dimensions and every cell set to state 0.
+         * @param uint32_t rows: Number of states.
+         * @param uint32_t columns: Number of symbols in the alphabet.
+         */
+        DenseTable(uint32_t rows, uint32_t columns);
+
+        /**
+         * Expands sparse rows into a dense table.
+         * @param vector<SparseRow> &rows: One row per state.
+         * @param uint32_t columns: Number of symbols in the alphabet.
+         */
+        DenseTable(const std::vector<fsm::SparseRow> &rows, uint32_t columns);
+
+        /**
+         * Sets the target of a single cell.
+         * @param uint32_t state: Row of the cell.
+         * @param uint32_t column: Column of the cell.
+         * @param uint32_t target: The next state.
+         */
+        void set(uint32_t state, uint32_t column, uint32_t target);
+
+        /**
+         * Returns the state reached from **state** with the symbol at **column**.
+         */
+        uint32_t next(uint32_t state, uint32_t column) const;
+
+        /**
+         * Returns the number of bytes used by the table.
+         */
+        std::size_t memory_usage() const;
+    };
+
+    /**
+     * A sparse table stored with row displacement (comb-vector) packing.
+     * Every state has a default target and only the cells that differ from it
+     * are stored. The exceptions of all rows are interleaved in a single
+     * next/check array pair: a row owns slot base[state] + column when
+     * check[slot] == state, otherwise the default target applies.
+     * Lookups stay O(1) with two extra loads compared to a dense table.
+     */
+    class CombTable {
+    private:
+        std::vector<uint32_t> defaults_;
+        std::vector<uint32_t> base_;
+        std::vector<uint32_t> next_;
+        std::vector<uint32_t> check_;
+        uint32_t columns_;
+    public:
+        /**
+         * Creates an empty table.
+         */
+        CombTable();
+
+        /**
+         * Packs the given rows.
+         * @param vector<SparseRow> &rows: One row per state. Exception columns must be unique within a row.
+         * @param uint32_t columns: Number of symbols in the alphabet.
+         */
+        CombTable(const std::vector<fsm::SparseRow> &rows, uint32_t columns);
+
+        /**
+         * Returns the state reached from **state** with the symbol at **column**.
+         */
+        uint32_t next(uint32_t state, uint32_t column) const;
+
+        /**
+         * Returns the number of packed slots (used and free).
+         */
+        std::size_t get_slots_count() const;
+
+        /**
+         * Returns the number of bytes used by the table.
+         */
+        std::size_t memory_usage() const;
+    };
+
+    /**
+     * Picks the layout for the given rows. Returns **requested** unless it is Layout::Auto.
+     * @param vector<SparseRow> &rows: One row per state.
+     * @param uint32_t columns: Number of symbols in the alphabet.
+     * @param Layout requested: The layout asked for by the caller.
+     */
+    fsm::Layout choose_layout(const std::vector<fsm::SparseRow> &rows, uint32_t columns, fsm::Layout requested);
+
+    /**
+     * Returns the size in bytes of the narrowest unsigned id (1, 2 or 4) that can number the states.
+     * @param size_t states: Number of states.
+     */
+    unsigned state_id_size(std::size_t states);
+
+    /**
+     * Builds a sparse row from a dense one, using the most frequent target as the default.
+     * @param uint32_t *cells: The targets of the row.
+     * @param uint32_t columns: Number of cells in the row.
+     */
+    fsm::SparseRow make_sparse_row(const uint32_t *cells, uint32_t columns);
+
+    template <typename Id>
+    inline uint32_t DenseTable<Id>::next(uint32_t state, uint32_t column) const {
+        return cells_[(std::size_t)state * columns_ + column];
+    }
+
+    inline uint32_t CombTable::next(uint32_t state, uint32_t column) const {
+        uint32_t slot = base_[state] + column;
+        return check_[slot] == state ? next_[slot] : defaults_[state];
+    }
+}
+
+#endif //AUTOMATA_TRANSITION_TABLE_H
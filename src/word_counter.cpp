@@ -0,0 +1,497 @@
+#include <algorithm>
+#include <thread>
+
+#include "word_counter.h"
+#include "automation_exception.h"
+
+namespace {
+    const uint64_t SMALL_MODULUS = uint64_t(1) << 32;
+
+    /**
+     * Adds a * b to an accumulator that is reduced modulo **modulus** once at the end.
+     * Below 2^32 the products fit in 64 bits and 2^64 of them fit in the accumulator,
+     * larger moduli need every product reduced.
+     */
+    inline void accumulate(unsigned __int128 &sum, uint64_t a, uint64_t b, uint64_t modulus) {
+        if (modulus < SMALL_MODULUS) {
+            sum += a * b;
+        } else {
+            sum += (unsigned __int128)a * b % modulus;
+        }
+    }
+
+    inline uint64_t multiply(uint64_t a, uint64_t b, uint64_t modulus) {
+        return (unsigned __int128)a * b % modulus;
+    }
+
+    uint64_t power(uint64_t base, uint64_t exponent, uint64_t modulus) {
+        uint64_t result = 1 % modulus;
+        for (base %= modulus; exponent != 0; exponent >>= 1) {
+            if (exponent & 1) {
+                result = multiply(result, base, modulus);
+            }
+            base = multiply(base, base, modulus);
+        }
+        return result;
+    }
+
+    /**
+     * Deterministic Miller-Rabin, the bases are enough for every 64-bit number.
+     */
+    bool is_prime(uint64_t n) {
+        if (n < 2) {
+            return false;
+        }
+        const uint64_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+        for (uint64_t p : bases) {
+            if (n % p == 0) {
+                return n == p;
+            }
+        }
+        uint64_t d = n - 1;
+        unsigned r = 0;
+        for (; d % 2 == 0; d /= 2) {
+            r++;
+        }
+        for (uint64_t a : bases) {
+            uint64_t x = power(a, d, n);
+            if (x == 1 || x == n - 1) {
+                continue;
+            }
+            bool composite = true;
+            for (unsigned i = 1; i < r && composite; i++) {
+                x = multiply(x, x, n);
+                composite = x != n - 1;
+            }
+            if (composite) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Runs body(from, to) over [0, count) split in up to **threads** ranges, the calling thread takes the first.
+     */
+    template <typename F>
+    void parallel_for(unsigned threads, std::size_t count, const F &body) {
+        std::size_t ranges = std::min<std::size_t>(threads, count);
+        if (ranges <= 1) {
+            body(0, count);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        for (std::size_t r = 1; r < ranges; r++) {
+            workers.emplace_back([&body, count, ranges, r]() {
+                body(count * r / ranges, count * (r + 1) / ranges);
+            });
+        }
+        body(0, count / ranges);
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+    }
+
+    /**
+     * Returns a * b for square matrices of size **n** stored by rows.
+     */
+    std::vector<uint64_t> multiply_matrices(const std::vector<uint64_t> &a, const std::vector<uint64_t> &b,
+                                            std::size_t n, uint64_t modulus, unsigned threads) {
+        std::vector<uint64_t> product(n * n);
+        parallel_for(threads, n, [&](std::size_t from, std::size_t to) {
+            std::vector<unsigned __int128> row(n);
+            for (std::size_t i = from; i < to; i++) {
+                std::fill(row.begin(), row.end(), 0);
+                for (std::size_t k = 0; k < n; k++) {
+                    uint64_t factor = a[i * n + k];
+                    if (factor == 0) {
+                        continue;
+                    }
+                    const uint64_t *source = &b[k * n];
+                    for (std::size_t j = 0; j < n; j++) {
+                        accumulate(row[j], factor, source[j], modulus);
+                    }
+                }
+                for (std::size_t j = 0; j < n; j++) {
+                    product[i * n + j] = row[j] % modulus;
+                }
+            }
+        });
+        return product;
+    }
+
+    /**
+     * Returns the shortest recurrence s[n] = sum(recurrence[i] * s[n - i]) for i in [1, L]
+     * satisfied by **sequence** modulo the prime **modulus**. recurrence[0] is unused.
+     */
+    std::vector<uint64_t> berlekamp_massey(const std::vector<uint64_t> &sequence, uint64_t modulus) {
+        std::vector<uint64_t> current = {1}, previous = {1};
+        std::size_t length = 0, shift = 1;
+        uint64_t previous_discrepancy = 1;
+
+        for (std::size_t n = 0; n < sequence.size(); n++) {
+            unsigned __int128 sum = sequence[n];
+            for (std::size_t i = 1; i <= length; i++) {
+                accumulate(sum, current[i], sequence[n - i], modulus);
+            }
+            uint64_t discrepancy = sum % modulus;
+            if (discrepancy == 0) {
+                shift++;
+                continue;
+            }
+
+            uint64_t factor = multiply(discrepancy, power(previous_discrepancy, modulus - 2, modulus), modulus);
+            std::vector<uint64_t> saved = current;
+            if (current.size() < previous.size() + shift) {
+                current.resize(previous.size() + shift, 0);
+            }
+            for (std::size_t i = 0; i < previous.size(); i++) {
+                current[i + shift] = (current[i + shift] + modulus - multiply(factor, previous[i], modulus)) % modulus;
+            }
+            if (2 * length <= n) {
+                length = n + 1 - length;
+                previous = saved;
+                previous_discrepancy = discrepancy;
+                shift = 1;
+            } else {
+                shift++;
+            }
+        }
+
+        std::vector<uint64_t> recurrence(length + 1, 0);
+        for (std::size_t i = 1; i <= length && i < current.size(); i++) {
+            recurrence[i] = (modulus - current[i]) % modulus;
+        }
+        return recurrence;
+    }
+
+    /**
+     * Reduces a polynomial modulo x^L - sum(recurrence[i] * x^(L - i)), leaving L coefficients.
+     */
+    void reduce(std::vector<unsigned __int128> &polynomial, const std::vector<uint64_t> &recurrence, uint64_t modulus) {
+        std::size_t length = recurrence.size() - 1;
+        for (std::size_t k = polynomial.size(); k-- > length;) {
+            uint64_t coefficient = polynomial[k] % modulus;
+            if (coefficient == 0) {
+                continue;
+            }
+            for (std::size_t i = 1; i <= length; i++) {
+                accumulate(polynomial[k - i], coefficient, recurrence[i], modulus);
+            }
+        }
+        polynomial.resize(length);
+    }
+}
+
+template <typename T>
+fsm::WordCounter<T>::WordCounter(const fsm::CompiledFSM<T> &machine)
+    : states_(0),
+    initial_state_(0)
+{
+    uint32_t states = machine.get_states_count(), columns = machine.get_alphabet_count();
+    const uint32_t none = UINT32_MAX;
+
+    // Keeps the states reachable from the initial state that can still reach a final state.
+    std::vector<uint32_t> ids(states, none);
+    std::vector<uint32_t> order = {machine.get_initial_state()};
+    std::vector<uint8_t> seen(states, 0);
+    seen[machine.get_initial_state()] = 1;
+    for (std::size_t i = 0; i < order.size(); i++) {
+        for (uint32_t c = 0; c < columns; c++) {
+            uint32_t target = machine.next(order[i], c);
+            if (!seen[target]) {
+                seen[target] = 1;
+                order.push_back(target);
+            }
+        }
+    }
+    for (uint32_t state : order) {
+        if (!machine.is_dead_state(state)) {
+            ids[state] = states_++;
+            final_.push_back(machine.is_final_state(state));
+        }
+    }
+    initial_state_ = ids[machine.get_initial_state()] == none ? 0 : ids[machine.get_initial_state()];
+
+    // Symbols leading to the same state become one edge weighted by their number.
+    offsets_.reserve(states_ + 1);
+    offsets_.push_back(0);
+    std::vector<uint32_t> tally(states_, 0);
+    std::vector<uint32_t> touched;
+    for (uint32_t state : order) {
+        if (ids[state] == none) {
+            continue;
+        }
+        for (uint32_t c = 0; c < columns; c++) {
+            uint32_t target = ids[machine.next(state, c)];
+            if (target != none && tally[target]++ == 0) {
+                touched.push_back(target);
+            }
+        }
+        for (uint32_t target : touched) {
+            targets_.push_back(target);
+            weights_.push_back(tally[target]);
+            tally[target] = 0;
+        }
+        touched.clear();
+        offsets_.push_back(targets_.size());
+    }
+}
+
+template <typename T>
+uint32_t fsm::WordCounter<T>::get_states_count() const {
+    return states_;
+}
+
+template <typename T>
+std::size_t fsm::WordCounter<T>::get_edges_count() const {
+    return targets_.size();
+}
+
+template <typename T>
+bool fsm::WordCounter<T>::is_finite() const {
+    // Every counted state lies on an accepting path, so the language is infinite exactly when there is a cycle.
+    std::vector<uint32_t> incoming(states_, 0);
+    for (uint32_t target : targets_) {
+        incoming[target]++;
+    }
+    std::vector<uint32_t> ready;
+    for (uint32_t s = 0; s < states_; s++) {
+        if (incoming[s] == 0) {
+            ready.push_back(s);
+        }
+    }
+    uint32_t removed = 0;
+    while (!ready.empty()) {
+        uint32_t s = ready.back();
+        ready.pop_back();
+        removed++;
+        for (uint32_t e = offsets_[s]; e < offsets_[s + 1]; e++) {
+            if (--incoming[targets_[e]] == 0) {
+                ready.push_back(targets_[e]);
+            }
+        }
+    }
+    return removed == states_;
+}
+
+template <typename T>
+fsm::BigUint fsm::WordCounter<T>::count(uint64_t length) const {
+    if (states_ == 0) {
+        return fsm::BigUint();
+    }
+
+    std::vector<fsm::BigUint> current(states_), next(states_);
+    current[initial_state_] = fsm::BigUint(1);
+    for (uint64_t step = 0; step < length; step++) {
+        for (uint32_t s = 0; s < states_; s++) {
+            next[s] = fsm::BigUint();
+        }
+        for (uint32_t s = 0; s < states_; s++) {
+            if (current[s].is_zero()) {
+                continue;
+            }
+            for (uint32_t e = offsets_[s]; e < offsets_[s + 1]; e++) {
+                next[targets_[e]].add_product(current[s], weights_[e]);
+            }
+        }
+        current.swap(next);
+    }
+
+    fsm::BigUint total;
+    for (uint32_t s = 0; s < states_; s++) {
+        if (final_[s]) {
+            total += current[s];
+        }
+    }
+    return total;
+}
+
+template <typename T>
+std::vector<fsm::BigUint> fsm::WordCounter<T>::count_up_to(uint64_t max_length) const {
+    std::vector<fsm::BigUint> counts;
+    counts.reserve(max_length + 1);
+    std::vector<fsm::BigUint> current(states_), next(states_);
+    if (states_ != 0) {
+        current[initial_state_] = fsm::BigUint(1);
+    }
+
+    for (uint64_t length = 0; length <= max_length; length++) {
+        fsm::BigUint total;
+        for (uint32_t s = 0; s < states_; s++) {
+            if (final_[s]) {
+                total += current[s];
+            }
+        }
+        counts.push_back(total);
+        if (length == max_length) {
+            break;
+        }
+
+        for (uint32_t s = 0; s < states_; s++) {
+            next[s] = fsm::BigUint();
+        }
+        for (uint32_t s = 0; s < states_; s++) {
+            if (current[s].is_zero()) {
+                continue;
+            }
+            for (uint32_t e = offsets_[s]; e < offsets_[s + 1]; e++) {
+                next[targets_[e]].add_product(current[s], weights_[e]);
+            }
+        }
+        current.swap(next);
+    }
+    return counts;
+}
+
+template <typename T>
+std::vector<uint64_t> fsm::WordCounter<T>::count_up_to_modulo(uint64_t max_length, uint64_t modulus) const {
+    if (modulus == 0 || modulus >> 63 != 0) {
+        throw AutomationException("The modulus must be between 1 and 2^63 - 1", __FILE__, __LINE__);
+    }
+
+    std::vector<uint64_t> counts;
+    counts.reserve(max_length + 1);
+    std::vector<uint64_t> current(states_, 0);
+    std::vector<unsigned __int128> next(states_);
+    if (states_ != 0) {
+        current[initial_state_] = 1 % modulus;
+    }
+
+    for (uint64_t length = 0; length <= max_length; length++) {
+        unsigned __int128 total = 0;
+        for (uint32_t s = 0; s < states_; s++) {
+            if (final_[s]) {
+                total += current[s];
+            }
+        }
+        counts.push_back(total % modulus);
+        if (length == max_length) {
+            break;
+        }
+
+        std::fill(next.begin(), next.end(), 0);
+        for (uint32_t s = 0; s < states_; s++) {
+            if (current[s] == 0) {
+                continue;
+            }
+            for (uint32_t e = offsets_[s]; e < offsets_[s + 1]; e++) {
+                accumulate(next[targets_[e]], current[s], weights_[e], modulus);
+            }
+        }
+        for (uint32_t s = 0; s < states_; s++) {
+            current[s] = next[s] % modulus;
+        }
+    }
+    return counts;
+}
+
+template <typename T>
+uint64_t fsm::WordCounter<T>::count_modulo(uint64_t length, uint64_t modulus, unsigned threads) const {
+    if (modulus == 0 || modulus >> 63 != 0) {
+        throw AutomationException("The modulus must be between 1 and 2^63 - 1", __FILE__, __LINE__);
+    }
+    if (states_ == 0 || modulus == 1) {
+        return 0;
+    }
+
+    // Up to twice the number of states walking the edges is cheaper than any power.
+    if (length <= 2 * (uint64_t)states_) {
+        return count_up_to_modulo(length, modulus).back();
+    }
+    if (is_prime(modulus)) {
+        return count_by_recurrence(length, modulus);
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return count_by_matrix(length, modulus, threads);
+}
+
+template <typename T>
+uint64_t fsm::WordCounter<T>::count_by_recurrence(uint64_t length, uint64_t modulus) const {
+    // The counts satisfy a recurrence of order at most states_, which 2 * states_ terms determine.
+    std::vector<uint64_t> counts = count_up_to_modulo(2 * (uint64_t)states_ - 1, modulus);
+    std::vector<uint64_t> recurrence = berlekamp_massey(counts, modulus);
+    std::size_t order = recurrence.size() - 1;
+    if (order == 0) {
+        return 0;
+    }
+
+    // x^length modulo the characteristic polynomial gives the count as a combination of the first terms.
+    std::vector<uint64_t> polynomial(1, 1);
+    std::vector<unsigned __int128> squared;
+    for (int bit = 63 - __builtin_clzll(length); bit >= 0; bit--) {
+        squared.assign(2 * polynomial.size() - 1, 0);
+        for (std::size_t i = 0; i < polynomial.size(); i++) {
+            if (polynomial[i] == 0) {
+                continue;
+            }
+            for (std::size_t j = 0; j < polynomial.size(); j++) {
+                accumulate(squared[i + j], polynomial[i], polynomial[j], modulus);
+            }
+        }
+        if ((length >> bit) & 1) {
+            squared.insert(squared.begin(), 0);
+        }
+        if (squared.size() > order) {
+            reduce(squared, recurrence, modulus);
+        }
+        polynomial.resize(squared.size());
+        for (std::size_t i = 0; i < squared.size(); i++) {
+            polynomial[i] = squared[i] % modulus;
+        }
+    }
+
+    unsigned __int128 total = 0;
+    for (std::size_t i = 0; i < polynomial.size(); i++) {
+        accumulate(total, polynomial[i], counts[i], modulus);
+    }
+    return total % modulus;
+}
+
+template <typename T>
+uint64_t fsm::WordCounter<T>::count_by_matrix(uint64_t length, uint64_t modulus, unsigned threads) const {
+    std::size_t n = states_;
+    std::vector<uint64_t> matrix(n * n, 0);
+    for (uint32_t s = 0; s < states_; s++) {
+        for (uint32_t e = offsets_[s]; e < offsets_[s + 1]; e++) {
+            matrix[s * n + targets_[e]] = weights_[e] % modulus;
+        }
+    }
+
+    // Only the row of the initial state is needed, so the partial result stays a vector.
+    std::vector<uint64_t> row(n, 0);
+    row[initial_state_] = 1;
+    for (uint64_t exponent = length; exponent != 0; exponent >>= 1) {
+        if (exponent & 1) {
+            std::vector<unsigned __int128> product(n, 0);
+            for (std::size_t k = 0; k < n; k++) {
+                if (row[k] == 0) {
+                    continue;
+                }
+                for (std::size_t j = 0; j < n; j++) {
+                    accumulate(product[j], row[k], matrix[k * n + j], modulus);
+                }
+            }
+            for (std::size_t j = 0; j < n; j++) {
+                row[j] = product[j] % modulus;
+            }
+        }
+        if (exponent > 1) {
+            matrix = multiply_matrices(matrix, matrix, n, modulus, threads);
+        }
+    }
+
+    unsigned __int128 total = 0;
+    for (uint32_t s = 0; s < states_; s++) {
+        if (final_[s]) {
+            total += row[s];
+        }
+    }
+    return total % modulus;
+}
+
+template class fsm::WordCounter<int>;
+template class fsm::WordCounter<char>;
@@ -0,0 +1,98 @@
+#ifndef AUTOMATA_WORD_COUNTER_H
+#define AUTOMATA_WORD_COUNTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "big_uint.h"
+#include "compiled_fsm.h"
+
+namespace fsm {
+    /**
+     * WordCounter counts the words of each length accepted by a compiled machine.
+     * Only the states that are reachable from the initial state and can reach a final state
+     * take part, and parallel transitions between two states are merged into one weighted edge,
+     * so the counting graph is usually much smaller than the table.
+     *
+     * Exact counts are computed by dynamic programming over the lengths. Counts modulo a number
+     * also work for huge lengths: for a prime modulus the counts are reduced to their shortest
+     * linear recurrence (Berlekamp-Massey), otherwise the weighted transition matrix is raised
+     * to the length by repeated squaring on several threads.
+     */
+    template <typename T>
+    class WordCounter {
+    private:
+        uint32_t states_;
+        uint32_t initial_state_;
+        std::vector<uint8_t> final_;
+        std::vector<uint32_t> offsets_;
+        std::vector<uint32_t> targets_;
+        std::vector<uint32_t> weights_;
+    public:
+        /**
+         * Builds the counting graph of a machine.
+         * @param CompiledFSM<T> &machine: The machine, it is not referenced after construction.
+         */
+        WordCounter(const fsm::CompiledFSM<T> &machine);
+
+        /**
+         * Returns the number of states that take part in counting.
+         */
+        uint32_t get_states_count() const;
+
+        /**
+         * Returns the number of weighted edges between the counted states.
+         */
+        std::size_t get_edges_count() const;
+
+        /**
+         * Returns true if the machine accepts finitely many words.
+         */
+        bool is_finite() const;
+
+        /**
+         * Returns the number of accepted words with exactly **length** symbols.
+         * Takes O(length * edges) additions of numbers with up to length * log2(alphabet) bits.
+         * @param uint64_t length: The word length.
+         */
+        fsm::BigUint count(uint64_t length) const;
+
+        /**
+         * Returns the number of accepted words of every length from 0 to **max_length**,
+         * i.e. the first coefficients of the generating function of the language.
+         * @param uint64_t max_length: The largest length.
+         */
+        std::vector<fsm::BigUint> count_up_to(uint64_t max_length) const;
+
+        /**
+         * Returns the number of accepted words with exactly **length** symbols modulo **modulus**.
+         * Throws AutomationException if the modulus is 0 or at least 2^63.
+         * @param uint64_t length: The word length, may be huge.
+         * @param uint64_t modulus: The modulus.
+         * @param unsigned threads: Threads for the matrix products, 0 for one per hardware thread.
+         */
+        uint64_t count_modulo(uint64_t length, uint64_t modulus, unsigned threads = 0) const;
+
+        /**
+         * Returns the number of accepted words of every length from 0 to **max_length** modulo **modulus**.
+         * Throws AutomationException if the modulus is 0 or at least 2^63.
+         * @param uint64_t max_length: The largest length.
+         * @param uint64_t modulus: The modulus.
+         */
+        std::vector<uint64_t> count_up_to_modulo(uint64_t max_length, uint64_t modulus) const;
+    private:
+
+        /**
+         * count_modulo for a prime modulus, through the linear recurrence of the counts.
+         */
+        uint64_t count_by_recurrence(uint64_t length, uint64_t modulus) const;
+
+        /**
+         * count_modulo for any modulus, through powers of the transition matrix.
+         */
+        uint64_t count_by_matrix(uint64_t length, uint64_t modulus, unsigned threads) const;
+    };
+}
+
+#endif //AUTOMATA_WORD_COUNTER_H
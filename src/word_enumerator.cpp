@@ -0,0 +1,163 @@
+#include <algorithm>
+
+#include "word_enumerator.h"
+
+template <typename T>
+fsm::WordEnumerator<T>::WordEnumerator(const fsm::CompiledFSM<T> &machine, std::size_t max_length)
+    : machine_(machine),
+    max_length_(max_length)
+{
+    // Columns follow the alphabet's order of definition, shortlex needs them by symbol.
+    const std::vector<T> &alphabet = machine.get_alphabet();
+    for (uint32_t c = 0; c < alphabet.size(); c++) {
+        order_.push_back(c);
+    }
+    std::sort(order_.begin(), order_.end(), [&alphabet](uint32_t a, uint32_t b) {
+        return alphabet[a] < alphabet[b];
+    });
+    for (uint32_t column : order_) {
+        symbols_.push_back(alphabet[column]);
+    }
+
+    // Only the states reachable from the initial state are numbered, in the order they are found.
+    const uint32_t none = UINT32_MAX;
+    ids_.assign(machine.get_states_count(), none);
+    reachable_.push_back(machine.get_initial_state());
+    ids_[machine.get_initial_state()] = 0;
+    for (std::size_t i = 0; i < reachable_.size(); i++) {
+        for (uint32_t c = 0; c < order_.size(); c++) {
+            uint32_t target = machine.next(reachable_[i], c);
+            if (ids_[target] == none) {
+                ids_[target] = reachable_.size();
+                reachable_.push_back(target);
+            }
+        }
+    }
+    state_words_ = (reachable_.size() + 63) / 64;
+
+    viable_.assign(state_words_, 0);
+    bool empty = true;
+    for (uint32_t id = 0; id < reachable_.size(); id++) {
+        if (machine.is_final_state(reachable_[id])) {
+            viable_[id / 64] |= uint64_t(1) << (id % 64);
+            empty = false;
+        }
+    }
+    empty_.push_back(empty);
+    reset();
+}
+
+template <typename T>
+void fsm::WordEnumerator<T>::reset() {
+    length_ = 0;
+    started_ = false;
+    done_ = false;
+}
+
+template <typename T>
+bool fsm::WordEnumerator<T>::next(T *word, std::size_t &length) {
+    if (done_) {
+        return false;
+    }
+    if (!started_) {
+        started_ = true;
+        done_ = !start(0);
+    } else if (!advance()) {
+        done_ = length_ == max_length_ || !start(length_ + 1);
+    }
+    if (done_) {
+        return false;
+    }
+
+    std::copy(word_.begin(), word_.begin() + length_, word);
+    length = length_;
+    return true;
+}
+
+template <typename T>
+void fsm::WordEnumerator<T>::extend() {
+    std::size_t layer = empty_.size();
+    viable_.resize((layer + 1) * state_words_, 0);
+    const uint64_t *previous = &viable_[(layer - 1) * state_words_];
+    uint64_t *current = &viable_[layer * state_words_];
+
+    bool empty = true;
+    for (uint32_t id = 0; id < reachable_.size(); id++) {
+        for (uint32_t c = 0; c < order_.size(); c++) {
+            uint32_t target = ids_[machine_.next(reachable_[id], c)];
+            if (previous[target / 64] >> (target % 64) & 1) {
+                current[id / 64] |= uint64_t(1) << (id % 64);
+                empty = false;
+                break;
+            }
+        }
+    }
+    empty_.push_back(empty);
+}
+
+template <typename T>
+bool fsm::WordEnumerator<T>::is_viable(uint32_t state, std::size_t remaining) {
+    while (remaining >= empty_.size()) {
+        extend();
+    }
+    uint32_t id = ids_[state];
+    return viable_[remaining * state_words_ + id / 64] >> (id % 64) & 1;
+}
+
+template <typename T>
+bool fsm::WordEnumerator<T>::start(std::size_t length) {
+    uint32_t initial = machine_.get_initial_state();
+    for (; length <= max_length_; length++) {
+        // Once no state reaches a final state in exactly **length** symbols, no state does for longer lengths.
+        if (is_viable(initial, length)) {
+            length_ = length;
+            path_.resize(length + 1);
+            picks_.resize(length);
+            word_.resize(length);
+            path_[0] = initial;
+            descend(0);
+            return true;
+        }
+        if (empty_[length]) {
+            return false;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+void fsm::WordEnumerator<T>::descend(std::size_t depth) {
+    for (std::size_t d = depth; d < length_; d++) {
+        uint32_t state = path_[d];
+        for (uint32_t i = 0; i < order_.size(); i++) {
+            uint32_t target = machine_.next(state, order_[i]);
+            if (is_viable(target, length_ - d - 1)) {
+                picks_[d] = i;
+                word_[d] = symbols_[i];
+                path_[d + 1] = target;
+                break;
+            }
+        }
+    }
+}
+
+template <typename T>
+bool fsm::WordEnumerator<T>::advance() {
+    for (std::size_t d = length_; d-- > 0;) {
+        uint32_t state = path_[d];
+        for (uint32_t i = picks_[d] + 1; i < order_.size(); i++) {
+            uint32_t target = machine_.next(state, order_[i]);
+            if (is_viable(target, length_ - d - 1)) {
+                picks_[d] = i;
+                word_[d] = symbols_[i];
+                path_[d + 1] = target;
+                descend(d + 1);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+template class fsm::WordEnumerator<int>;
+template class fsm::WordEnumerator<char>;
@@ -0,0 +1,88 @@
+#ifndef AUTOMATA_WORD_ENUMERATOR_H
+#define AUTOMATA_WORD_ENUMERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "compiled_fsm.h"
+
+namespace fsm {
+    /**
+     * WordEnumerator lazily lists the words accepted by a compiled machine in shortlex order:
+     * shorter words first, words of the same length ordered by their symbols.
+     * A word of length n is extended one symbol at a time and a symbol is only tried if the
+     * state it leads to can reach a final state with exactly the symbols that are left, so
+     * no branch is ever abandoned and every step goes towards a word.
+     * Memory is the current word and one bit per reachable state and remaining length, states
+     * that are not reachable from the initial state are left out so a finite language ends
+     * as soon as its longest word was listed.
+     */
+    template <typename T>
+    class WordEnumerator {
+    private:
+        const fsm::CompiledFSM<T> &machine_;
+        std::size_t max_length_;
+        std::vector<uint32_t> order_;
+        std::vector<T> symbols_;
+        std::vector<uint32_t> ids_;
+        std::vector<uint32_t> reachable_;
+        std::size_t state_words_;
+        std::vector<uint64_t> viable_;
+        std::vector<uint8_t> empty_;
+        std::size_t length_;
+        std::vector<uint32_t> path_;
+        std::vector<uint32_t> picks_;
+        std::vector<T> word_;
+        bool started_;
+        bool done_;
+    public:
+        /**
+         * Creates an enumerator for a machine. The machine must outlive the enumerator.
+         * @param CompiledFSM<T> &machine: The machine whose words are listed.
+         * @param size_t max_length: The enumeration ends after the words of this length.
+         */
+        WordEnumerator(const fsm::CompiledFSM<T> &machine, std::size_t max_length);
+
+        /**
+         * Writes the next word to a caller buffer. Returns false once every word of up to
+         * max_length symbols was listed.
+         * @param T *word: Buffer with room for max_length symbols.
+         * @param size_t &length: Set to the length of the word.
+         */
+        bool next(T *word, std::size_t &length);
+
+        /**
+         * Starts the enumeration from the shortest word again.
+         */
+        void reset();
+    private:
+
+        /**
+         * Returns true if a final state is reached from **state**, a reachable state, with exactly **remaining** symbols.
+         */
+        bool is_viable(uint32_t state, std::size_t remaining);
+
+        /**
+         * Computes the states that reach a final state in one symbol more than the last known layer.
+         */
+        void extend();
+
+        /**
+         * Moves to the first word with at least **length** symbols. Returns false if there is none.
+         */
+        bool start(std::size_t length);
+
+        /**
+         * Completes the word from **depth** with the smallest viable symbols.
+         */
+        void descend(std::size_t depth);
+
+        /**
+         * Moves to the next word of the current length. Returns false if it was the last one.
+         */
+        bool advance();
+    };
+}
+
+#endif //AUTOMATA_WORD_ENUMERATOR_H
@@ -0,0 +1,138 @@
+#include <algorithm>
+
+#include "word_sampler.h"
+#include "automation_exception.h"
+
+template <typename T>
+fsm::WordSampler<T>::WordSampler(const fsm::CompiledFSM<T> &machine, std::size_t length)
+    : length_(length),
+    states_(0)
+{
+    uint32_t states = machine.get_states_count(), columns = machine.get_alphabet_count();
+    const uint32_t none = UINT32_MAX;
+
+    // Only the states reachable from the initial state are numbered.
+    std::vector<uint32_t> ids(states, none);
+    std::vector<uint32_t> order = {machine.get_initial_state()};
+    ids[machine.get_initial_state()] = states_++;
+    for (std::size_t i = 0; i < order.size(); i++) {
+        for (uint32_t c = 0; c < columns; c++) {
+            uint32_t target = machine.next(order[i], c);
+            if (ids[target] == none) {
+                ids[target] = states_++;
+                order.push_back(target);
+            }
+        }
+    }
+    initial_state_ = 0;
+
+    // One edge per distinct target, followed by the symbols leading to it.
+    std::vector<std::vector<T>> by_target(states_);
+    std::vector<uint32_t> touched;
+    offsets_.push_back(0);
+    symbol_offsets_.push_back(0);
+    for (uint32_t state : order) {
+        for (uint32_t c = 0; c < columns; c++) {
+            // Dead states have no completions, leaving them out keeps the draws short.
+            if (machine.is_dead_state(machine.next(state, c))) {
+                continue;
+            }
+            uint32_t target = ids[machine.next(state, c)];
+            if (by_target[target].empty()) {
+                touched.push_back(target);
+            }
+            by_target[target].push_back(machine.get_alphabet()[c]);
+        }
+        for (uint32_t target : touched) {
+            targets_.push_back(target);
+            symbols_.insert(symbols_.end(), by_target[target].begin(), by_target[target].end());
+            symbol_offsets_.push_back(symbols_.size());
+            multiplicities_.push_back(by_target[target].size());
+            by_target[target].clear();
+        }
+        touched.clear();
+        offsets_.push_back(targets_.size());
+    }
+
+    // Layer r holds the completions of r symbols of every state, divided by the largest of the layer.
+    weights_.assign((length + 1) * (std::size_t)states_, 0.0);
+    scales_.assign(length + 1, 1.0);
+    for (uint32_t state : order) {
+        weights_[ids[state]] = machine.is_final_state(state) ? 1.0 : 0.0;
+    }
+    for (std::size_t r = 1; r <= length; r++) {
+        const double *previous = &weights_[(r - 1) * states_];
+        double *current = &weights_[r * states_];
+        double largest = 0.0;
+        for (uint32_t s = 0; s < states_; s++) {
+            double total = 0.0;
+            for (uint32_t e = offsets_[s]; e < offsets_[s + 1]; e++) {
+                total += previous[targets_[e]] * multiplicities_[e];
+            }
+            current[s] = total;
+            largest = std::max(largest, total);
+        }
+        if (largest > 0.0) {
+            scales_[r] = largest;
+            for (uint32_t s = 0; s < states_; s++) {
+                current[s] /= largest;
+            }
+        }
+    }
+}
+
+template <typename T>
+std::size_t fsm::WordSampler<T>::get_length() const {
+    return length_;
+}
+
+template <typename T>
+bool fsm::WordSampler<T>::is_empty() const {
+    return weights_[length_ * states_ + initial_state_] == 0.0;
+}
+
+template <typename T>
+void fsm::WordSampler<T>::sample(T *word, std::mt19937_64 &random) const {
+    if (is_empty()) {
+        throw AutomationException("The machine accepts no word of this length", __FILE__, __LINE__);
+    }
+
+    uint32_t state = initial_state_;
+    for (std::size_t d = 0; d < length_; d++) {
+        const double *completions = &weights_[(length_ - d - 1) * states_];
+        uint32_t first = offsets_[state], last = offsets_[state + 1];
+        double total = weights_[(length_ - d) * states_ + state] * scales_[length_ - d];
+
+        // One draw picks the edge, and where it falls inside the edge picks the symbol.
+        double point = (random() >> 11) * 0x1.0p-53 * total;
+        uint32_t edge = last;
+        double weight = 0.0;
+        for (uint32_t e = first; e < last; e++) {
+            double current = completions[targets_[e]] * multiplicities_[e];
+            if (current == 0.0) {
+                continue;
+            }
+            edge = e;
+            weight = current;
+            if (point < current) {
+                break;
+            }
+            point -= current;
+        }
+
+        uint32_t symbols = symbol_offsets_[edge + 1] - symbol_offsets_[edge];
+        uint32_t pick = std::min<uint32_t>(point / weight * symbols, symbols - 1);
+        word[d] = symbols_[symbol_offsets_[edge] + pick];
+        state = targets_[edge];
+    }
+}
+
+template <typename T>
+void fsm::WordSampler<T>::sample(T *words, std::size_t count, std::mt19937_64 &random) const {
+    for (std::size_t i = 0; i < count; i++) {
+        sample(words + i * length_, random);
+    }
+}
+
+template class fsm::WordSampler<int>;
+template class fsm::WordSampler<char>;
@@ -0,0 +1,72 @@
+#ifndef AUTOMATA_WORD_SAMPLER_H
+#define AUTOMATA_WORD_SAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "compiled_fsm.h"
+
+namespace fsm {
+    /**
+     * WordSampler draws accepted words of a fixed length uniformly at random.
+     * For every remaining length and state it precomputes how many completions reach a final
+     * state, then each symbol is drawn with probability proportional to the completions it
+     * leaves. The counts are kept as doubles scaled per length, so any length works and the
+     * distribution is uniform up to double rounding.
+     * Transitions between the same two states are merged, so a step looks at the distinct
+     * targets of a state rather than the whole alphabet.
+     */
+    template <typename T>
+    class WordSampler {
+    private:
+        std::size_t length_;
+        uint32_t states_;
+        uint32_t initial_state_;
+        std::vector<uint32_t> offsets_;
+        std::vector<uint32_t> targets_;
+        std::vector<uint32_t> symbol_offsets_;
+        std::vector<T> symbols_;
+        std::vector<double> multiplicities_;
+        std::vector<double> weights_;
+        std::vector<double> scales_;
+    public:
+        /**
+         * Precomputes the completions of a machine, which is not referenced afterwards.
+         * Takes (length + 1) * states doubles.
+         * @param CompiledFSM<T> &machine: The machine whose words are drawn.
+         * @param size_t length: The length of the drawn words.
+         */
+        WordSampler(const fsm::CompiledFSM<T> &machine, std::size_t length);
+
+        /**
+         * Returns the length of the drawn words.
+         */
+        std::size_t get_length() const;
+
+        /**
+         * Returns true if the machine accepts no word of the length.
+         */
+        bool is_empty() const;
+
+        /**
+         * Draws a word into a caller buffer.
+         * Throws AutomationException if the machine accepts no word of the length.
+         * @param T *word: Buffer with room for get_length() symbols.
+         * @param mt19937_64 &random: The source of randomness.
+         */
+        void sample(T *word, std::mt19937_64 &random) const;
+
+        /**
+         * Draws **count** words into a caller buffer, one after another.
+         * Throws AutomationException if the machine accepts no word of the length.
+         * @param T *words: Buffer with room for count * get_length() symbols.
+         * @param size_t count: The number of words.
+         * @param mt19937_64 &random: The source of randomness.
+         */
+        void sample(T *words, std::size_t count, std::mt19937_64 &random) const;
+    };
+}
+
+#endif //AUTOMATA_WORD_SAMPLER_H